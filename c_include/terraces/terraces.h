@@ -90,6 +90,14 @@ extern "C" {
  */
 #define TA_UPPER_BOUND 16
 
+/**
+ approximately count unrooted trees on terrace using floating-point arithmetic.
+ terraceSize is set to the approximate count, which is accurate up to floating-point precision.
+ This is much faster than TA_COUNT for large terraces, but cannot be combined with
+ TA_COUNT, TA_ENUMERATE or TA_DETECT.
+ */
+#define TA_COUNT_APPROX 32
+
 // data type containing data to be passed to the algorithm we want to implement
 
 typedef struct {
@@ -1,5 +1,6 @@
 #include "../lib/trees_impl.hpp"
 #include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <terraces/advanced.hpp>
 #include <terraces/bitmatrix.hpp>
@@ -36,6 +37,20 @@ void copyDataMatrix(const unsigned char* matrix, missingData* m) {
 	std::copy_n(matrix, m->numberOfSpecies * m->numberOfPartitions, m->missingDataMatrix);
 }
 
+namespace {
+
+// stores the integer closest to 10^log10_count, which may be too large for a double
+void set_approximate_count(mpz_t result, double log10_count) {
+	auto log2_count = log10_count / std::log10(2.0);
+	auto exponent = std::floor(log2_count);
+	// keep 53 significant bits
+	auto shift = std::max(exponent - 52, 0.0);
+	mpz_set_d(result, std::round(std::exp2(log2_count - shift)));
+	mpz_mul_2exp(result, result, static_cast<mp_bitcnt_t>(shift));
+}
+
+} // anonymous namespace
+
 CHECK_RESULT int terraceAnalysis(missingData* m, const char* newickTreeString, const int ta_outspec,
                                  const char* allTreesOnTerraceFile, mpz_t terraceSize) {
 	// check ta_outspec
@@ -44,9 +59,12 @@ CHECK_RESULT int terraceAnalysis(missingData* m, const char* newickTreeString, c
 	auto enumerate = bool(ta_outspec & TA_ENUMERATE);
 	auto compress = bool(ta_outspec & TA_ENUMERATE_COMPRESS);
 	auto force_comprehensive = bool(ta_outspec & TA_UPPER_BOUND);
+	auto approximate = bool(ta_outspec & TA_COUNT_APPROX);
 	bool invalid1 = detect && (count || enumerate); // cannot detect and count at the same time
 	bool invalid2 = compress && !enumerate;         // cannot compress if we don't enumerate
-	if (invalid1 || invalid2) {
+	// approximate counting is a separate mode
+	bool invalid3 = approximate && (detect || count || enumerate);
+	if (invalid1 || invalid2 || invalid3) {
 		return TERRACE_FLAG_CONFLICT_ERROR;
 	}
 
@@ -118,7 +136,9 @@ CHECK_RESULT int terraceAnalysis(missingData* m, const char* newickTreeString, c
 	}
 
 	// enumerate terrace
-	if (detect) {
+	if (approximate) {
+		set_approximate_count(terraceSize, terraces::approx_count_terrace(data));
+	} else if (detect) {
 		auto lb = terraces::fast_count_terrace(data);
 		mpz_set_ui(terraceSize, lb);
 	} else if (count && !enumerate) {
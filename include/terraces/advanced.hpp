@@ -1,8 +1,10 @@
 #ifndef ADVANCED_HPP
 #define ADVANCED_HPP
 
+#include <cstdint>
 #include <functional>
 #include <iosfwd>
+#include <string>
 
 #include "bigint.hpp"
 #include "bitmatrix.hpp"
@@ -34,6 +36,44 @@ struct execution_limits {
 	index_t time_limit_seconds{std::numeric_limits<index_t>::max()};
 	/** Memory limit in bytes. */
 	index_t mem_limit_bytes{std::numeric_limits<index_t>::max()};
+	/** Number of threads used for counting, 0 means one thread per hardware thread. */
+	index_t num_threads{1};
+	/**
+	 * Memory budget in bytes for caching the results of counting subproblems (0 disables).
+	 * Every counting thread uses its own cache, which gets an equal share of the budget.
+	 */
+	index_t cache_limit_bytes{0};
+	/**
+	 * Directory for scratch files holding the parts of a multitree that exceed the memory limit
+	 * (empty disables). The operating system pages them out, so large multitrees are completed.
+	 */
+	std::string spill_directory{};
+};
+
+/**
+ * Guaranteed bounds on the number of trees on a terrace, see \ref bound_terrace.
+ */
+struct terrace_bounds {
+	/** A lower bound on the number of trees. */
+	big_integer lower;
+	/** An upper bound on the number of trees. */
+	big_integer upper;
+	/** Returns true if and only if both bounds are equal to the number of trees. */
+	bool is_exact() const { return lower == upper; }
+};
+
+/**
+ * A random estimate of the number of trees on a terrace, see \ref estimate_terrace.
+ */
+struct terrace_estimate {
+	/** The decimal logarithm of the estimated number of trees. */
+	double log10_size;
+	/** The decimal logarithm of the lower bound of the 95% confidence interval. */
+	double log10_lower;
+	/** The decimal logarithm of the upper bound of the 95% confidence interval. */
+	double log10_upper;
+	/** The number of random probes the estimate is based on. */
+	index_t num_probes;
 };
 
 /**
@@ -87,7 +127,8 @@ index_t fast_count_terrace(const supertree_data& data);
  * clamped.
  * \param data The constraints extracted from the tree and missing data matrix describing all
  * possible supertrees.
- * \param limits The execution limits for the algorithm. Only the time limit will be used.
+ * \param limits The execution limits for the algorithm. Only the time limit, the number of
+ * threads and the cache limit will be used.
  * \param terminated_early Output parameter that will be set to true iff the time limit has been
  * exceeded. \return The number of trees on the phylogenetic terrace containing the input tree. Note
  * that if this result is UINT32/64_MAX = 2^32/64 - 1, the computations resulted in an overflow,
@@ -99,13 +140,83 @@ index_t count_terrace(const supertree_data& data, execution_limits limits, bool&
  * Counts all trees on a terrace around a phylogenetic tree.
  * \param data The constraints extracted from the tree and missing data matrix describing all
  * possible supertrees.
- * \param limits The execution limits for the algorithm. Only the time limit will be used.
+ * \param limits The execution limits for the algorithm. Only the time limit, the number of
+ * threads and the cache limit will be used.
  * \param terminated_early Output parameter that will be set to true iff the time limit has been
  * exceeded. \return The number of trees on the phylogenetic terrace containing the input tree.
  */
 big_integer count_terrace_bigint(const supertree_data& data, execution_limits limits,
                                  bool& terminated_early);
 
+/**
+ * Approximately counts all trees on a terrace around a phylogenetic tree.
+ * The computation uses floating-point arithmetic in log-space,
+ * so it is about as fast as \ref count_terrace, but does not overflow.
+ * \param data The constraints extracted from the tree and missing data matrix describing all
+ * possible supertrees.
+ * \param limits The execution limits for the algorithm. Only the time limit, the number of
+ * threads and the cache limit will be used.
+ * \param terminated_early Output parameter that will be set to true iff the time limit has been
+ * exceeded. \return The decimal logarithm of the number of trees on the phylogenetic terrace
+ * containing the input tree, accurate up to floating-point precision.
+ */
+double approx_count_terrace(const supertree_data& data, execution_limits limits,
+                            bool& terminated_early);
+
+/**
+ * Computes guaranteed bounds on the number of trees on a terrace around a phylogenetic tree.
+ * The recursion used for counting is explored up to a depth limit,
+ * which is doubled in every round to refine the bounds until they are exact.
+ * Unexplored leaf sets are bounded by their number of bipartitions and unrooted trees.
+ * \param data The constraints extracted from the tree and missing data matrix describing all
+ * possible supertrees.
+ * \param limits The execution limits for the algorithm. Only the time limit will be used.
+ * If it is exceeded during a round, the bounds from the previous round are returned.
+ * \param refine Called with the bounds after every round that did not give exact bounds.
+ * The refinement stops if it returns false, e.g. because the bounds are tight enough.
+ * \return The tightest bounds computed for the terrace containing the input tree.
+ */
+terrace_bounds bound_terrace(const supertree_data& data, execution_limits limits,
+                             std::function<bool(const terrace_bounds&)> refine);
+
+/**
+ * Estimates the number of trees on a terrace around a phylogenetic tree
+ * using Knuth's random probing.
+ * Every probe follows a single random path through the recursion used for counting,
+ * so it takes time roughly linear in the size of the tree. The average of all probes is an
+ * unbiased estimate of the terrace size, which becomes more accurate with more probes.
+ * \param data The constraints extracted from the tree and missing data matrix describing all
+ * possible supertrees.
+ * \param num_probes The number of random probes, at least one probe is always taken.
+ * \param seed The seed for the random choices. The estimate only depends on the seed,
+ * the number of probes and the number of threads.
+ * \param limits The execution limits for the algorithm. Only the time limit and the number of
+ * threads will be used.
+ * \param terminated_early Output parameter that will be set to true iff the time limit has been
+ * exceeded. In this case, the estimate is based on fewer probes.
+ * \return The estimated number of trees on the phylogenetic terrace containing the input tree.
+ */
+terrace_estimate estimate_terrace(const supertree_data& data, index_t num_probes,
+                                  std::uint64_t seed, execution_limits limits,
+                                  bool& terminated_early);
+
+/**
+ * Counts all trees on a terrace around a phylogenetic tree using fixed-size modular arithmetic.
+ * The trees are counted modulo enough 62-bit primes to represent every possible terrace size,
+ * and the exact result is reconstructed using the Chinese remainder theorem.
+ * This avoids arbitrary-precision arithmetic during the enumeration,
+ * but runs one enumeration pass for every few primes.
+ * \param data The constraints extracted from the tree and missing data matrix describing all
+ * possible supertrees.
+ * \param limits The execution limits for the algorithm. Only the time limit, the number of
+ * threads and the cache limit will be used.
+ * \param terminated_early Output parameter that will be set to true iff the time limit has been
+ * exceeded. In this case, the result is 0. \return The number of trees on the phylogenetic
+ * terrace containing the input tree.
+ */
+big_integer count_terrace_modular(const supertree_data& data, execution_limits limits,
+                                  bool& terminated_early);
+
 /**
  * Enumerates all trees on a terrace around a phylogenetic tree.
  * The trees will be printed in a compressed <b>multitree format</b>,
@@ -124,6 +235,8 @@ big_integer count_terrace_bigint(const supertree_data& data, execution_limits li
  * \param names The name map containing only leaf names. It will be used to output the multitree.
  * \param output The output stream into which the multitree will be written.
  * \param limits The execution limits for the algorithm. Both time and memory limits will be used.
+ * If a spill directory is set, the memory limit only applies to the part of the multitree that
+ * cannot be placed in scratch files.
  * \param terminated_early Output parameter that will be set to true iff the time or memory limits
  * have been exceeded. \return The number of trees on the phylogenetic terrace containing the input
  * tree.
@@ -132,17 +245,42 @@ big_integer print_terrace_compressed(const supertree_data& data, const name_map&
                                      std::ostream& output, execution_limits limits,
                                      bool& terminated_early);
 
+/**
+ * Continues the enumeration of a terrace whose compressed multitree was cut short by the
+ * execution limits of \ref print_terrace_compressed or of a previous call of this function.
+ * The unexplored subtrees of the multitree are enumerated again within the new limits,
+ * while all other parts of the multitree are kept, so long enumerations can be split into
+ * several runs.
+ * \param data The constraints extracted from the tree and missing data matrix describing all
+ * possible supertrees. They need to be the same as for the original enumeration.
+ * \param names The name map containing only leaf names. It will be used to read and output the
+ * multitree.
+ * \param input The input stream containing the multitree.
+ * \param output The output stream into which the expanded multitree will be written.
+ * \param limits The execution limits for the algorithm. Both time and memory limits will be used.
+ * \param terminated_early Output parameter that will be set to true iff the multitree still
+ * contains unexplored subtrees.
+ * \return The number of trees represented by the expanded multitree.
+ * \throws bad_input_error if the input is not a valid multitree on the given leaf names.
+ */
+big_integer expand_terrace_compressed(const supertree_data& data, const name_map& names,
+                                      std::istream& input, std::ostream& output,
+                                      execution_limits limits, bool& terminated_early);
+
 /**
  * Enumerates all trees on a terrace around a phylogenetic tree.
  * The trees will be printed in Newick format, one tree per line
+ * The trees are generated one by one, so the memory usage does not depend on the size of the
+ * terrace.
  * \param data The constraints extracted from the tree and missing data matrix describing all
  * possible supertrees.
  * \param names The name map containing only leaf names. It will be used to output the multitree.
  * \param output The output stream into which the trees will be written.
- * \param limits The execution limits for the algorithm. Both time and memory limits will be used.
- * \param terminated_early Output parameter that will be set to true iff the time or memory limits
- * have been exceeded. \return The number of trees on the phylogenetic terrace containing the input
- * tree.
+ * \param limits The execution limits for the algorithm. Only the time limit will be used.
+ * \param terminated_early Output parameter that will be set to true iff the time limit has been
+ * exceeded. In this case, only some of the trees have been written.
+ * \return The number of trees written to the output, i.e. the number of trees on the
+ * phylogenetic terrace containing the input tree unless the time limit has been exceeded.
  */
 big_integer print_terrace(const supertree_data& data, const name_map& names, std::ostream& output,
                           execution_limits limits, bool& terminated_early);
@@ -150,30 +288,75 @@ big_integer print_terrace(const supertree_data& data, const name_map& names, std
 /**
  * Enumerates all trees on a terrace around a phylogenetic tree.
  * The given callback function will be called with every tree on the terrace as a parameter.
+ * The trees are generated one by one, so the memory usage does not depend on the size of the
+ * terrace.
  * \param data The constraints extracted from the tree and missing data matrix describing all
  * possible supertrees.
  * \param callback The callback function taking a tree as a parameter.
- * \param limits The execution limits for the algorithm. Both time and memory limits will be used.
- * \param terminated_early Output parameter that will be set to true iff the time or memory limits
- * have been exceeded.
+ * \param limits The execution limits for the algorithm. Only the time limit will be used.
+ * \param terminated_early Output parameter that will be set to true iff the time limit has been
+ * exceeded. In this case, the callback has only been called for some of the trees.
  */
 void enumerate_terrace(const supertree_data& data, std::function<void(const tree&)> callback,
                        execution_limits limits, bool& terminated_early);
 
+/**
+ * Enumerates all trees on a terrace around a phylogenetic tree like \ref enumerate_terrace,
+ * but additionally tells the callback which parts of the tree changed.
+ * Consecutive trees usually only differ in a few small subtrees, so consumers can update
+ * per-subtree results like partial likelihoods incrementally instead of recomputing them.
+ * The trees are enumerated from a multitree, so the memory usage depends on its size.
+ * \param data The constraints extracted from the tree and missing data matrix describing all
+ * possible supertrees.
+ * \param callback The callback function taking a tree and the sorted, disjoint ranges of node
+ * indices that changed since the previous tree as parameters. All nodes outside of them are
+ * the same as in the previous tree. For the first tree, the range covers the whole tree.
+ * \param limits The execution limits for the algorithm. The memory limit only applies to the
+ * multitree.
+ * \param terminated_early Output parameter that will be set to true iff the time or memory
+ * limit has been exceeded. In this case, the callback has only been called for some of the
+ * trees, or for none of them if the multitree could not be completed.
+ */
+void enumerate_terrace_incremental(
+        const supertree_data& data,
+        std::function<void(const tree&, const std::vector<node_range>&)> callback,
+        execution_limits limits, bool& terminated_early);
+
 /** \overload index count_terrace(const supertree_data&, execution_limits, bool&) */
 index_t count_terrace(const supertree_data& data);
 /** \overload index count_terrace(const supertree_data&, execution_limits, bool&) */
 big_integer count_terrace_bigint(const supertree_data& data);
+/** \overload double approx_count_terrace(const supertree_data&, execution_limits, bool&) */
+double approx_count_terrace(const supertree_data& data);
+/** \overload terrace_bounds bound_terrace(const supertree_data&, execution_limits,
+ * std::function<bool(const terrace_bounds&)>)
+ * The bounds are refined until they are exact or the time limit has been exceeded. */
+terrace_bounds bound_terrace(const supertree_data& data, execution_limits limits);
+/** \overload terrace_estimate estimate_terrace(const supertree_data&, index_t, std::uint64_t,
+ * execution_limits, bool&) */
+terrace_estimate estimate_terrace(const supertree_data& data, index_t num_probes);
+/** \overload big_integer count_terrace_modular(const supertree_data&, execution_limits, bool&)
+ */
+big_integer count_terrace_modular(const supertree_data& data);
 /** \overload big_integer print_terrace_compressed(const supertree_data&, const name_map&,
  * std::ostream&, execution_limits, bool&) */
 big_integer print_terrace_compressed(const supertree_data& data, const name_map& names,
                                      std::ostream& output);
+/** \overload big_integer expand_terrace_compressed(const supertree_data&, const name_map&,
+ * std::istream&, std::ostream&, execution_limits, bool&) */
+big_integer expand_terrace_compressed(const supertree_data& data, const name_map& names,
+                                      std::istream& input, std::ostream& output);
 /** \overload big_integer print_terrace(const supertree_data&, const name_map&, std::ostream&,
  * execution_limits, bool&) */
 big_integer print_terrace(const supertree_data& data, const name_map& names, std::ostream& output);
 /** \overload void enumerate_terrace(const supertree_data&, std::function<void(const tree&)>,
  * execution_limits, bool&) */
 void enumerate_terrace(const supertree_data& data, std::function<void(const tree&)> callback);
+/** \overload void enumerate_terrace_incremental(const supertree_data&,
+ * std::function<void(const tree&, const std::vector<node_range>&)>, execution_limits, bool&) */
+void enumerate_terrace_incremental(
+        const supertree_data& data,
+        std::function<void(const tree&, const std::vector<node_range>&)> callback);
 
 } // namespace terraces
 
@@ -11,21 +11,52 @@ using big_integer = terraces::overflow_except_uint;
 #else
 #include <gmpxx.h>
 #include <iosfwd>
+#include <memory>
 namespace terraces {
+/**
+ * An arbitrary-precision unsigned integer.
+ * Values that fit into a single \ref index_t are stored inline,
+ * only results that overflow it are stored as a GMP integer.
+ */
 class big_integer {
-	mpz_class m_value;
+	index_t m_small;
+	// nullptr as long as the value fits into m_small
+	std::unique_ptr<mpz_class> m_large;
+
+	void spill();
+	void shrink();
 
 public:
 	big_integer(index_t i = 0);
+	big_integer(const big_integer& other);
+	big_integer(big_integer&& other) noexcept = default;
+	big_integer& operator=(const big_integer& other);
+	big_integer& operator=(big_integer&& other) noexcept = default;
+	~big_integer();
 	big_integer& operator+=(const big_integer& other);
 	big_integer& operator*=(const big_integer& other);
+	/** Subtracts a value that is not larger than this one. */
+	big_integer& operator-=(const big_integer& other);
+	/** Divides by a non-zero value, rounding down. */
+	big_integer& operator/=(const big_integer& other);
+	/** Replaces the value by its remainder modulo a non-zero value. */
+	big_integer& operator%=(const big_integer& other);
 	bool is_clamped() const;
-	const mpz_class& value() const;
+	/** Returns true if the value is stored inline without using GMP. */
+	bool is_small() const { return m_large == nullptr; }
+	mpz_class value() const;
+
+	friend bool operator==(const big_integer& a, const big_integer& b);
+	friend bool operator<(const big_integer& a, const big_integer& b);
 };
 bool operator==(const big_integer& a, const big_integer& b);
 bool operator!=(const big_integer& a, const big_integer& b);
+bool operator<(const big_integer& a, const big_integer& b);
 big_integer operator+(const big_integer& a, const big_integer& b);
 big_integer operator*(const big_integer& a, const big_integer& b);
+big_integer operator-(const big_integer& a, const big_integer& b);
+big_integer operator/(const big_integer& a, const big_integer& b);
+big_integer operator%(const big_integer& a, const big_integer& b);
 std::ostream& operator<<(std::ostream& stream, const big_integer& val);
 } // namespace terraces
 #endif
@@ -16,6 +16,12 @@ public:
 
 	checked_uint<except>& operator+=(checked_uint<except> other);
 	checked_uint<except>& operator*=(checked_uint<except> other);
+	/** Subtracts a value that is not larger than this one. */
+	checked_uint<except>& operator-=(checked_uint<except> other);
+	/** Divides by a non-zero value, rounding down. */
+	checked_uint<except>& operator/=(checked_uint<except> other);
+	/** Replaces the value by its remainder modulo a non-zero value. */
+	checked_uint<except>& operator%=(checked_uint<except> other);
 	bool is_clamped() const;
 	index_t value() const;
 };
@@ -26,12 +32,24 @@ bool operator==(checked_uint<except> a, checked_uint<except> b);
 template <bool except>
 bool operator!=(checked_uint<except> a, checked_uint<except> b);
 
+template <bool except>
+bool operator<(checked_uint<except> a, checked_uint<except> b);
+
 template <bool except>
 checked_uint<except> operator+(checked_uint<except> a, checked_uint<except> b);
 
 template <bool except>
 checked_uint<except> operator*(checked_uint<except> a, checked_uint<except> b);
 
+template <bool except>
+checked_uint<except> operator-(checked_uint<except> a, checked_uint<except> b);
+
+template <bool except>
+checked_uint<except> operator/(checked_uint<except> a, checked_uint<except> b);
+
+template <bool except>
+checked_uint<except> operator%(checked_uint<except> a, checked_uint<except> b);
+
 template <bool except>
 std::ostream& operator<<(std::ostream& stream, checked_uint<except> val);
 
@@ -34,6 +34,8 @@ enum class bad_input_error_type {
 	tree_mismatching_size,
 	/** Unnamed leaf found in a tree. */
 	tree_unnamed_leaf,
+	/** Malformed or unsupported binary multitree file. */
+	multitree_malformed,
 };
 
 /** This error is thrown if the input to a function is malformed. */
@@ -54,6 +54,15 @@ struct node {
 /** A tree is represented by its nodes. The root of a tree is stored at index 0. */
 using tree = std::vector<node>;
 
+/** A range [begin, end) of node indices of a tree, e.g. a subtree. */
+struct node_range {
+	index_t begin;
+	index_t end;
+
+	bool operator==(const node_range& o) const { return begin == o.begin && end == o.end; }
+	bool operator!=(const node_range& o) const { return !(o == *this); }
+};
+
 /** Stores the name for every node (or leaf) of a tree. */
 using name_map = std::vector<std::string>;
 
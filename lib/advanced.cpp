@@ -1,14 +1,26 @@
 #include <terraces/advanced.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <thread>
+
 #include <terraces/clamped_uint.hpp>
 #include <terraces/errors.hpp>
 #include <terraces/rooting.hpp>
 #include <terraces/subtree_extraction.hpp>
 
+#include "modular_count.hpp"
+#include "multitree_expansion.hpp"
 #include "multitree_iterator.hpp"
+#include "multitree_parser.hpp"
 #include "supertree_enumerator.hpp"
+#include "supertree_enumerator_parallel.hpp"
+#include "supertree_iterator.hpp"
 #include "supertree_variants.hpp"
 #include "supertree_variants_multitree.hpp"
+#include "terrace_estimator.hpp"
 
 namespace terraces {
 
@@ -70,13 +82,72 @@ index_t fast_count_terrace(const supertree_data& data) {
 
 bool check_terrace(const supertree_data& data) { return fast_count_terrace(data) > 1; }
 
-index_t count_terrace(const supertree_data& data, execution_limits limits, bool& terminated_early) {
-	tree_enumerator<variants::timeout_decorator<variants::clamped_count_callback>> enumerator{
-	        {limits.time_limit_seconds}};
-	try {
-		auto result = enumerator.run(data.num_leaves, data.constraints, data.root).value();
+namespace {
+
+index_t num_threads(execution_limits limits) {
+	if (limits.num_threads == 0) {
+		return std::max<index_t>(std::thread::hardware_concurrency(), 1);
+	}
+	return limits.num_threads;
+}
+
+bool time_limit_exceeded(std::chrono::system_clock::time_point start, execution_limits limits) {
+	auto elapsed = index_t(std::chrono::duration_cast<std::chrono::seconds>(
+	                               std::chrono::system_clock::now() - start)
+	                               .count());
+	return elapsed > limits.time_limit_seconds;
+}
+
+template <typename Callback>
+typename Callback::result_type count_with_callback(const supertree_data& data,
+                                                   execution_limits limits, Callback cb,
+                                                   bool& terminated_early) {
+	auto threads = num_threads(limits);
+	if (threads == 1) {
+		tree_enumerator<Callback> enumerator{cb};
+		auto result = enumerator.run(data.num_leaves, data.constraints, data.root);
 		terminated_early = enumerator.callback().has_timed_out();
 		return result;
+	}
+	parallel_tree_enumerator<Callback> enumerator{cb, threads};
+	auto result = enumerator.run(data.num_leaves, data.constraints, data.root);
+	terminated_early = false;
+	for (index_t i = 0; i < enumerator.num_workers(); ++i) {
+		terminated_early = terminated_early || enumerator.callback(i).has_timed_out();
+	}
+	return result;
+}
+
+template <typename Callback, typename... Args>
+typename Callback::result_type count_with_limits(const supertree_data& data,
+                                                 execution_limits limits,
+                                                 bool& terminated_early, Args&&... args) {
+	if (limits.cache_limit_bytes > 0) {
+		using memo_callback =
+		        variants::timeout_decorator<variants::memoization_decorator<Callback>>;
+		// every worker gets a copy of the callback and thus its own share of the cache
+		auto cache_bytes = limits.cache_limit_bytes / num_threads(limits);
+		return count_with_callback(data, limits,
+		                           memo_callback{limits.time_limit_seconds, cache_bytes,
+		                                         std::forward<Args>(args)...},
+		                           terminated_early);
+	}
+	using callback = variants::timeout_decorator<Callback>;
+	return count_with_callback(
+	        data, limits, callback{limits.time_limit_seconds, std::forward<Args>(args)...},
+	        terminated_early);
+}
+
+// number of primes used in each modular counting pass
+constexpr index_t modular_count_width = 8;
+
+} // anonymous namespace
+
+index_t count_terrace(const supertree_data& data, execution_limits limits, bool& terminated_early) {
+	try {
+		return count_with_limits<variants::clamped_count_callback>(data, limits,
+		                                                           terminated_early)
+		        .value();
 	} catch (terraces::tree_count_overflow_error&) {
 		return std::numeric_limits<index_t>::max();
 	}
@@ -84,11 +155,122 @@ index_t count_terrace(const supertree_data& data, execution_limits limits, bool&
 
 big_integer count_terrace_bigint(const supertree_data& data, execution_limits limits,
                                  bool& terminated_early) {
-	tree_enumerator<variants::timeout_decorator<variants::count_callback<big_integer>>>
-	        enumerator{{limits.time_limit_seconds}};
-	auto result = enumerator.run(data.num_leaves, data.constraints, data.root);
-	terminated_early = enumerator.callback().has_timed_out();
-	return result;
+	return count_with_limits<variants::count_callback<big_integer>>(data, limits,
+	                                                                terminated_early);
+}
+
+double approx_count_terrace(const supertree_data& data, execution_limits limits,
+                            bool& terminated_early) {
+	return count_with_limits<variants::approx_count_callback>(data, limits,
+	                                                          terminated_early) /
+	       std::log(10.0);
+}
+
+terrace_bounds bound_terrace(const supertree_data& data, execution_limits limits,
+                             std::function<bool(const terrace_bounds&)> refine) {
+	using clock = std::chrono::system_clock;
+	auto deadline = clock::time_point::max();
+	// avoid overflows for (almost) unlimited time
+	if (limits.time_limit_seconds < index_t(std::numeric_limits<std::int32_t>::max())) {
+		deadline = clock::now() + std::chrono::seconds(limits.time_limit_seconds);
+	}
+	terrace_bounds bounds;
+	// the root call has only a single bipartition
+	index_t first_depth = 2;
+	for (auto depth = first_depth;; depth *= 2) {
+		tree_enumerator<variants::interval_count_callback> enumerator{{depth, deadline}};
+		auto result = enumerator.run(data.num_leaves, data.constraints, data.root);
+		const auto& cb = enumerator.callback();
+		// an interrupted round may be less precise than the previous one
+		if (cb.deadline_passed() && depth > first_depth) {
+			break;
+		}
+		bounds = {result.lower, result.upper};
+		if (!cb.was_cut_off() || cb.deadline_passed() || !refine(bounds)) {
+			break;
+		}
+	}
+	return bounds;
+}
+
+terrace_estimate estimate_terrace(const supertree_data& data, index_t num_probes,
+                                  std::uint64_t seed, execution_limits limits,
+                                  bool& terminated_early) {
+	auto start = std::chrono::system_clock::now();
+	num_probes = std::max<index_t>(num_probes, 1);
+	auto threads = std::min(num_threads(limits), num_probes);
+	std::vector<std::vector<double>> log_estimates(threads);
+	std::vector<std::exception_ptr> errors(threads);
+	std::atomic<bool> timed_out{false};
+	// every thread takes its share of the probes with its own random seed
+	auto worker = [&](index_t thread) {
+		try {
+			auto& estimates = log_estimates[thread];
+			terrace_estimator estimator{data.num_leaves, data.constraints,
+			                            seed + thread};
+			auto thread_probes = num_probes / threads + (thread < num_probes % threads);
+			for (index_t i = 0; i < thread_probes && !timed_out; ++i) {
+				estimates.push_back(estimator.probe(data.root));
+				if (time_limit_exceeded(start, limits)) {
+					timed_out = true;
+				}
+			}
+		} catch (...) {
+			errors[thread] = std::current_exception();
+		}
+	};
+	std::vector<std::thread> workers;
+	for (index_t thread = 1; thread < threads; ++thread) {
+		workers.emplace_back(worker, thread);
+	}
+	worker(0);
+	for (auto& t : workers) {
+		t.join();
+	}
+	for (auto& error : errors) {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+	terminated_early = timed_out;
+
+	std::vector<double> all_estimates;
+	for (const auto& estimates : log_estimates) {
+		all_estimates.insert(all_estimates.end(), estimates.begin(), estimates.end());
+	}
+	auto stats = log_estimate_statistics(all_estimates);
+	auto log10 = std::log(10.0);
+	return {stats.log_mean / log10, stats.log_lower / log10, stats.log_upper / log10,
+	        all_estimates.size()};
+}
+
+big_integer count_terrace_modular(const supertree_data& data, execution_limits limits,
+                                  bool& terminated_early) {
+	using callback = variants::modular_count_callback<modular_count_width>;
+	auto start = std::chrono::system_clock::now();
+	auto num_primes = modular_count_num_primes(data.num_leaves);
+	num_primes = (num_primes + modular_count_width - 1) / modular_count_width *
+	             modular_count_width;
+	auto primes = modular_count_primes(num_primes);
+	std::vector<std::uint64_t> residues;
+	auto time_limit = limits.time_limit_seconds;
+	for (index_t pass = 0; pass < num_primes; pass += modular_count_width) {
+		auto result = count_with_limits<callback>(data, limits, terminated_early,
+		                                          primes.data() + pass);
+		if (terminated_early) {
+			return 0;
+		}
+		callback decoder{primes.data() + pass};
+		for (index_t k = 0; k < modular_count_width; ++k) {
+			residues.push_back(decoder.residue(result, k));
+		}
+		// the time limit applies to all passes together
+		auto elapsed = index_t(std::chrono::duration_cast<std::chrono::seconds>(
+		                               std::chrono::system_clock::now() - start)
+		                               .count());
+		limits.time_limit_seconds = time_limit - std::min(time_limit, elapsed);
+	}
+	return crt_reconstruct(residues, primes);
 }
 
 using limited_multitree_callback =
@@ -98,44 +280,96 @@ big_integer print_terrace_compressed(const supertree_data& data, const name_map&
                                      std::ostream& output, execution_limits limits,
                                      bool& terminated_early) {
 	tree_enumerator<limited_multitree_callback> enumerator{
-	        limited_multitree_callback{limits.time_limit_seconds, limits.mem_limit_bytes}};
+	        limited_multitree_callback{limits.time_limit_seconds, limits.mem_limit_bytes,
+	                                   limits.spill_directory}};
 	auto result = enumerator.run(data.num_leaves, data.constraints, data.root);
 	terminated_early = enumerator.callback().has_timed_out() ||
 	                   enumerator.callback().has_hit_memory_limit();
 	output << as_newick(result, names);
 
-	return result->num_trees;
+	return result->num_trees.value();
 }
 
-big_integer print_terrace(const supertree_data& data, const name_map& names, std::ostream& output,
-                          execution_limits limits, bool& terminated_early) {
+big_integer expand_terrace_compressed(const supertree_data& data, const name_map& names,
+                                      std::istream& input, std::ostream& output,
+                                      execution_limits limits, bool& terminated_early) {
+	index_map indices;
+	for (index_t i = 0; i < names.size(); ++i) {
+		indices.emplace(names[i], i);
+	}
+	auto multitree = parse_multitree(input, indices);
 	tree_enumerator<limited_multitree_callback> enumerator{
-	        limited_multitree_callback{limits.time_limit_seconds, limits.mem_limit_bytes}};
-	auto result = enumerator.run(data.num_leaves, data.constraints, data.root);
-	terminated_early = enumerator.callback().has_timed_out() ||
-	                   enumerator.callback().has_hit_memory_limit();
-	if (!terminated_early) {
-		multitree_iterator mit{result};
-		do {
-			output << as_newick(mit.tree(), names) << '\n';
-		} while (mit.next());
+	        limited_multitree_callback{limits.time_limit_seconds, limits.mem_limit_bytes,
+	                                   limits.spill_directory}};
+	terminated_early = expand_unexplored(enumerator, multitree.root, data) > 0;
+	output << as_newick(multitree.root, names);
+
+	return multitree.root->num_trees.value();
+}
+
+namespace {
+
+template <typename Callback>
+big_integer stream_terrace(const supertree_data& data, execution_limits limits,
+                           bool& terminated_early, Callback callback) {
+	auto start = std::chrono::system_clock::now();
+	big_integer num_trees = 0;
+	terminated_early = false;
+	supertree_iterator it{data.num_leaves, data.constraints, data.root};
+	if (!it.is_valid()) {
+		return num_trees;
 	}
-	return result->num_trees;
+	do {
+		callback(it.tree());
+		num_trees += 1;
+		auto diff = index_t(std::chrono::duration_cast<std::chrono::seconds>(
+		                            std::chrono::system_clock::now() - start)
+		                            .count());
+		if (diff > limits.time_limit_seconds) {
+			terminated_early = true;
+			break;
+		}
+	} while (it.next());
+	return num_trees;
+}
+
+} // anonymous namespace
+
+big_integer print_terrace(const supertree_data& data, const name_map& names, std::ostream& output,
+                          execution_limits limits, bool& terminated_early) {
+	return stream_terrace(data, limits, terminated_early, [&](const tree& t) {
+		output << as_newick(t, names) << '\n';
+	});
 }
 
 void enumerate_terrace(const supertree_data& data, std::function<void(const tree&)> callback,
                        execution_limits limits, bool& terminated_early) {
+	stream_terrace(data, limits, terminated_early, callback);
+}
+
+void enumerate_terrace_incremental(
+        const supertree_data& data,
+        std::function<void(const tree&, const std::vector<node_range>&)> callback,
+        execution_limits limits, bool& terminated_early) {
+	auto start = std::chrono::system_clock::now();
 	tree_enumerator<limited_multitree_callback> enumerator{
-	        limited_multitree_callback{limits.time_limit_seconds, limits.mem_limit_bytes}};
+	        limited_multitree_callback{limits.time_limit_seconds, limits.mem_limit_bytes,
+	                                   limits.spill_directory}};
 	auto result = enumerator.run(data.num_leaves, data.constraints, data.root);
 	terminated_early = enumerator.callback().has_timed_out() ||
 	                   enumerator.callback().has_hit_memory_limit();
-	if (!terminated_early) {
-		multitree_iterator mit{result};
-		do {
-			callback(mit.tree());
-		} while (mit.next());
+	// an incomplete multitree cannot be enumerated
+	if (terminated_early) {
+		return;
 	}
+	multitree_iterator it{result};
+	do {
+		callback(it.tree(), it.changed_ranges());
+		if (time_limit_exceeded(start, limits)) {
+			terminated_early = true;
+			break;
+		}
+	} while (it.next());
 }
 
 index_t count_terrace(const supertree_data& data) {
@@ -150,6 +384,28 @@ big_integer count_terrace_bigint(const supertree_data& data) {
 	return count_terrace_bigint(data, limits, tmp);
 }
 
+double approx_count_terrace(const supertree_data& data) {
+	execution_limits limits{};
+	bool tmp;
+	return approx_count_terrace(data, limits, tmp);
+}
+
+terrace_bounds bound_terrace(const supertree_data& data, execution_limits limits) {
+	return bound_terrace(data, limits, [](const terrace_bounds&) { return true; });
+}
+
+terrace_estimate estimate_terrace(const supertree_data& data, index_t num_probes) {
+	execution_limits limits{};
+	bool tmp;
+	return estimate_terrace(data, num_probes, 0, limits, tmp);
+}
+
+big_integer count_terrace_modular(const supertree_data& data) {
+	execution_limits limits{};
+	bool tmp;
+	return count_terrace_modular(data, limits, tmp);
+}
+
 big_integer print_terrace_compressed(const supertree_data& data, const name_map& names,
                                      std::ostream& output) {
 	execution_limits limits{};
@@ -157,6 +413,13 @@ big_integer print_terrace_compressed(const supertree_data& data, const name_map&
 	return print_terrace_compressed(data, names, output, limits, tmp);
 }
 
+big_integer expand_terrace_compressed(const supertree_data& data, const name_map& names,
+                                      std::istream& input, std::ostream& output) {
+	execution_limits limits{};
+	bool tmp;
+	return expand_terrace_compressed(data, names, input, output, limits, tmp);
+}
+
 big_integer print_terrace(const supertree_data& data, const name_map& names, std::ostream& output) {
 	execution_limits limits{};
 	bool tmp;
@@ -169,4 +432,12 @@ void enumerate_terrace(const supertree_data& data, std::function<void(const tree
 	return enumerate_terrace(data, std::move(callback), limits, tmp);
 }
 
+void enumerate_terrace_incremental(
+        const supertree_data& data,
+        std::function<void(const tree&, const std::vector<node_range>&)> callback) {
+	execution_limits limits{};
+	bool tmp;
+	return enumerate_terrace_incremental(data, std::move(callback), limits, tmp);
+}
+
 } // namespace terraces
@@ -1,20 +1,116 @@
 #include <terraces/bigint.hpp>
 
+#include <cassert>
 #include <ostream>
 
 #ifdef USE_GMP
+#include "intrinsics.hpp"
+
 namespace terraces {
-big_integer::big_integer(index_t i) : m_value{i} {}
+big_integer::big_integer(index_t i) : m_small{i} {}
+big_integer::big_integer(const big_integer& other) : m_small{other.m_small} {
+	if (!other.is_small()) {
+		m_large.reset(new mpz_class{*other.m_large});
+	}
+}
+big_integer& big_integer::operator=(const big_integer& other) {
+	if (other.is_small()) {
+		m_small = other.m_small;
+		m_large.reset();
+	} else if (is_small()) {
+		m_large.reset(new mpz_class{*other.m_large});
+	} else {
+		*m_large = *other.m_large;
+	}
+	return *this;
+}
+big_integer::~big_integer() = default;
+
+void big_integer::spill() {
+	if (is_small()) {
+		m_large.reset(new mpz_class{m_small});
+	}
+}
+
+void big_integer::shrink() {
+	if (!is_small() && m_large->fits_ulong_p()) {
+		m_small = m_large->get_ui();
+		m_large.reset();
+	}
+}
+
 big_integer& big_integer::operator+=(const big_integer& other) {
-	m_value += other.m_value;
+	if (is_small() && other.is_small()) {
+		index_t result;
+		if (!bits::add_overflow(m_small, other.m_small, result)) {
+			m_small = result;
+			return *this;
+		}
+	}
+	spill();
+	if (other.is_small()) {
+		*m_large += other.m_small;
+	} else {
+		*m_large += *other.m_large;
+	}
 	return *this;
 }
+
 big_integer& big_integer::operator*=(const big_integer& other) {
-	m_value *= other.m_value;
+	if (is_small() && other.is_small()) {
+		index_t result;
+		if (!bits::mul_overflow(m_small, other.m_small, result)) {
+			m_small = result;
+			return *this;
+		}
+	}
+	spill();
+	if (other.is_small()) {
+		*m_large *= other.m_small;
+	} else {
+		*m_large *= *other.m_large;
+	}
 	return *this;
 }
+
+big_integer& big_integer::operator-=(const big_integer& other) {
+	assert(!(*this < other));
+	if (is_small() && other.is_small()) {
+		m_small -= other.m_small;
+		return *this;
+	}
+	spill();
+	*m_large -= other.value();
+	shrink();
+	return *this;
+}
+
+big_integer& big_integer::operator/=(const big_integer& other) {
+	assert(other != big_integer{0});
+	if (is_small() && other.is_small()) {
+		m_small /= other.m_small;
+		return *this;
+	}
+	spill();
+	*m_large /= other.value();
+	shrink();
+	return *this;
+}
+
+big_integer& big_integer::operator%=(const big_integer& other) {
+	assert(other != big_integer{0});
+	if (is_small() && other.is_small()) {
+		m_small %= other.m_small;
+		return *this;
+	}
+	spill();
+	*m_large %= other.value();
+	shrink();
+	return *this;
+}
+
 bool big_integer::is_clamped() const { return false; }
-const mpz_class& big_integer::value() const { return m_value; }
+mpz_class big_integer::value() const { return is_small() ? mpz_class{m_small} : *m_large; }
 
 big_integer operator+(const big_integer& a, const big_integer& b) {
 	big_integer result = a;
@@ -28,10 +124,40 @@ big_integer operator*(const big_integer& a, const big_integer& b) {
 	return result;
 }
 
-bool operator==(const big_integer& a, const big_integer& b) { return a.value() == b.value(); }
+bool operator==(const big_integer& a, const big_integer& b) {
+	if (a.is_small() && b.is_small()) {
+		return a.m_small == b.m_small;
+	}
+	return a.value() == b.value();
+}
 
 bool operator!=(const big_integer& a, const big_integer& b) { return !(a == b); }
 
+bool operator<(const big_integer& a, const big_integer& b) {
+	if (a.is_small() && b.is_small()) {
+		return a.m_small < b.m_small;
+	}
+	return a.value() < b.value();
+}
+
+big_integer operator-(const big_integer& a, const big_integer& b) {
+	big_integer result = a;
+	result -= b;
+	return result;
+}
+
+big_integer operator/(const big_integer& a, const big_integer& b) {
+	big_integer result = a;
+	result /= b;
+	return result;
+}
+
+big_integer operator%(const big_integer& a, const big_integer& b) {
+	big_integer result = a;
+	result %= b;
+	return result;
+}
+
 std::ostream& operator<<(std::ostream& stream, const big_integer& val) {
 	return stream << val.value();
 }
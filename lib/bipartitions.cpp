@@ -1,5 +1,6 @@
 #include "bipartitions.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <ostream>
 
@@ -12,14 +13,12 @@ namespace terraces {
 
 bipartitions::bipartitions(const ranked_bitvector& leaves, const union_find& sets,
                            utils::stack_allocator<index_t> a)
-        : m_alloc{a}, m_leaves{leaves}, m_sets{sets}, m_set_rep{find_set_reps()}, m_end{} {
+        : m_alloc{a}, m_leaves{leaves}, m_sets{sets}, m_set_rep{find_set_reps()},
+          m_set_masks(utils::stack_allocator<set_mask>{a, m_set_rep.count() - 1}), m_end{} {
 	utils::ensure<tree_count_overflow_error>(m_set_rep.count() < bits::word_bits,
 	                                         "Huge terrace encountered");
 	m_end = index_t(1) << (m_set_rep.count() - 1);
-}
-
-bool bipartitions::in_left_partition(index_t bip, index_t i) const {
-	return (bip & (index_t(1) << ((i - 1) % bits::word_bits))) != 0;
+	init_set_masks();
 }
 
 ranked_bitvector bipartitions::find_set_reps() const {
@@ -31,20 +30,50 @@ ranked_bitvector bipartitions::find_set_reps() const {
 	return set_rep;
 }
 
-ranked_bitvector bipartitions::get_first_set(index_t bip,
-                                             utils::stack_allocator<index_t> alloc) const {
-	ranked_bitvector subleaves(m_leaves.size(), alloc);
+void bipartitions::init_set_masks() {
+	const auto num_masks = m_set_rep.count() - 1;
+	m_set_masks.reserve(num_masks);
+	for (index_t s = 0; s < num_masks; ++s) {
+		m_set_masks.push_back({bitvector{m_leaves.size(), m_alloc}, none, 0});
+	}
 	index_t ii = 0;
 	for (auto i = m_leaves.first_set(); i < m_leaves.last_set(); i = m_leaves.next_set(i)) {
-		if (in_left_partition(bip, m_set_rep.rank(m_sets.simple_find(ii)))) {
-			subleaves.set(i);
+		// the first set always belongs to the second leaf set
+		auto s = m_set_rep.rank(m_sets.simple_find(ii));
+		if (s > 0) {
+			auto& mask = m_set_masks[s - 1];
+			mask.leaves.set(i);
+			mask.first_block = std::min(mask.first_block, bits::block_index(i));
+			mask.end_block = bits::block_index(i) + 1;
 		}
 		++ii;
 	}
+}
+
+ranked_bitvector bipartitions::get_first_set(index_t bip,
+                                             utils::stack_allocator<index_t> alloc) const {
+	assert(bip < m_end);
+	ranked_bitvector subleaves(m_leaves.size(), alloc);
+	for (; bip != 0; bip &= bip - 1) {
+		const auto& mask = m_set_masks[bits::bitscan(bip)];
+		subleaves.bitwise_xor(mask.leaves, mask.first_block, mask.end_block);
+	}
 	subleaves.update_ranks();
 	return subleaves;
 }
 
+void bipartitions::next_first_set(ranked_bitvector& set, index_t bip) const {
+	assert(bip > 0 && bip < m_end);
+	// incrementing the index flips the trailing ones and the lowest zero bit
+	auto first_block = set.num_blocks() - 1;
+	for (auto changes = bip ^ (bip - 1); changes != 0; changes &= changes - 1) {
+		const auto& mask = m_set_masks[bits::bitscan(changes)];
+		set.bitwise_xor(mask.leaves, mask.first_block, mask.end_block);
+		first_block = std::min(first_block, mask.first_block);
+	}
+	set.update_ranks(first_block);
+}
+
 void bipartitions::flip_set(ranked_bitvector& set) const {
 	set.bitwise_xor(m_leaves);
 	set.update_ranks();
@@ -3,6 +3,7 @@
 
 #include <cmath>
 #include <iosfwd>
+#include <vector>
 
 #include <terraces/trees.hpp>
 
@@ -14,26 +15,47 @@ namespace terraces {
 /**
  * An iterator enumerating all possible bipartition from a given union-find representation of leaf
  * sets.
+ * A bipartition index contains one bit for every set except the first one,
+ * which always belongs to the second leaf set.
+ * The leaves of every set are stored as a bitvector mask, so the first leaf set can be updated
+ * from one bipartition index to the next using \ref next_first_set,
+ * which moves two sets on average.
  */
 class bipartitions {
 private:
+	struct set_mask {
+		bitvector leaves;
+		// range of blocks containing leaves from this set
+		index_t first_block;
+		index_t end_block;
+	};
+
 	utils::stack_allocator<index_t> m_alloc;
 	const ranked_bitvector& m_leaves;
 	const union_find& m_sets;
 	const ranked_bitvector m_set_rep;
+	// the leaves of every set that can be moved to the first leaf set,
+	// stored in the arena of m_alloc if there is one
+	std::vector<set_mask, utils::stack_allocator<set_mask>> m_set_masks;
 
 	index_t m_end;
 
-	bool in_left_partition(index_t bip, index_t i) const;
 	/** Returns a bitvector containing a 1 for every set representative in the union-find
 	 * structure. */
 	ranked_bitvector find_set_reps() const;
+	void init_set_masks();
 
 public:
 	bipartitions(const ranked_bitvector& leaves, const union_find& sets,
 	             utils::stack_allocator<index_t>);
 	/** Returns the first leaf set represented by the given bipartition index. */
 	ranked_bitvector get_first_set(index_t bip, utils::stack_allocator<index_t> alloc) const;
+	/**
+	 * Turns the first leaf set of bipartition index bip - 1 into the first leaf set of
+	 * bipartition index bip, for 0 < bip < \ref end_bip.
+	 * The empty set get_first_set(0, alloc) can be used to start with \ref begin_bip.
+	 */
+	void next_first_set(ranked_bitvector& set, index_t bip) const;
 	/** Replaces a leaf subset by its complement. */
 	void flip_set(ranked_bitvector& set) const;
 	/** Returns both leaf sets represented by the given bipartition index. */
@@ -7,6 +7,7 @@
 #include <terraces/trees.hpp>
 
 #include "bits.hpp"
+#include "small_vector.hpp"
 #include "stack_allocator.hpp"
 
 namespace terraces {
@@ -21,10 +22,18 @@ public:
 	using iterator = bitvector_iterator<Allocator>;
 
 	static index_t alloc_size(index_t size) { return size / bits::word_bits + 1; }
+	/**
+	 * The number of blocks stored inside the bitvector itself.
+	 * Bitvectors with at most 8 * 64 - 1 = 511 elements (one bit is the sentinel)
+	 * never use the allocator.
+	 */
+	static constexpr std::size_t inline_blocks = 8;
 
 protected:
+	using block_storage = utils::small_vector<value_type, Allocator, inline_blocks>;
+
 	index_t m_size;
-	std::vector<value_type, Allocator> m_blocks;
+	block_storage m_blocks;
 
 	void add_sentinel() {
 		// add sentinel bit for iteration
@@ -37,6 +46,9 @@ public:
 	        : m_size{size}, m_blocks(alloc_size(size), 0, alloc) {
 		add_sentinel();
 	}
+	/** Copies a bitvector into storage obtained from the given allocator. */
+	basic_bitvector(const basic_bitvector& other, Allocator alloc)
+	        : m_size{other.m_size}, m_blocks(other.m_blocks, alloc) {}
 	/** Sets a bit in the bitvector. */
 	void set(index_t i) {
 		assert(i < m_size);
@@ -59,9 +71,20 @@ public:
 	}
 	/** Returns the size of the bitvector. */
 	index_t size() const { return m_size; }
+	/** Returns the number of storage blocks (including the sentinel bit). */
+	index_t num_blocks() const { return m_blocks.size(); }
+	/** Returns a storage block. */
+	value_type block(index_t b) const { return m_blocks[b]; }
+	/** Overwrites a storage block. The sentinel bit must be kept set. */
+	void set_block(index_t b, value_type value) {
+		m_blocks[b] = value;
+		assert(b != bits::block_index(m_size) || (value & bits::set_mask(m_size)));
+	}
 
 	/** Returns true if and only if no bit is set. */
 	bool empty() const;
+	/** Returns the number of set bits. */
+	index_t count() const;
 
 	/** Clears all bits in the bitvector. */
 	void blank();
@@ -69,6 +92,9 @@ public:
 	void invert();
 	/** Applies element-wise xor from another bitvector. */
 	void bitwise_xor(const basic_bitvector<Allocator>& other);
+	/** Applies element-wise xor from the blocks [first_block, end_block) of another vector. */
+	void bitwise_xor(const basic_bitvector<Allocator>& other, index_t first_block,
+	                 index_t end_block);
 	/** Sets the values of this bitvector to the bitwise or of two bitvectors. */
 	void set_bitwise_or(const basic_bitvector<Allocator>& fst,
 	                    const basic_bitvector<Allocator>& snd);
@@ -139,6 +165,16 @@ bool basic_bitvector<Alloc>::empty() const {
 	return !(m_blocks[m_blocks.size() - 1] & bits::prefix_mask(bits::shift_index(m_size)));
 }
 
+template <typename Alloc>
+index_t basic_bitvector<Alloc>::count() const {
+	index_t result = 0;
+	for (auto el : m_blocks) {
+		result += bits::popcount(el);
+	}
+	// ignore sentinel bit
+	return result - 1;
+}
+
 template <typename Alloc>
 void basic_bitvector<Alloc>::blank() {
 	for (auto& el : m_blocks) {
@@ -156,6 +192,17 @@ void basic_bitvector<Alloc>::bitwise_xor(const basic_bitvector<Alloc>& other) {
 	add_sentinel();
 }
 
+template <typename Alloc>
+void basic_bitvector<Alloc>::bitwise_xor(const basic_bitvector<Alloc>& other, index_t first_block,
+                                         index_t end_block) {
+	assert(size() == other.size());
+	assert(first_block <= end_block && end_block <= m_blocks.size());
+	for (index_t b = first_block; b < end_block; ++b) {
+		m_blocks[b] ^= other.m_blocks[b];
+	}
+	add_sentinel();
+}
+
 template <typename Alloc>
 void basic_bitvector<Alloc>::invert() {
 	for (index_t b = 0; b < m_blocks.size() - 1; ++b) {
@@ -1,5 +1,6 @@
 #include <terraces/clamped_uint.hpp>
 
+#include <cassert>
 #include <ostream>
 #include <terraces/errors.hpp>
 
@@ -46,6 +47,27 @@ checked_uint<true>& checked_uint<true>::operator*=(checked_uint<true> other) {
 	return *this;
 }
 
+template <bool except>
+checked_uint<except>& checked_uint<except>::operator-=(checked_uint<except> other) {
+	assert(other.m_value <= m_value);
+	m_value -= other.m_value;
+	return *this;
+}
+
+template <bool except>
+checked_uint<except>& checked_uint<except>::operator/=(checked_uint<except> other) {
+	assert(other.m_value != 0);
+	m_value /= other.m_value;
+	return *this;
+}
+
+template <bool except>
+checked_uint<except>& checked_uint<except>::operator%=(checked_uint<except> other) {
+	assert(other.m_value != 0);
+	m_value %= other.m_value;
+	return *this;
+}
+
 template <bool except>
 bool checked_uint<except>::is_clamped() const {
 	return m_value == max_index;
@@ -66,6 +88,11 @@ bool operator!=(checked_uint<except> a, checked_uint<except> b) {
 	return !(a == b);
 }
 
+template <bool except>
+bool operator<(checked_uint<except> a, checked_uint<except> b) {
+	return a.value() < b.value();
+}
+
 template <bool except>
 checked_uint<except> operator+(checked_uint<except> a, checked_uint<except> b) {
 	return a += b;
@@ -76,6 +103,21 @@ checked_uint<except> operator*(checked_uint<except> a, checked_uint<except> b) {
 	return a *= b;
 }
 
+template <bool except>
+checked_uint<except> operator-(checked_uint<except> a, checked_uint<except> b) {
+	return a -= b;
+}
+
+template <bool except>
+checked_uint<except> operator/(checked_uint<except> a, checked_uint<except> b) {
+	return a /= b;
+}
+
+template <bool except>
+checked_uint<except> operator%(checked_uint<except> a, checked_uint<except> b) {
+	return a %= b;
+}
+
 template <bool except>
 std::ostream& operator<<(std::ostream& stream, checked_uint<except> val) {
 	if (val.is_clamped()) {
@@ -92,14 +134,22 @@ template class checked_uint<true>;
 // explicitly instantiate template functions
 template bool operator==(checked_uint<false>, checked_uint<false>);
 template bool operator!=(checked_uint<false>, checked_uint<false>);
+template bool operator<(checked_uint<false>, checked_uint<false>);
 template checked_uint<false> operator+(checked_uint<false>, checked_uint<false>);
 template checked_uint<false> operator*(checked_uint<false>, checked_uint<false>);
+template checked_uint<false> operator-(checked_uint<false>, checked_uint<false>);
+template checked_uint<false> operator/(checked_uint<false>, checked_uint<false>);
+template checked_uint<false> operator%(checked_uint<false>, checked_uint<false>);
 template std::ostream& operator<<(std::ostream&, checked_uint<false>);
 
 template bool operator==(checked_uint<true>, checked_uint<true>);
 template bool operator!=(checked_uint<true>, checked_uint<true>);
+template bool operator<(checked_uint<true>, checked_uint<true>);
 template checked_uint<true> operator+(checked_uint<true>, checked_uint<true>);
 template checked_uint<true> operator*(checked_uint<true>, checked_uint<true>);
+template checked_uint<true> operator-(checked_uint<true>, checked_uint<true>);
+template checked_uint<true> operator/(checked_uint<true>, checked_uint<true>);
+template checked_uint<true> operator%(checked_uint<true>, checked_uint<true>);
 template std::ostream& operator<<(std::ostream&, checked_uint<true>);
 
 } // namespace terraces
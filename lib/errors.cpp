@@ -33,6 +33,8 @@ std::string build_error_message(bad_input_error_type type) {
 		return "Mismatching size between tree and bitmatrix";
 	case bad_input_error_type::tree_unnamed_leaf:
 		return "Unnamed leaf found in tree";
+	case bad_input_error_type::multitree_malformed:
+		return "Malformed binary multitree";
 	}
 	return "Unknown error";
 }
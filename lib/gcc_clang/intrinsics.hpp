@@ -1,4 +1,5 @@
 #include <terraces/definitions.hpp>
+#include <cstdint>
 
 namespace terraces {
 namespace bits {
@@ -21,5 +22,13 @@ inline bool mul_overflow(index_t a, index_t b, index_t& result) {
 	return __builtin_mul_overflow(a, b, &result);
 }
 
+/** Returns the low word of the 128-bit product a * b and stores the high word in hi. */
+inline std::uint64_t mul_wide(std::uint64_t a, std::uint64_t b, std::uint64_t& hi) {
+	__extension__ typedef unsigned __int128 uint128;
+	auto product = uint128(a) * b;
+	hi = std::uint64_t(product >> 64);
+	return std::uint64_t(product);
+}
+
 } // namespace bits
 } // namespace terraces
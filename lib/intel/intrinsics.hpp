@@ -1,4 +1,5 @@
 #include <terraces/definitions.hpp>
+#include <cstdint>
 
 namespace terraces {
 namespace bits {
@@ -55,5 +56,27 @@ inline bool mul_overflow(index_t a, index_t b, index_t& result) {
 	}
 }
 
+#if defined(__LP64__) || defined(_LP64)
+/** Returns the low word of the 128-bit product a * b and stores the high word in hi. */
+inline std::uint64_t mul_wide(std::uint64_t a, std::uint64_t b, std::uint64_t& hi) {
+	using uint128 = unsigned __int128;
+	auto product = uint128(a) * b;
+	hi = std::uint64_t(product >> 64);
+	return std::uint64_t(product);
+}
+#else
+/** Returns the low word of the 128-bit product a * b and stores the high word in hi. */
+inline std::uint64_t mul_wide(std::uint64_t a, std::uint64_t b, std::uint64_t& hi) {
+	constexpr std::uint64_t mask = 0xFFFFFFFFu;
+	auto lo_lo = (a & mask) * (b & mask);
+	auto lo_hi = (a & mask) * (b >> 32);
+	auto hi_lo = (a >> 32) * (b & mask);
+	auto hi_hi = (a >> 32) * (b >> 32);
+	auto mid = (lo_lo >> 32) + (lo_hi & mask) + (hi_lo & mask);
+	hi = hi_hi + (lo_hi >> 32) + (hi_lo >> 32) + (mid >> 32);
+	return (mid << 32) | (lo_lo & mask);
+}
+#endif
+
 } // namespace bits
 } // namespace terraces
@@ -0,0 +1,91 @@
+#include "mapped_file.hpp"
+
+#include <cstdlib>
+
+#include <terraces/errors.hpp>
+
+#include "io_utils.hpp"
+#include "utils.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TERRACES_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace terraces {
+namespace utils {
+
+mapped_file::mapped_file(const std::string& filename)
+        : m_data{nullptr}, m_size{0}, m_mapped{false} {
+#ifdef TERRACES_HAS_MMAP
+	auto fd = ::open(filename.c_str(), O_RDONLY);
+	utils::ensure<file_open_error>(fd >= 0, "failed to open " + filename);
+	struct stat info;
+	if (::fstat(fd, &info) != 0) {
+		::close(fd);
+		throw file_open_error{"failed to stat " + filename};
+	}
+	m_size = std::size_t(info.st_size);
+	if (m_size > 0) {
+		auto data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			::close(fd);
+			throw file_open_error{"failed to map " + filename};
+		}
+		m_data = static_cast<const char*>(data);
+		m_mapped = true;
+	}
+	// the mapping stays valid after closing the file descriptor
+	::close(fd);
+#else
+	auto stream = std::ifstream{filename, std::ios::binary};
+	utils::ensure<file_open_error>(stream.is_open(), "failed to open " + filename);
+	using it = std::istreambuf_iterator<char>;
+	m_buffer.assign(it{stream}, it{});
+	m_data = m_buffer.data();
+	m_size = m_buffer.size();
+#endif
+}
+
+mapped_file::~mapped_file() {
+#ifdef TERRACES_HAS_MMAP
+	if (m_mapped) {
+		::munmap(const_cast<char*>(m_data), m_size);
+	}
+#endif
+}
+
+scratch_mapping::scratch_mapping(const std::string& directory, std::size_t size)
+        : m_data{nullptr}, m_size{size} {
+#ifdef TERRACES_HAS_MMAP
+	auto filename = directory + "/terraces_scratch_XXXXXX";
+	auto fd = ::mkstemp(&filename[0]);
+	utils::ensure<file_open_error>(fd >= 0, "failed to create " + filename);
+	// the file stays accessible through the mapping only
+	::unlink(filename.c_str());
+	if (::ftruncate(fd, off_t(size)) != 0) {
+		::close(fd);
+		throw file_open_error{"failed to resize " + filename};
+	}
+	auto data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	utils::ensure<file_open_error>(data != MAP_FAILED, "failed to map " + filename);
+	m_data = static_cast<char*>(data);
+#else
+	(void)directory;
+	m_buffer.resize(size);
+	m_data = m_buffer.data();
+#endif
+}
+
+scratch_mapping::~scratch_mapping() {
+#ifdef TERRACES_HAS_MMAP
+	::munmap(m_data, m_size);
+#endif
+}
+
+} // namespace utils
+} // namespace terraces
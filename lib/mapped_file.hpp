@@ -0,0 +1,60 @@
+#ifndef TERRACES_MAPPED_FILE_HPP
+#define TERRACES_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace terraces {
+namespace utils {
+
+/**
+ * A read-only view of the whole contents of a file.
+ * On POSIX systems, the file is memory-mapped, so pages are only read when they are accessed.
+ * On other systems, the file is read into memory instead.
+ */
+class mapped_file {
+private:
+	const char* m_data;
+	std::size_t m_size;
+	bool m_mapped;
+	std::vector<char> m_buffer;
+
+public:
+	/** \throws file_open_error if the file cannot be opened. */
+	explicit mapped_file(const std::string& filename);
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+	~mapped_file();
+
+	const char* data() const { return m_data; }
+	std::size_t size() const { return m_size; }
+};
+
+/**
+ * A zero-initialized writable memory region backed by a temporary file.
+ * On POSIX systems, the file is created in the given directory and removed immediately,
+ * so the operating system can page the region out to it and reclaims it on exit.
+ * On other systems, the region is allocated in memory instead.
+ */
+class scratch_mapping {
+private:
+	char* m_data;
+	std::size_t m_size;
+	std::vector<char> m_buffer;
+
+public:
+	/** \throws file_open_error if the scratch file cannot be created or mapped. */
+	scratch_mapping(const std::string& directory, std::size_t size);
+	scratch_mapping(const scratch_mapping&) = delete;
+	scratch_mapping& operator=(const scratch_mapping&) = delete;
+	~scratch_mapping();
+
+	char* data() const { return m_data; }
+	std::size_t size() const { return m_size; }
+};
+
+} // namespace utils
+} // namespace terraces
+
+#endif // TERRACES_MAPPED_FILE_HPP
@@ -0,0 +1,113 @@
+#include "modular_count.hpp"
+
+#include <cassert>
+#include <cmath>
+
+namespace terraces {
+
+montgomery_modulus::montgomery_modulus(std::uint64_t mod) : m_mod{mod}, m_neg_inv{mod} {
+	assert(mod % 2 == 1 && mod < (std::uint64_t(1) << 62));
+	// Newton iteration doubles the number of correct low bits: 3 -> 6 -> ... -> 96
+	for (int i = 0; i < 5; ++i) {
+		m_neg_inv *= 2 - mod * m_neg_inv;
+	}
+	m_neg_inv = std::uint64_t(0) - m_neg_inv;
+	// 2^64 mod m, doubled another 64 times
+	m_r2 = (std::uint64_t(0) - mod) % mod;
+	for (int i = 0; i < 64; ++i) {
+		m_r2 = reduce_once(m_r2 * 2);
+	}
+}
+
+std::uint64_t montgomery_modulus::pow(std::uint64_t base, std::uint64_t exp) const {
+	auto result = to_montgomery(1);
+	for (; exp > 0; exp /= 2) {
+		if (exp % 2 == 1) {
+			result = mul(result, base);
+		}
+		base = mul(base, base);
+	}
+	return result;
+}
+
+bool is_prime(std::uint64_t n) {
+	assert(n % 2 == 1 && n > 2);
+	montgomery_modulus mod{n};
+	auto d = n - 1;
+	index_t s = 0;
+	for (; d % 2 == 0; d /= 2) {
+		++s;
+	}
+	auto one = mod.to_montgomery(1);
+	auto minus_one = mod.to_montgomery(n - 1);
+	// these bases are sufficient for deterministic Miller-Rabin tests below 3 * 10^24
+	for (std::uint64_t base : {2u, 3u, 5u, 7u, 11u, 13u, 17u, 19u, 23u, 29u, 31u, 37u}) {
+		if (base % n == 0) {
+			continue;
+		}
+		auto x = mod.pow(mod.to_montgomery(base), d);
+		if (x == one || x == minus_one) {
+			continue;
+		}
+		bool witness = true;
+		for (index_t i = 1; i < s && witness; ++i) {
+			x = mod.mul(x, x);
+			witness = x != minus_one;
+		}
+		if (witness) {
+			return false;
+		}
+	}
+	return true;
+}
+
+std::vector<std::uint64_t> modular_count_primes(index_t count) {
+	std::vector<std::uint64_t> primes;
+	primes.reserve(count);
+	for (auto candidate = (std::uint64_t(1) << 62) - 1; primes.size() < count;
+	     candidate -= 2) {
+		if (is_prime(candidate)) {
+			primes.push_back(candidate);
+		}
+	}
+	return primes;
+}
+
+index_t modular_count_num_primes(index_t num_leaves) {
+	// log2 of the number of unrooted trees 1 * 3 * ... * (2 * num_leaves - 3)
+	double log_bound = 0;
+	for (index_t i = 3; i <= num_leaves + 1; ++i) {
+		log_bound += std::log2(double(2 * i - 5));
+	}
+	// all primes are larger than 2^61
+	return index_t(std::floor((log_bound + 1e-6) / 61)) + 1;
+}
+
+big_integer crt_reconstruct(const std::vector<std::uint64_t>& residues,
+                            const std::vector<std::uint64_t>& primes) {
+	assert(residues.size() == primes.size());
+	// mixed-radix digits: x = d_0 + p_0 * (d_1 + p_1 * (d_2 + ...))
+	std::vector<std::uint64_t> digits(residues.size());
+	for (index_t i = 0; i < residues.size(); ++i) {
+		montgomery_modulus mod{primes[i]};
+		// the lower digits d_0 + p_0 * d_1 + ... and the product p_0 * ... * p_i-1 mod p_i
+		auto lower = mod.to_montgomery(0);
+		auto prefix_product = mod.to_montgomery(1);
+		for (index_t j = 0; j < i; ++j) {
+			auto digit = mod.to_montgomery(digits[j]);
+			lower = mod.add(lower, mod.mul(digit, prefix_product));
+			prefix_product = mod.mul(prefix_product, mod.to_montgomery(primes[j]));
+		}
+		auto diff = mod.sub(mod.to_montgomery(residues[i]), lower);
+		auto inverse = mod.pow(prefix_product, primes[i] - 2);
+		digits[i] = mod.from_montgomery(mod.mul(diff, inverse));
+	}
+	big_integer result = 0;
+	for (index_t i = residues.size(); i > 0; --i) {
+		result = result * big_integer{index_t(primes[i - 1])} +
+		         big_integer{index_t(digits[i - 1])};
+	}
+	return result;
+}
+
+} // namespace terraces
@@ -0,0 +1,169 @@
+#ifndef TERRACES_MODULAR_COUNT_HPP
+#define TERRACES_MODULAR_COUNT_HPP
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <terraces/bigint.hpp>
+
+#include "bits.hpp"
+#include "supertree_variants.hpp"
+
+namespace terraces {
+
+/**
+ * Arithmetic modulo an odd modulus m < 2^62 in Montgomery representation,
+ * i.e. a residue x is stored as x * 2^64 mod m.
+ * Additions and multiplications are branch-free and need no divisions.
+ */
+class montgomery_modulus {
+private:
+	std::uint64_t m_mod;
+	// -m^-1 mod 2^64
+	std::uint64_t m_neg_inv;
+	// 2^128 mod m
+	std::uint64_t m_r2;
+
+	std::uint64_t reduce_once(std::uint64_t x) const {
+		return x - (m_mod & (std::uint64_t(0) - std::uint64_t(x >= m_mod)));
+	}
+
+	/** Returns (hi * 2^64 + lo) / 2^64 mod m for hi < m. */
+	std::uint64_t redc(std::uint64_t hi, std::uint64_t lo) const {
+		std::uint64_t q_hi;
+		bits::mul_wide(lo * m_neg_inv, m_mod, q_hi);
+		// lo + the low word of q * m is 0 mod 2^64, so it carries iff lo is non-zero
+		return reduce_once(hi + q_hi + std::uint64_t(lo != 0));
+	}
+
+public:
+	montgomery_modulus() : m_mod{1}, m_neg_inv{0}, m_r2{0} {}
+	explicit montgomery_modulus(std::uint64_t mod);
+
+	std::uint64_t modulus() const { return m_mod; }
+
+	std::uint64_t to_montgomery(std::uint64_t x) const { return mul(x % m_mod, m_r2); }
+	std::uint64_t from_montgomery(std::uint64_t x) const { return redc(0, x); }
+
+	std::uint64_t add(std::uint64_t a, std::uint64_t b) const { return reduce_once(a + b); }
+	std::uint64_t sub(std::uint64_t a, std::uint64_t b) const {
+		return a - b + (m_mod & (std::uint64_t(0) - std::uint64_t(a < b)));
+	}
+	std::uint64_t mul(std::uint64_t a, std::uint64_t b) const {
+		std::uint64_t hi;
+		auto lo = bits::mul_wide(a, b, hi);
+		return redc(hi, lo);
+	}
+	/** Returns base^exp for base in Montgomery representation. */
+	std::uint64_t pow(std::uint64_t base, std::uint64_t exp) const;
+};
+
+/** Returns true if and only if the odd number 2 < n < 2^62 is prime. */
+bool is_prime(std::uint64_t n);
+
+/** Returns the \p count largest primes below 2^62 in descending order. */
+std::vector<std::uint64_t> modular_count_primes(index_t count);
+
+/**
+ * Returns the number of primes from \ref modular_count_primes whose product exceeds
+ * the number of unrooted trees with \p num_leaves leaves,
+ * and thus the size of every terrace on these leaves.
+ */
+index_t modular_count_num_primes(index_t num_leaves);
+
+/**
+ * Reconstructs the unique integer 0 <= x < p_0 * ... * p_k-1 from its residues x mod p_i
+ * using Garner's algorithm.
+ */
+big_integer crt_reconstruct(const std::vector<std::uint64_t>& residues,
+                            const std::vector<std::uint64_t>& primes);
+
+namespace variants {
+
+template <index_t K>
+/**
+ * A callback implementation that counts all trees modulo K different primes.
+ * All intermediate results have a fixed size, the exact count can be reconstructed
+ * from the residues of sufficiently many primes using \ref crt_reconstruct.
+ */
+class modular_count_callback : public abstract_callback<std::array<std::uint64_t, K>> {
+public:
+	using return_type = typename abstract_callback<std::array<std::uint64_t, K>>::result_type;
+
+private:
+	std::array<montgomery_modulus, K> m_moduli;
+	// m_unrooted[n] contains the number of unrooted trees with n leaves
+	std::vector<return_type> m_unrooted;
+
+	return_type mul(return_type a, const return_type& b) const {
+		for (index_t k = 0; k < K; ++k) {
+			a[k] = m_moduli[k].mul(a[k], b[k]);
+		}
+		return a;
+	}
+
+	return_type mul(return_type a, index_t factor) const {
+		for (index_t k = 0; k < K; ++k) {
+			a[k] = m_moduli[k].mul(a[k], m_moduli[k].to_montgomery(factor));
+		}
+		return a;
+	}
+
+public:
+	/** Uses the K primes starting at \p primes as moduli. */
+	explicit modular_count_callback(const std::uint64_t* primes) {
+		return_type one;
+		for (index_t k = 0; k < K; ++k) {
+			m_moduli[k] = montgomery_modulus{primes[k]};
+			one[k] = m_moduli[k].to_montgomery(1);
+		}
+		// 1 tree each for 0 and 1 leaves
+		m_unrooted.assign(2, one);
+	}
+
+	/** Returns the residue of \p value modulo the k-th prime. */
+	std::uint64_t residue(const return_type& value, index_t k) const {
+		return m_moduli[k].from_montgomery(value[k]);
+	}
+
+	return_type base_one_leaf(index_t) { return m_unrooted[1]; }
+	return_type base_two_leaves(index_t, index_t) { return m_unrooted[1]; }
+	return_type base_unconstrained(const ranked_bitvector& leaves) {
+		auto num_leaves = leaves.count();
+		while (m_unrooted.size() <= num_leaves) {
+			auto n = m_unrooted.size();
+			m_unrooted.push_back(mul(m_unrooted.back(), 2 * n - 3));
+		}
+		return m_unrooted[num_leaves];
+	}
+	return_type null_result() const { return {}; }
+
+	// The number of bipartitions gives a lower bound on the number of trees.
+	return_type fast_return_value(const bipartitions& bip_it) {
+		return mul(m_unrooted[1], bip_it.num_bip());
+	}
+
+	bool separate_free_leaves() { return true; }
+	return_type add_free_leaves(return_type val, index_t num_constrained, index_t num_free) {
+		for (index_t i = num_constrained; i < num_constrained + num_free; ++i) {
+			val = mul(val, 2 * i - 1);
+		}
+		return val;
+	}
+
+	return_type accumulate(return_type acc, const return_type& val) {
+		for (index_t k = 0; k < K; ++k) {
+			acc[k] = m_moduli[k].add(acc[k], val[k]);
+		}
+		return acc;
+	}
+	return_type combine(const return_type& left, const return_type& right) {
+		return mul(left, right);
+	}
+};
+
+} // namespace variants
+} // namespace terraces
+
+#endif // TERRACES_MODULAR_COUNT_HPP
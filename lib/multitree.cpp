@@ -1,8 +1,29 @@
 #include "multitree.hpp"
 #include "io_utils.hpp"
 
+#include <unordered_map>
+
 namespace terraces {
 
+void tree_count::set(const big_integer& value) {
+	if (value < big_integer{max_inline}) {
+#ifdef USE_GMP
+		m_word = std::uint64_t{value.value().get_ui()} << 1;
+#else
+		m_word = value.value() << 1;
+#endif
+	} else {
+		auto address = reinterpret_cast<std::uintptr_t>(new big_integer{value});
+		m_word = std::uint64_t(address) | 1;
+	}
+}
+
+void tree_count::release() { delete &large(); }
+
+std::ostream& operator<<(std::ostream& stream, const tree_count& count) {
+	return stream << count.value();
+}
+
 struct index_array_view {
 	index_t* _begin;
 	index_t* _end;
@@ -10,8 +31,9 @@ struct index_array_view {
 	index_t* end() const { return _end; }
 };
 
+template <typename PrintChild>
 std::ostream& print_multitree_node(std::ostream& stream, const multitree_node* node,
-                                   const name_map& names) {
+                                   const name_map& names, PrintChild& print_child) {
 	switch (node->type) {
 	case multitree_node_type::base_single_leaf:
 		return stream << names[node->single_leaf];
@@ -29,9 +51,9 @@ std::ostream& print_multitree_node(std::ostream& stream, const multitree_node* n
 	case multitree_node_type::inner_node: {
 		auto& in = node->inner_node;
 		stream << '(';
-		print_multitree_node(stream, in.left, names);
+		print_child(in.left);
 		stream << ',';
-		print_multitree_node(stream, in.right, names);
+		print_child(in.right);
 		stream << ')';
 		return stream;
 	}
@@ -41,7 +63,7 @@ std::ostream& print_multitree_node(std::ostream& stream, const multitree_node* n
 			if (it != aa.begin) {
 				stream << '|';
 			}
-			print_multitree_node(stream, it, names);
+			print_multitree_node(stream, it, names, print_child);
 		}
 		return stream;
 	}
@@ -58,10 +80,66 @@ std::ostream& print_multitree_node(std::ostream& stream, const multitree_node* n
 	}
 }
 
+class shared_child_printer {
+private:
+	std::ostream& m_stream;
+	const name_map& m_names;
+	// number of inner nodes referencing each node
+	std::unordered_map<const multitree_node*, index_t> m_references;
+	std::unordered_map<const multitree_node*, index_t> m_labels;
+
+	void count_references(const multitree_node* node) {
+		switch (node->type) {
+		case multitree_node_type::inner_node:
+			count_child_reference(node->inner_node.left);
+			count_child_reference(node->inner_node.right);
+			break;
+		case multitree_node_type::alternative_array: {
+			auto& aa = node->alternative_array;
+			for (auto it = aa.begin; it != aa.end; ++it) {
+				count_references(it);
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	void count_child_reference(const multitree_node* child) {
+		// only descend into each shared node once
+		if (++m_references[child] == 1) {
+			count_references(child);
+		}
+	}
+
+public:
+	shared_child_printer(std::ostream& stream, const name_map& names,
+	                     const multitree_node* root)
+	        : m_stream{stream}, m_names{names} {
+		count_references(root);
+	}
+
+	void operator()(const multitree_node* child) {
+		if (m_references[child] > 1) {
+			auto label = m_labels.find(child);
+			if (label != m_labels.end()) {
+				m_stream << '#' << label->second << '#';
+				return;
+			}
+			auto new_label = m_labels.size() + 1;
+			m_labels.emplace(child, new_label);
+			m_stream << '#' << new_label << '=';
+		}
+		print_multitree_node(m_stream, child, m_names, *this);
+	}
+};
+
 std::ostream& operator<<(std::ostream& stream, newick_multitree_t tree) {
 	auto node = tree.root;
 	auto& names = *tree.names;
-	return print_multitree_node(stream, node, names);
+	shared_child_printer print_child{stream, names, node};
+	return print_multitree_node(stream, node, names, print_child);
 }
 
 } // namespace terraces
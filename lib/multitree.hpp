@@ -1,13 +1,109 @@
 #ifndef MULTITREE_HPP
 #define MULTITREE_HPP
 
+#include "bits.hpp"
 #include "trees_impl.hpp"
 
 #include <terraces/bigint.hpp>
 
+#include <cstdint>
+
 namespace terraces {
 
-enum class multitree_node_type {
+/**
+ * The number of trees represented by a multitree node in a single word.
+ * Values below 2^63 are stored inline, shifted by one bit,
+ * larger values are stored out of line as a \ref big_integer tagged by the lowest bit.
+ */
+class tree_count {
+private:
+	static constexpr std::uint64_t max_inline = std::uint64_t{1} << 63;
+
+	std::uint64_t m_word;
+
+	bool is_large() const { return (m_word & 1) != 0; }
+	const big_integer& large() const {
+		auto address = std::uintptr_t(m_word & ~std::uint64_t{1});
+		return *reinterpret_cast<const big_integer*>(address);
+	}
+	void set(const big_integer& value);
+	void release();
+
+public:
+	tree_count(index_t value = 0) {
+		if (value < max_inline) {
+			m_word = value << 1;
+		} else {
+			set(value);
+		}
+	}
+	tree_count(const big_integer& value) { set(value); }
+	tree_count(const tree_count& other) : m_word{other.m_word} {
+		if (other.is_large()) {
+			set(other.large());
+		}
+	}
+	tree_count(tree_count&& other) noexcept : m_word{other.m_word} { other.m_word = 0; }
+	tree_count& operator=(const tree_count& other) {
+		if (is_large() || other.is_large()) {
+			*this = tree_count{other};
+		} else {
+			m_word = other.m_word;
+		}
+		return *this;
+	}
+	tree_count& operator=(tree_count&& other) noexcept {
+		std::swap(m_word, other.m_word);
+		return *this;
+	}
+	~tree_count() {
+		if (is_large()) {
+			release();
+		}
+	}
+
+	tree_count& operator+=(const tree_count& other) {
+		// the sum of two inline values fits into a word
+		auto sum = (m_word >> 1) + (other.m_word >> 1);
+		if (is_large() || other.is_large() || sum >= max_inline) {
+			return *this = tree_count{value() + other.value()};
+		}
+		m_word = sum << 1;
+		return *this;
+	}
+
+	/** Returns true if the value is stored out of line. */
+	bool is_out_of_line() const { return is_large(); }
+
+	big_integer value() const { return is_large() ? large() : big_integer{m_word >> 1}; }
+
+	friend tree_count operator*(const tree_count& a, const tree_count& b) {
+		index_t product;
+		if (!a.is_large() && !b.is_large() &&
+		    !bits::mul_overflow(a.m_word >> 1, b.m_word >> 1, product)) {
+			return product;
+		}
+		return a.value() * b.value();
+	}
+	friend bool operator==(const tree_count& a, const tree_count& b) {
+		// values are stored inline whenever possible
+		if (!a.is_large() || !b.is_large()) {
+			return a.m_word == b.m_word;
+		}
+		return a.large() == b.large();
+	}
+	friend bool operator!=(const tree_count& a, const tree_count& b) { return !(a == b); }
+	friend bool operator<(const tree_count& a, const tree_count& b) {
+		if (!a.is_large() && !b.is_large()) {
+			return a.m_word < b.m_word;
+		}
+		return a.value() < b.value();
+	}
+};
+
+std::ostream& operator<<(std::ostream& stream, const tree_count& count);
+
+enum class multitree_node_type : std::uint8_t {
 	base_single_leaf,
 	base_two_leaves,
 	base_unconstrained,
@@ -44,10 +140,14 @@ struct unexplored {
 };
 } // namespace multitree_nodes
 
+/**
+ * A node of a multitree.
+ * The layout is kept compact, since a multitree may consist of a huge number of nodes.
+ */
 struct multitree_node {
 	multitree_node_type type;
-	index_t num_leaves;
-	big_integer num_trees;
+	std::uint32_t num_leaves;
+	tree_count num_trees;
 	union {
 		index_t single_leaf;
 		multitree_nodes::two_leaves two_leaves;
@@ -65,6 +165,13 @@ struct newick_multitree_t {
 
 std::ostream& operator<<(std::ostream& stream, newick_multitree_t tree);
 
+/**
+ * Prints a multitree in the compressed Newick format.
+ * Sub-multitrees that are shared by several inner nodes are only printed once:
+ * Their first occurrence is prefixed by a label #k=, all later occurrences are replaced by
+ * the reference #k#. A label refers to the whole child subtree up to the next ',' or ')',
+ * including all of its alternatives.
+ */
 inline newick_multitree_t as_newick(const multitree_node* root, const name_map& names) {
 	return {root, &names};
 }
@@ -0,0 +1,237 @@
+#include "multitree_expansion.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace terraces {
+
+namespace {
+
+using node_set = std::unordered_set<const multitree_node*>;
+
+void collect_unexplored(multitree_node* node, node_set& visited,
+                        std::vector<multitree_node*>& result) {
+	if (!visited.insert(node).second) {
+		return;
+	}
+	switch (node->type) {
+	case multitree_node_type::unexplored:
+		result.push_back(node);
+		break;
+	case multitree_node_type::inner_node:
+		collect_unexplored(node->inner_node.left, visited, result);
+		collect_unexplored(node->inner_node.right, visited, result);
+		break;
+	case multitree_node_type::alternative_array: {
+		auto& aa = node->alternative_array;
+		bool has_unexplored = false;
+		for (auto it = aa.begin; it != aa.end; ++it) {
+			if (it->type == multitree_node_type::unexplored) {
+				has_unexplored = true;
+			} else {
+				collect_unexplored(it, visited, result);
+			}
+		}
+		if (has_unexplored) {
+			result.push_back(node);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+/**
+ * Recomputes the number of trees of the given nodes and their ancestors among them.
+ * The counts of all other nodes are up to date.
+ */
+void update_tree_counts(multitree_node* node, const node_set& outdated, node_set& visited) {
+	if (outdated.count(node) == 0 || !visited.insert(node).second) {
+		return;
+	}
+	switch (node->type) {
+	case multitree_node_type::inner_node: {
+		auto left = node->inner_node.left;
+		auto right = node->inner_node.right;
+		update_tree_counts(left, outdated, visited);
+		update_tree_counts(right, outdated, visited);
+		node->num_trees = left->num_trees * right->num_trees;
+		break;
+	}
+	case multitree_node_type::alternative_array: {
+		auto& aa = node->alternative_array;
+		node->num_trees = 0;
+		for (auto it = aa.begin; it != aa.end; ++it) {
+			update_tree_counts(it, outdated, visited);
+			node->num_trees += it->num_trees;
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+class complete_subtree_finder {
+private:
+	using visitor = std::function<void(const ranked_bitvector&, multitree_node*)>;
+
+	std::unordered_map<const multitree_node*, bool> m_complete;
+	node_set m_visited_subtrees;
+	utils::free_list m_free_list;
+	index_t m_num_leaves;
+	const visitor& m_visit;
+
+	// all trees of a node have the same leaves, so the first one suffices
+	void collect_leaves(const multitree_node* node, ranked_bitvector& leaves) {
+		switch (node->type) {
+		case multitree_node_type::base_single_leaf:
+			leaves.set(node->single_leaf);
+			break;
+		case multitree_node_type::base_two_leaves:
+			leaves.set(node->two_leaves.left_leaf);
+			leaves.set(node->two_leaves.right_leaf);
+			break;
+		case multitree_node_type::base_unconstrained: {
+			auto& uc = node->unconstrained;
+			for (auto it = uc.begin; it != uc.end; ++it) {
+				leaves.set(*it);
+			}
+			break;
+		}
+		case multitree_node_type::unexplored:
+			for (auto it = node->unexplored.begin; it != node->unexplored.end; ++it) {
+				leaves.set(*it);
+			}
+			break;
+		case multitree_node_type::inner_node:
+			collect_leaves(node->inner_node.left, leaves);
+			collect_leaves(node->inner_node.right, leaves);
+			break;
+		case multitree_node_type::alternative_array:
+			assert(node->alternative_array.num_alternatives() > 0);
+			collect_leaves(node->alternative_array.begin, leaves);
+			break;
+		}
+	}
+
+	/** Returns true if and only if the sub-multitree contains no unexplored nodes. */
+	bool is_complete(multitree_node* node) {
+		auto it = m_complete.find(node);
+		if (it != m_complete.end()) {
+			return it->second;
+		}
+		bool complete = true;
+		switch (node->type) {
+		case multitree_node_type::unexplored:
+			complete = false;
+			break;
+		case multitree_node_type::inner_node: {
+			// visit both children, since either may be complete on its own
+			auto left_complete = visit_subtree(node->inner_node.left);
+			auto right_complete = visit_subtree(node->inner_node.right);
+			complete = left_complete && right_complete;
+			break;
+		}
+		case multitree_node_type::alternative_array: {
+			auto& aa = node->alternative_array;
+			for (auto alt = aa.begin; alt != aa.end; ++alt) {
+				complete = is_complete(alt) && complete;
+			}
+			break;
+		}
+		default:
+			break;
+		}
+		m_complete.emplace(node, complete);
+		return complete;
+	}
+
+public:
+	complete_subtree_finder(index_t num_leaves, const visitor& visit)
+	        : m_num_leaves{num_leaves}, m_visit{visit} {}
+
+	/** Visits the sub-multitree if it is complete and returns true in this case. */
+	bool visit_subtree(multitree_node* node) {
+		auto complete = is_complete(node);
+		// the enumerator handles subtrees with less than three leaves directly
+		if (complete && node->num_leaves > 2 && m_visited_subtrees.insert(node).second) {
+			auto alloc_size = ranked_bitvector::alloc_size(m_num_leaves);
+			ranked_bitvector leaves{m_num_leaves, {m_free_list, alloc_size}};
+			collect_leaves(node, leaves);
+			leaves.update_ranks();
+			m_visit(leaves, node);
+		}
+		return complete;
+	}
+};
+
+} // anonymous namespace
+
+std::vector<multitree_node*> unexplored_nodes(multitree_node* root) {
+	node_set visited;
+	std::vector<multitree_node*> result;
+	collect_unexplored(root, visited, result);
+	return result;
+}
+
+namespace {
+
+/** Returns the leaves of a node returned by \ref unexplored_nodes. */
+multitree_nodes::unexplored unexplored_leaves(const multitree_node* node) {
+	if (node->type == multitree_node_type::alternative_array) {
+		auto& aa = node->alternative_array;
+		for (auto it = aa.begin; it != aa.end; ++it) {
+			if (it->type == multitree_node_type::unexplored) {
+				return it->unexplored;
+			}
+		}
+	}
+	assert(node->type == multitree_node_type::unexplored);
+	return node->unexplored;
+}
+
+} // anonymous namespace
+
+void for_each_complete_subtree(
+        multitree_node* root, index_t num_leaves,
+        const std::function<void(const ranked_bitvector&, multitree_node*)>& visit) {
+	complete_subtree_finder{num_leaves, visit}.visit_subtree(root);
+}
+
+index_t expand_unexplored(
+        multitree_node* root, index_t num_leaves,
+        const std::function<bool(const multitree_node&)>& select,
+        const std::function<multitree_node*(const multitree_nodes::unexplored&)>& expand,
+        const std::function<void(const ranked_bitvector&, multitree_node*)>& reuse) {
+	for_each_complete_subtree(root, num_leaves, reuse);
+	// only the counts of the original nodes change, the expansions are up to date
+	node_set outdated;
+	std::vector<multitree_node*> nodes;
+	collect_unexplored(root, outdated, nodes);
+	utils::free_list free_list;
+	for (auto node : nodes) {
+		if (!select(*node)) {
+			continue;
+		}
+		auto leaves = unexplored_leaves(node);
+		auto result = expand(leaves);
+		assert(result->num_leaves == node->num_leaves);
+		*node = *result;
+		outdated.erase(node);
+		// the parents of the node can use its expansion, even if it is incomplete again
+		ranked_bitvector leaf_set{num_leaves,
+		                          {free_list, ranked_bitvector::alloc_size(num_leaves)}};
+		for (auto it = leaves.begin; it != leaves.end; ++it) {
+			leaf_set.set(*it);
+		}
+		leaf_set.update_ranks();
+		reuse(leaf_set, node);
+	}
+	node_set visited;
+	update_tree_counts(root, outdated, visited);
+	return unexplored_nodes(root).size();
+}
+
+} // namespace terraces
@@ -0,0 +1,81 @@
+#ifndef TERRACES_MULTITREE_EXPANSION_HPP
+#define TERRACES_MULTITREE_EXPANSION_HPP
+
+#include <functional>
+#include <vector>
+
+#include <terraces/advanced.hpp>
+
+#include "multitree.hpp"
+#include "ranked_bitvector.hpp"
+#include "supertree_enumerator.hpp"
+
+namespace terraces {
+
+/**
+ * Returns all distinct nodes of a multitree that need to be expanded, children first.
+ * These are unexplored nodes and alternative arrays containing an unexplored alternative,
+ * which stands for the alternatives that have not been explored.
+ */
+std::vector<multitree_node*> unexplored_nodes(multitree_node* root);
+
+/**
+ * Calls \p visit for all sub-multitrees without unexplored nodes that represent all trees on
+ * their leaf set, i.e. the root and the children of inner nodes, together with their leaf set.
+ */
+void for_each_complete_subtree(
+        multitree_node* root, index_t num_leaves,
+        const std::function<void(const ranked_bitvector&, multitree_node*)>& visit);
+
+/**
+ * Expands the nodes from \ref unexplored_nodes for which \p select returns true in place,
+ * children first. Every such node is overwritten by the result of \p expand for its leaves.
+ * All complete sub-multitrees are passed to \p reuse beforehand and every expanded node
+ * afterwards, so later expansions can use them instead of enumerating their trees again.
+ * Afterwards, the tree counts of all nodes are updated.
+ * \returns The number of nodes that still need to be expanded.
+ */
+index_t expand_unexplored(
+        multitree_node* root, index_t num_leaves,
+        const std::function<bool(const multitree_node&)>& select,
+        const std::function<multitree_node*(const multitree_nodes::unexplored&)>& expand,
+        const std::function<void(const ranked_bitvector&, multitree_node*)>& reuse);
+
+/**
+ * Expands the unexplored nodes of a multitree selected by \p select in place
+ * using an enumerator with a \ref variants::multitree_callback.
+ * The new nodes are stored in the enumerator's callback, so the enumerator must outlive the
+ * multitree. Limits of the callback apply to the expansion, which may thus contain smaller
+ * unexplored nodes again.
+ * \param data The supertree data the multitree was computed from.
+ * \returns The number of nodes that still need to be expanded.
+ */
+template <typename Callback, typename Select>
+index_t expand_unexplored(tree_enumerator<Callback>& enumerator, multitree_node* root,
+                          const supertree_data& data, Select select) {
+	return expand_unexplored(
+	        root, data.num_leaves, select,
+	        [&](const multitree_nodes::unexplored& leaves) {
+		        // only the root covers all leaves, it always uses the root split
+		        if (leaves.num_leaves() == data.num_leaves) {
+			        return enumerator.run(data.num_leaves, data.constraints, data.root);
+		        }
+		        return enumerator.run_subproblem(data.num_leaves, data.constraints,
+		                                         leaves.begin, leaves.end);
+	        },
+	        [&](const ranked_bitvector& leaves, multitree_node* node) {
+		        enumerator.callback().reuse(leaves, node);
+	        });
+}
+
+/** \overload Expands all unexplored nodes. */
+template <typename Callback>
+index_t expand_unexplored(tree_enumerator<Callback>& enumerator, multitree_node* root,
+                          const supertree_data& data) {
+	return expand_unexplored(enumerator, root, data,
+	                         [](const multitree_node&) { return true; });
+}
+
+} // namespace terraces
+
+#endif // TERRACES_MULTITREE_EXPANSION_HPP
@@ -1,9 +1,18 @@
 #ifndef MULTITREE_IMPL_HPP
 #define MULTITREE_IMPL_HPP
 
+#include "bits.hpp"
+#include "mapped_file.hpp"
 #include "multitree.hpp"
+#include "subproblem_cache.hpp"
 
+#include <algorithm>
+#include <array>
+#include <limits>
 #include <memory>
+#include <new>
+#include <string>
+#include <utility>
 
 namespace terraces {
 namespace multitree_impl {
@@ -22,80 +31,289 @@ std::unique_ptr<T[], array_deleter<T>> make_unique_array(std::size_t size) {
 template <typename T>
 class storage_block {
 private:
-	std::unique_ptr<T[], array_deleter<T>> begin;
+	std::unique_ptr<T[], array_deleter<T>> storage;
+	// elements of a spilled block are only constructed when they are handed out
+	std::unique_ptr<utils::scratch_mapping> mapping;
+	T* begin;
 	index_t size;
 	index_t max_size;
 
+	T* construct(index_t required) {
+		auto result = begin + size;
+		if (mapping != nullptr) {
+			for (index_t i = 0; i < required; ++i) {
+				new (result + i) T{};
+			}
+		}
+		size += required;
+		return result;
+	}
+
 public:
 	storage_block(index_t max_size)
-	        : begin{make_unique_array<T>(max_size)}, size{0}, max_size{max_size} {}
+	        : storage{make_unique_array<T>(max_size)}, begin{storage.get()}, size{0},
+	          max_size{max_size} {}
+	/** Creates a block in a scratch file in the given directory. */
+	storage_block(index_t max_size, const std::string& directory)
+	        : mapping{new utils::scratch_mapping{directory, sizeof(T) * max_size}},
+	          begin{reinterpret_cast<T*>(mapping->data())}, size{0}, max_size{max_size} {}
+	storage_block(storage_block<T>&& other) = default;
+	// swap, so the previous elements are destroyed together with other
+	storage_block<T>& operator=(storage_block<T>&& other) noexcept {
+		std::swap(storage, other.storage);
+		std::swap(mapping, other.mapping);
+		std::swap(begin, other.begin);
+		std::swap(size, other.size);
+		std::swap(max_size, other.max_size);
+		return *this;
+	}
+	~storage_block() {
+		if (mapping != nullptr) {
+			for (index_t i = 0; i < size; ++i) {
+				begin[i].~T();
+			}
+		}
+	}
 
 	bool has_space(index_t required = 1) { return size + required <= max_size; }
 
+	index_t free_size() const { return max_size - size; }
+
 	T* get() {
 		assert(has_space());
-		return begin.get() + (size++);
+		return construct(1);
 	}
 
 	T* get_range(index_t required) {
 		assert(has_space(required));
-		auto result = begin.get() + size;
-		size += required;
-		return result;
+		return construct(required);
 	}
 };
 
+/** Statistics of the blocks of \ref storage_blocks. */
+struct storage_statistics {
+	/** Number of blocks, including dedicated blocks. */
+	index_t blocks{};
+	/** Number of blocks allocated for a single large range. */
+	index_t dedicated_blocks{};
+	/** Number of ranges placed in the free space of earlier blocks. */
+	index_t reused_ranges{};
+	/** Size of all blocks in bytes. */
+	index_t allocated_bytes{};
+	/** Size of all objects handed out in bytes. */
+	index_t used_bytes{};
+	/** Size of the free space in earlier blocks in bytes, i.e. the fragmentation. */
+	index_t fragmented_bytes{};
+};
+
+/**
+ * Allocates objects in blocks, so their addresses stay stable.
+ * Ranges that do not fit into the current block are placed in the free space at the end of an
+ * earlier block if possible. These blocks are kept in lists by the size class of their free
+ * space, i.e. its binary logarithm, and the smallest fitting class is used.
+ * Ranges larger than half a block get a dedicated block of their own.
+ * If a spill directory is set, blocks exceeding the memory limit are placed in scratch files
+ * in this directory instead of failing, so the operating system can page them out.
+ * Copies keep the configuration, but start out empty.
+ */
 template <typename T>
 class storage_blocks {
 private:
+	// spilled blocks are large to keep the number of mappings low
+	static constexpr std::size_t spill_block_bytes = std::size_t{1} << 26;
+	static constexpr index_t num_size_classes = bits::word_bits;
+
 	std::vector<storage_block<T>> m_blocks;
+	index_t m_current;
+	// the earlier blocks with free space by size class and the mask of non-empty classes
+	std::array<std::vector<index_t>, num_size_classes> m_free_blocks;
+	index_t m_free_classes;
 	index_t m_block_size;
 	index_t m_total_size;
+	index_t m_used_size;
+	index_t m_spilled_size;
+	index_t m_dedicated_blocks;
+	index_t m_reused_ranges;
 	index_t m_memory_limit;
+	std::string m_spill_directory;
+
+	bool exceeds_memory_limit(index_t required) const {
+		return sizeof(T) * (m_total_size - m_spilled_size + required) > m_memory_limit;
+	}
+
+	/** Makes the free space of a block available to later ranges. */
+	void add_free_block(index_t block) {
+		auto free = m_blocks[block].free_size();
+		if (free > 0) {
+			auto size_class = bits::rbitscan(free);
+			m_free_blocks[size_class].push_back(block);
+			m_free_classes |= bits::set_mask(size_class);
+		}
+	}
+
+	/** Returns an earlier block with at least the required free space or none. */
+	index_t take_free_block(index_t required) {
+		// all blocks in this class and above have enough space
+		auto min_class = required == 1 ? 0 : bits::rbitscan(required - 1) + 1;
+		if (min_class >= num_size_classes || (m_free_classes >> min_class) == 0) {
+			return none;
+		}
+		auto size_class = bits::next_bit(m_free_classes, min_class);
+		auto& blocks = m_free_blocks[size_class];
+		auto result = blocks.back();
+		blocks.pop_back();
+		if (blocks.empty()) {
+			m_free_classes &= bits::clear_mask(size_class);
+		}
+		return result;
+	}
+
+	void add_block(index_t size, bool spill) {
+		if (spill) {
+			m_blocks.emplace_back(size, m_spill_directory);
+			m_spilled_size += size;
+		} else {
+			m_blocks.emplace_back(size);
+		}
+		m_total_size += size;
+	}
+
+	T* allocate(index_t required, bool may_fail) {
+		auto block = take_free_block(required);
+		if (block != none) {
+			++m_reused_ranges;
+			auto result = m_blocks[block].get_range(required);
+			add_free_block(block);
+			return result;
+		}
+		auto dedicated = required > m_block_size / 2;
+		auto size = dedicated ? required : m_block_size;
+		auto spill = false;
+		if (exceeds_memory_limit(size)) {
+			if (!m_spill_directory.empty()) {
+				// spilled blocks are large enough to serve further requests
+				spill = true;
+				dedicated = false;
+				size = std::max<index_t>(required, spill_block_bytes / sizeof(T));
+			} else if (may_fail) {
+				// fail allocation if we require too much memory
+				throw std::bad_alloc{};
+			}
+		}
+		add_block(size, spill);
+		if (dedicated) {
+			++m_dedicated_blocks;
+		} else {
+			add_free_block(m_current);
+			m_current = m_blocks.size() - 1;
+		}
+		return m_blocks.back().get_range(required);
+	}
 
 public:
 	storage_blocks(index_t block_size = 1024)
-	        : m_blocks{}, m_block_size{block_size}, m_total_size{block_size},
+	        : m_blocks{}, m_current{0}, m_free_classes{0}, m_block_size{block_size},
+	          m_total_size{block_size}, m_used_size{0}, m_spilled_size{0},
+	          m_dedicated_blocks{0}, m_reused_ranges{0},
 	          m_memory_limit{std::numeric_limits<index_t>::max()} {
 		m_blocks.emplace_back(m_block_size);
 	}
-	storage_blocks(const storage_blocks<T>& other) : storage_blocks{other.m_block_size} {}
+	storage_blocks(const storage_blocks<T>& other) : storage_blocks{other.m_block_size} {
+		m_memory_limit = other.m_memory_limit;
+		m_spill_directory = other.m_spill_directory;
+	}
 	storage_blocks(storage_blocks<T>&& other) = default;
 	storage_blocks<T>& operator=(const storage_blocks<T>& other) {
 		m_block_size = other.m_block_size;
+		m_memory_limit = other.m_memory_limit;
+		m_spill_directory = other.m_spill_directory;
 		return *this;
 	}
 	storage_blocks<T>& operator=(storage_blocks<T>&& other) = default;
+	/** Returns the size of all blocks in bytes. */
 	index_t total_size() const { return sizeof(T) * m_total_size; }
+	/** Returns the size of all blocks in scratch files in bytes. */
+	index_t spilled_size() const { return sizeof(T) * m_spilled_size; }
+	/** Returns the size of all blocks in memory in bytes. */
+	index_t resident_size() const { return total_size() - spilled_size(); }
 
+	storage_statistics statistics() const {
+		storage_statistics result;
+		result.blocks = m_blocks.size();
+		result.dedicated_blocks = m_dedicated_blocks;
+		result.reused_ranges = m_reused_ranges;
+		result.allocated_bytes = total_size();
+		result.used_bytes = sizeof(T) * m_used_size;
+		result.fragmented_bytes =
+		        sizeof(T) * (m_total_size - m_used_size - m_blocks[m_current].free_size());
+		return result;
+	}
+
+	/** Allocates a single object, even if this exceeds the memory limit. */
 	T* get() {
-		if (!m_blocks.back().has_space()) {
-			m_blocks.emplace_back(m_block_size);
-			m_total_size += m_block_size;
+		++m_used_size;
+		if (m_blocks[m_current].has_space()) {
+			return m_blocks[m_current].get();
 		}
-		return m_blocks.back().get();
+		return allocate(1, false);
 	}
 
+	/**
+	 * Allocates a contiguous range of objects.
+	 * \throws std::bad_alloc if this exceeds the memory limit and no spill directory is set.
+	 */
 	T* get_range(index_t required) {
-		if (!m_blocks.back().has_space(required)) {
-			if (sizeof(T) * (m_total_size + required) > m_memory_limit) {
-				// fail allocation if we require too much memory
-				throw std::bad_alloc{};
-			}
-			m_blocks.emplace_back(required);
-			m_total_size += required;
-			auto result = m_blocks.back().get_range(required);
-			auto last_it = --m_blocks.end();
-			auto prev_it = --(--m_blocks.end());
-			std::iter_swap(
-			        last_it,
-			        prev_it); // TODO this might lead to some bad worst-case behaviour
-			return result;
+		T* result;
+		if (m_blocks[m_current].has_space(required)) {
+			result = m_blocks[m_current].get_range(required);
+		} else {
+			result = allocate(required, true);
 		}
-		return m_blocks.back().get_range(required);
+		m_used_size += required;
+		return result;
 	}
 
 	void set_memory_limit(index_t memory_limit) { m_memory_limit = memory_limit; }
+
+	/** Places blocks exceeding the memory limit in scratch files in the given directory. */
+	void set_spill_directory(const std::string& directory) { m_spill_directory = directory; }
+};
+
+/**
+ * Maps leaf sets to the multitree nodes representing all trees on them,
+ * so every sub-multitree is stored only once and referenced from all of its parents.
+ * Like \ref storage_blocks, copies start out empty.
+ */
+class node_table {
+private:
+	subproblem_cache<multitree_node*> m_nodes;
+
+public:
+	node_table() : m_nodes{std::numeric_limits<index_t>::max()} {}
+	node_table(const node_table&) : node_table{} {}
+	node_table(node_table&& other) = default;
+	node_table& operator=(const node_table&) {
+		m_nodes.clear();
+		return *this;
+	}
+	node_table& operator=(node_table&& other) = default;
+
+	/** Returns the node stored for the leaf set or nullptr if there is none. */
+	template <typename Bitvector>
+	multitree_node* find(const Bitvector& leaves) {
+		auto result = m_nodes.find(leaves);
+		return result == nullptr ? nullptr : *result;
+	}
+
+	template <typename Bitvector>
+	void insert(const Bitvector& leaves, multitree_node* node) {
+		m_nodes.insert(leaves, node);
+	}
+
+	index_t total_size() const { return m_nodes.statistics().bytes; }
+
+	/** Returns the statistics, where hits count the reused sub-multitrees. */
+	const cache_statistics& statistics() const { return m_nodes.statistics(); }
 };
 
 inline multitree_node* make_single_leaf(multitree_node* n, index_t i) {
@@ -114,13 +332,23 @@ inline multitree_node* make_two_leaves(multitree_node* n, index_t i, index_t j)
 	return n;
 }
 
+/** Returns the number of trees stored in an unconstrained node with the given leaf count. */
+inline tree_count unconstrained_tree_count(index_t num_leaves) {
+#ifdef USE_GMP
+	return count_unrooted_trees<big_integer>(num_leaves);
+#else
+	// large unconstrained subtrees must not abort the construction of the multitree
+	return count_unrooted_trees<clamped_uint>(num_leaves).value();
+#endif
+}
+
 inline multitree_node* make_unconstrained(multitree_node* n, std::pair<index_t*, index_t*> range) {
 	auto begin = range.first;
 	auto end = range.second;
 	n->type = multitree_node_type::base_unconstrained;
 	n->unconstrained = {begin, end};
-	n->num_leaves = (index_t)(end - begin);
-	n->num_trees = count_unrooted_trees<index_t>(n->num_leaves);
+	n->num_leaves = std::uint32_t(end - begin);
+	n->num_trees = unconstrained_tree_count(n->num_leaves);
 	return n;
 }
 
@@ -137,7 +365,7 @@ inline multitree_node* make_alternative_array(multitree_node* n, multitree_node*
                                               index_t leaves) {
 	n->type = multitree_node_type::alternative_array;
 	n->alternative_array = {begin, begin};
-	n->num_leaves = leaves;
+	n->num_leaves = std::uint32_t(leaves);
 	n->num_trees = 0;
 	return n;
 }
@@ -147,7 +375,7 @@ inline multitree_node* make_unexplored(multitree_node* n, std::pair<index_t*, in
 	auto end = range.second;
 	n->type = multitree_node_type::unexplored;
 	n->unexplored = {begin, end};
-	n->num_leaves = (index_t)(end - begin);
+	n->num_leaves = std::uint32_t(end - begin);
 	n->num_trees = 0;
 	return n;
 }
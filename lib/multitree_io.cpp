@@ -0,0 +1,349 @@
+#include "multitree_io.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+
+#include <terraces/errors.hpp>
+
+#include "mapped_file.hpp"
+#include "utils.hpp"
+
+namespace terraces {
+
+namespace {
+
+constexpr char multitree_magic[] = "TRPHMTRE";
+constexpr std::uint32_t multitree_version = 1;
+constexpr std::size_t header_size = 40;
+constexpr std::size_t record_size = 24;
+
+void put_u32(std::string& out, std::uint32_t value) {
+	for (int i = 0; i < 4; ++i) {
+		out.push_back(char((value >> (8 * i)) & 0xff));
+	}
+}
+
+void put_u64(std::string& out, std::uint64_t value) {
+	for (int i = 0; i < 8; ++i) {
+		out.push_back(char((value >> (8 * i)) & 0xff));
+	}
+}
+
+std::uint32_t get_u32(const char* in) {
+	std::uint32_t result = 0;
+	for (int i = 0; i < 4; ++i) {
+		result |= std::uint32_t(static_cast<unsigned char>(in[i])) << (8 * i);
+	}
+	return result;
+}
+
+std::uint64_t get_u64(const char* in) {
+	std::uint64_t result = 0;
+	for (int i = 0; i < 8; ++i) {
+		result |= std::uint64_t(static_cast<unsigned char>(in[i])) << (8 * i);
+	}
+	return result;
+}
+
+std::size_t padded_leaf_bytes(std::size_t num_leaf_ids) { return (num_leaf_ids * 4 + 7) / 8 * 8; }
+
+/** Returns the number of trees of a node as determined by its type and children. */
+tree_count expected_num_trees(const multitree_node& node) {
+	switch (node.type) {
+	case multitree_node_type::base_single_leaf:
+	case multitree_node_type::base_two_leaves:
+		return 1;
+	case multitree_node_type::base_unconstrained:
+		return multitree_impl::unconstrained_tree_count(node.num_leaves);
+	case multitree_node_type::inner_node:
+		return node.inner_node.left->num_trees * node.inner_node.right->num_trees;
+	case multitree_node_type::alternative_array: {
+		auto& aa = node.alternative_array;
+		tree_count result;
+		for (auto it = aa.begin; it != aa.end; ++it) {
+			result += it->num_trees;
+		}
+		return result;
+	}
+	default:
+		// unexplored nodes are not counted yet
+		return 0;
+	}
+}
+
+void put_count(std::string& out, const big_integer& count) {
+#ifdef USE_GMP
+	auto value = count.value();
+	std::vector<std::uint64_t> limbs((mpz_sizeinbase(value.get_mpz_t(), 2) + 63) / 64);
+	std::size_t num_limbs;
+	mpz_export(limbs.data(), &num_limbs, -1, sizeof(std::uint64_t), 0, 0, value.get_mpz_t());
+	put_u64(out, num_limbs);
+	for (std::size_t i = 0; i < num_limbs; ++i) {
+		put_u64(out, limbs[i]);
+	}
+#else
+	auto value = count.value();
+	put_u64(out, value == 0 ? 0 : 1);
+	if (value != 0) {
+		put_u64(out, value);
+	}
+#endif
+}
+
+big_integer get_count(const char* limbs, std::size_t num_limbs) {
+	// without GMP, any non-zero higher limb overflows
+	const big_integer half_limb{index_t(1) << 32};
+	big_integer result = 0;
+	for (auto i = num_limbs; i > 0; --i) {
+		result *= half_limb;
+		result *= half_limb;
+		result += big_integer{index_t(get_u64(limbs + 8 * (i - 1)))};
+	}
+	return result;
+}
+
+/** Assigns record indices such that children precede their parents. */
+class record_layout {
+private:
+	std::unordered_map<const multitree_node*, index_t> m_index;
+	std::vector<const multitree_node*> m_order;
+
+	index_t push(const multitree_node* node) {
+		auto index = m_order.size();
+		m_order.push_back(node);
+		m_index.emplace(node, index);
+		return index;
+	}
+
+	void place_children(const multitree_node* node) {
+		if (node->type == multitree_node_type::inner_node) {
+			place(node->inner_node.left);
+			place(node->inner_node.right);
+		}
+	}
+
+public:
+	void place(const multitree_node* node) {
+		if (m_index.count(node) > 0) {
+			return;
+		}
+		if (node->type == multitree_node_type::alternative_array) {
+			auto& aa = node->alternative_array;
+			for (auto it = aa.begin; it != aa.end; ++it) {
+				assert(it->type != multitree_node_type::alternative_array);
+				place_children(it);
+			}
+			for (auto it = aa.begin; it != aa.end; ++it) {
+				push(it);
+			}
+		} else {
+			place_children(node);
+		}
+		push(node);
+	}
+
+	index_t index(const multitree_node* node) const { return m_index.at(node); }
+	const std::vector<const multitree_node*>& order() const { return m_order; }
+};
+
+} // anonymous namespace
+
+void write_multitree(std::ostream& stream, const multitree_node* root) {
+	record_layout layout;
+	layout.place(root);
+	const auto& order = layout.order();
+
+	std::string records;
+	std::string leaves;
+	std::string counts;
+	records.reserve(order.size() * record_size);
+	std::uint64_t num_leaf_ids = 0;
+	auto put_leaves = [&](const index_t* begin, const index_t* end) {
+		put_u64(records, num_leaf_ids);
+		put_u64(records, 0);
+		for (auto it = begin; it != end; ++it) {
+			assert(*it <= std::numeric_limits<std::uint32_t>::max());
+			put_u32(leaves, std::uint32_t(*it));
+		}
+		num_leaf_ids += std::uint64_t(end - begin);
+	};
+	auto put_offset = [&](index_t index, const multitree_node* target) {
+		put_u64(records, std::uint64_t(layout.index(target)) - std::uint64_t(index));
+	};
+	for (index_t i = 0; i < order.size(); ++i) {
+		auto node = order[i];
+		put_u32(records, std::uint32_t(node->type));
+		put_u32(records, std::uint32_t(node->num_leaves));
+		switch (node->type) {
+		case multitree_node_type::base_single_leaf:
+			put_u64(records, node->single_leaf);
+			put_u64(records, 0);
+			break;
+		case multitree_node_type::base_two_leaves:
+			put_u64(records, node->two_leaves.left_leaf);
+			put_u64(records, node->two_leaves.right_leaf);
+			break;
+		case multitree_node_type::base_unconstrained:
+			put_leaves(node->unconstrained.begin, node->unconstrained.end);
+			break;
+		case multitree_node_type::unexplored:
+			put_leaves(node->unexplored.begin, node->unexplored.end);
+			break;
+		case multitree_node_type::inner_node:
+			put_offset(i, node->inner_node.left);
+			put_offset(i, node->inner_node.right);
+			break;
+		case multitree_node_type::alternative_array: {
+			auto& aa = node->alternative_array;
+			// an empty alternative array has no first alternative
+			put_u64(records, aa.num_alternatives() == 0
+			                         ? 0
+			                         : std::uint64_t(layout.index(aa.begin)) -
+			                                   std::uint64_t(i));
+			put_u64(records, aa.num_alternatives());
+			break;
+		}
+		}
+		put_count(counts, node->num_trees.value());
+	}
+	leaves.resize(padded_leaf_bytes(num_leaf_ids), '\0');
+
+	std::string header{multitree_magic, 8};
+	put_u32(header, multitree_version);
+	put_u32(header, record_size);
+	put_u64(header, order.size());
+	put_u64(header, num_leaf_ids);
+	put_u64(header, counts.size());
+	stream.write(header.data(), std::streamsize(header.size()));
+	stream.write(records.data(), std::streamsize(records.size()));
+	stream.write(leaves.data(), std::streamsize(leaves.size()));
+	stream.write(counts.data(), std::streamsize(counts.size()));
+}
+
+void write_multitree(const std::string& filename, const multitree_node* root) {
+	std::ofstream stream{filename, std::ios::binary};
+	utils::ensure<file_open_error>(stream.is_open(), "failed to open " + filename);
+	write_multitree(stream, root);
+	utils::ensure<file_open_error>(bool(stream), "failed to write " + filename);
+}
+
+stored_multitree::stored_multitree(const std::string& filename) : m_num_nodes{0} {
+	utils::mapped_file file{filename};
+	auto data = file.data();
+	auto size = file.size();
+	auto check = [](bool condition, const char* message) {
+		utils::ensure<bad_input_error>(condition, bad_input_error_type::multitree_malformed,
+		                               message);
+	};
+	check(size >= header_size && std::memcmp(data, multitree_magic, 8) == 0,
+	      "missing header");
+	check(get_u32(data + 8) == multitree_version, "unsupported version");
+	check(get_u32(data + 12) == record_size, "unsupported record size");
+	auto num_records = get_u64(data + 16);
+	auto num_leaf_ids = get_u64(data + 24);
+	auto counts_size = get_u64(data + 32);
+	// check the section sizes individually to avoid overflows
+	auto remaining = size - header_size;
+	check(num_records > 0 && num_records <= remaining / record_size, "truncated records");
+	remaining -= num_records * record_size;
+	check(num_leaf_ids <= remaining / 4 && padded_leaf_bytes(num_leaf_ids) <= remaining,
+	      "truncated leaf ids");
+	remaining -= padded_leaf_bytes(num_leaf_ids);
+	check(counts_size == remaining, "mismatching counts size");
+	auto records = data + header_size;
+	auto leaf_ids = records + num_records * record_size;
+	auto counts = leaf_ids + padded_leaf_bytes(num_leaf_ids);
+	auto counts_end = counts + counts_size;
+	// the root is the last record and contains all leaves
+	auto num_leaves_total = get_u32(records + (num_records - 1) * record_size + 4);
+
+	m_num_nodes = num_records;
+	m_nodes = multitree_impl::make_unique_array<multitree_node>(m_num_nodes);
+	m_leaves.resize(num_leaf_ids);
+	for (index_t i = 0; i < num_leaf_ids; ++i) {
+		m_leaves[i] = get_u32(leaf_ids + 4 * i);
+		check(m_leaves[i] < num_leaves_total, "invalid leaf id");
+	}
+	for (index_t i = 0; i < m_num_nodes; ++i) {
+		auto record = records + i * record_size;
+		auto type = get_u32(record);
+		auto num_leaves = get_u32(record + 4);
+		auto a = get_u64(record + 8);
+		auto b = get_u64(record + 16);
+		auto& node = m_nodes[i];
+		node.num_leaves = num_leaves;
+		// references must point to preceding records, which makes the multitree acyclic
+		auto target = [&](std::uint64_t offset) {
+			auto index = std::uint64_t(i) + offset;
+			check(index < i, "invalid node reference");
+			return m_nodes.get() + index;
+		};
+		auto leaf_range = [&]() {
+			check(a <= num_leaf_ids && num_leaves <= num_leaf_ids - a,
+			      "invalid leaf range");
+			auto begin = m_leaves.data() + a;
+			return std::make_pair(begin, begin + num_leaves);
+		};
+		switch (multitree_node_type(type)) {
+		case multitree_node_type::base_single_leaf:
+			check(num_leaves == 1 && a < num_leaves_total, "invalid single leaf");
+			node.type = multitree_node_type::base_single_leaf;
+			node.single_leaf = a;
+			break;
+		case multitree_node_type::base_two_leaves:
+			check(num_leaves == 2 && a < num_leaves_total && b < num_leaves_total,
+			      "invalid two leaves");
+			node.type = multitree_node_type::base_two_leaves;
+			node.two_leaves = {a, b};
+			break;
+		case multitree_node_type::base_unconstrained: {
+			auto range = leaf_range();
+			node.type = multitree_node_type::base_unconstrained;
+			node.unconstrained = {range.first, range.second};
+			break;
+		}
+		case multitree_node_type::unexplored: {
+			auto range = leaf_range();
+			node.type = multitree_node_type::unexplored;
+			node.unexplored = {range.first, range.second};
+			break;
+		}
+		case multitree_node_type::inner_node: {
+			auto left = target(a);
+			auto right = target(b);
+			check(left->num_leaves + right->num_leaves == num_leaves,
+			      "invalid inner node");
+			node.type = multitree_node_type::inner_node;
+			node.inner_node = {left, right};
+			break;
+		}
+		case multitree_node_type::alternative_array: {
+			auto begin = b == 0 ? &node : target(a);
+			check(b <= std::uint64_t(&node - begin), "invalid alternatives");
+			for (auto it = begin; it != begin + b; ++it) {
+				check(it->type != multitree_node_type::alternative_array &&
+				              it->num_leaves == num_leaves,
+				      "invalid alternative");
+			}
+			node.type = multitree_node_type::alternative_array;
+			node.alternative_array = {begin, begin + b};
+			break;
+		}
+		default:
+			check(false, "invalid node type");
+		}
+		check(counts_end - counts >= 8, "truncated counts");
+		auto num_limbs = get_u64(counts);
+		counts += 8;
+		check(num_limbs <= std::uint64_t(counts_end - counts) / 8, "truncated counts");
+		node.num_trees = get_count(counts, num_limbs);
+		counts += 8 * num_limbs;
+		check(node.num_trees == expected_num_trees(node), "invalid tree count");
+	}
+	check(counts == counts_end, "trailing data");
+}
+
+} // namespace terraces
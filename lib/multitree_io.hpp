@@ -0,0 +1,62 @@
+#ifndef TERRACES_MULTITREE_IO_HPP
+#define TERRACES_MULTITREE_IO_HPP
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "multitree_impl.hpp"
+
+namespace terraces {
+
+/**
+ * Writes a multitree in the binary multitree format. All integers are little-endian.
+ * <ul>
+ * <li>A 40 byte header: the magic string "TRPHMTRE", the format version and the record
+ *     size (32 bit each), the number of node records, the number of leaf ids and the size of
+ *     the counts section in bytes (64 bit each).</li>
+ * <li>One 24 byte record per node: its type and number of leaves (32 bit each) followed by
+ *     two 64 bit fields. They contain the leaves of base cases, the index of the first leaf id
+ *     of unconstrained and unexplored nodes, or the signed offsets of the children of inner
+ *     nodes and the first alternative of alternative arrays relative to the record.
+ *     Children always precede their parents and the root is the last record.
+ *     The alternatives of an alternative array are stored in consecutive records.</li>
+ * <li>The 32 bit leaf ids of unconstrained and unexplored nodes, padded to 8 bytes.</li>
+ * <li>The counts section containing the number of trees of every node in record order,
+ *     each stored as a 64 bit number of limbs followed by the 64 bit limbs,
+ *     least significant first.</li>
+ * </ul>
+ * Shared sub-multitrees are only stored once.
+ */
+void write_multitree(std::ostream& stream, const multitree_node* root);
+
+/** Writes a multitree in the binary multitree format to the given file. */
+void write_multitree(const std::string& filename, const multitree_node* root);
+
+/**
+ * A multitree read from a file in the binary multitree format.
+ * The file is memory-mapped, validated and decoded in a single pass into one node array,
+ * so the multitree can be used by \ref multitree_iterator without recomputing any counts.
+ * Leaf ids and tree counts are checked against the root and the child nodes.
+ */
+class stored_multitree {
+private:
+	std::unique_ptr<multitree_node[], multitree_impl::array_deleter<multitree_node>> m_nodes;
+	std::vector<index_t> m_leaves;
+	index_t m_num_nodes;
+
+public:
+	/**
+	 * \throws file_open_error if the file cannot be opened.
+	 * \throws bad_input_error if the file is not a valid binary multitree.
+	 * \throws tree_count_overflow_error if the tree counts do not fit into a big_integer.
+	 */
+	explicit stored_multitree(const std::string& filename);
+
+	const multitree_node* root() const { return m_nodes.get() + (m_num_nodes - 1); }
+	index_t num_nodes() const { return m_num_nodes; }
+};
+
+} // namespace terraces
+
+#endif // TERRACES_MULTITREE_IO_HPP
@@ -1,14 +1,36 @@
 #include "multitree_iterator.hpp"
 
+#include <algorithm>
+#include <stdexcept>
+
+#include "utils.hpp"
+
 namespace terraces {
 
 multitree_iterator::multitree_iterator(const multitree_node* root)
         : m_tree(2 * root->num_leaves - 1), m_choices(m_tree.size()),
-          m_unconstrained_choices(m_tree.size()) {
+          m_unconstrained_choices(m_tree.size()), m_rank{0}, m_end{0}, m_bounded{false},
+          m_changes{{0, m_tree.size()}} {
 	m_choices[0] = {root};
 	init_subtree(0);
 }
 
+multitree_iterator::multitree_iterator(const multitree_node* root, const big_integer& first,
+                                       const big_integer& last)
+        : m_tree(2 * root->num_leaves - 1), m_choices(m_tree.size()),
+          m_unconstrained_choices(m_tree.size()), m_unrooted(2, big_integer{1}), m_rank{first},
+          m_end{last}, m_bounded{true}, m_changes{{0, m_tree.size()}} {
+	utils::ensure<std::out_of_range>(first < last && !(root->num_trees.value() < last),
+	                                 "invalid multitree rank range");
+	m_choices[0] = {root};
+	init_subtree_at(0, first);
+}
+
+bool multitree_iterator::changed(index_t root, index_t num_leaves) {
+	m_changes.push_back({root, root + 2 * num_leaves - 1});
+	return true;
+}
+
 void multitree_iterator::init_subtree(index_t i, index_t single_leaf) {
 	m_tree[i].lchild() = none;
 	m_tree[i].rchild() = none;
@@ -37,36 +59,41 @@ bool multitree_iterator::init_subtree_unconstrained(index_t root,
 	while (m_init_stack.size() > init_size) {
 		auto i = m_init_stack.top();
 		m_init_stack.pop();
-		const auto& bip = m_unconstrained_choices[i];
-		auto& node = m_tree[i];
-		if (bip.num_leaves() <= 2) {
-			if (bip.num_leaves() == 1) {
-				node.lchild() = none;
-				node.rchild() = none;
-				node.taxon() = data.begin[bip.leftmost_leaf()];
-			} else {
-				node.lchild() = i + 1;
-				node.rchild() = i + 2;
-				node.taxon() = none;
-				m_tree[i + 1] = {i, none, none, data.begin[bip.leftmost_leaf()]};
-				m_tree[i + 2] = {i, none, none, data.begin[bip.rightmost_leaf()]};
-			}
+		init_unconstrained_node(i, data);
+	}
+	return true;
+}
+
+bool multitree_iterator::init_unconstrained_node(index_t i, multitree_nodes::unconstrained data) {
+	const auto& bip = m_unconstrained_choices[i];
+	auto& node = m_tree[i];
+	if (bip.num_leaves() <= 2) {
+		if (bip.num_leaves() == 1) {
+			node.lchild() = none;
+			node.rchild() = none;
+			node.taxon() = data.begin[bip.leftmost_leaf()];
 		} else {
-			const auto lbip = small_bipartition{bip.left_mask()};
-			const auto rbip = small_bipartition{bip.right_mask()};
-			const auto left = i + 1;
-			const auto right = i + 1 + 2 * lbip.num_leaves() - 1;
-			node.lchild() = left;
-			node.rchild() = right;
+			node.lchild() = i + 1;
+			node.rchild() = i + 2;
 			node.taxon() = none;
-			m_unconstrained_choices[left] = lbip;
-			m_unconstrained_choices[right] = rbip;
-			m_tree[node.lchild()].parent() = i;
-			m_tree[node.rchild()].parent() = i;
-			m_init_stack.push(left);
-			m_init_stack.push(right);
+			m_tree[i + 1] = {i, none, none, data.begin[bip.leftmost_leaf()]};
+			m_tree[i + 2] = {i, none, none, data.begin[bip.rightmost_leaf()]};
 		}
+		return false;
 	}
+	const auto lbip = small_bipartition{bip.left_mask()};
+	const auto rbip = small_bipartition{bip.right_mask()};
+	const auto left = i + 1;
+	const auto right = i + 1 + 2 * lbip.num_leaves() - 1;
+	node.lchild() = left;
+	node.rchild() = right;
+	node.taxon() = none;
+	m_unconstrained_choices[left] = lbip;
+	m_unconstrained_choices[right] = rbip;
+	m_tree[node.lchild()].parent() = i;
+	m_tree[node.rchild()].parent() = i;
+	m_init_stack.push(left);
+	m_init_stack.push(right);
 	return true;
 }
 
@@ -115,6 +142,119 @@ bool multitree_iterator::init_subtree(index_t root) {
 	return true;
 }
 
+const big_integer& multitree_iterator::unrooted_trees(index_t num_leaves) {
+	while (m_unrooted.size() <= num_leaves) {
+		auto n = index_t(m_unrooted.size());
+		m_unrooted.push_back(m_unrooted.back() * big_integer{2 * n - 3});
+	}
+	return m_unrooted[num_leaves];
+}
+
+big_integer multitree_iterator::unrank_bipartition(small_bipartition& bip, big_integer rank) {
+	// bipartitions are enumerated by their left subset, which is a non-empty subset of all but
+	// the rightmost leaf, in increasing numerical order. Every left subset with c leaves
+	// is followed by weight[c] = unrooted(c) * unrooted(n - c) tree combinations.
+	const auto n = bip.num_leaves();
+	std::vector<big_integer> weight(n);
+	for (index_t c = 1; c < n; ++c) {
+		weight[c] = unrooted_trees(c) * unrooted_trees(n - c);
+	}
+	auto candidates = bip.mask() ^ (index_t(1) << bip.rightmost_leaf());
+	index_t left = 0;
+	index_t num_left = 0;
+	// decide the membership of the leaves from the most significant one downwards
+	for (index_t remaining = n - 1; remaining > 0; --remaining) {
+		const auto leaf = rbitscan(candidates);
+		candidates ^= index_t(1) << leaf;
+		// count the trees whose left subset excludes this leaf,
+		// i.e. contains t of the remaining - 1 lower leaves
+		big_integer skipped = 0;
+		index_t binomial = 1;
+		for (index_t t = 0; t < remaining; ++t) {
+			skipped += weight[num_left + t] * big_integer{binomial};
+			binomial = binomial * (remaining - 1 - t) / (t + 1);
+		}
+		if (rank < skipped) {
+			continue;
+		}
+		rank -= skipped;
+		left |= index_t(1) << leaf;
+		++num_left;
+	}
+	bip.m_cur_bip = left;
+	return rank;
+}
+
+void multitree_iterator::init_subtree_unconstrained_at(index_t root,
+                                                       multitree_nodes::unconstrained data,
+                                                       big_integer rank) {
+	auto init_size = m_init_stack.size();
+	m_init_stack.emplace(root);
+	m_rank_stack.push(std::move(rank));
+	while (m_init_stack.size() > init_size) {
+		auto i = m_init_stack.top();
+		m_init_stack.pop();
+		auto subtree_rank = std::move(m_rank_stack.top());
+		m_rank_stack.pop();
+		auto& bip = m_unconstrained_choices[i];
+		if (bip.has_choices()) {
+			subtree_rank = unrank_bipartition(bip, subtree_rank);
+		}
+		if (init_unconstrained_node(i, data)) {
+			// the left subtree is the least significant digit of the rank
+			const auto& num_left = unrooted_trees(popcount(bip.left_mask()));
+			m_rank_stack.push(subtree_rank % num_left);
+			m_rank_stack.push(subtree_rank / num_left);
+		}
+	}
+}
+
+void multitree_iterator::init_subtree_at(index_t root, big_integer rank) {
+	m_init_stack.push(root);
+	m_rank_stack.push(std::move(rank));
+	while (!m_init_stack.empty()) {
+		auto i = m_init_stack.top();
+		m_init_stack.pop();
+		auto subtree_rank = std::move(m_rank_stack.top());
+		m_rank_stack.pop();
+		auto& choice = m_choices[i];
+		if (choice.has_choices()) {
+			// the alternative is the most significant digit of the rank
+			while (!(subtree_rank < choice.current->num_trees.value())) {
+				subtree_rank -= choice.current->num_trees.value();
+				choice.next();
+			}
+		}
+		const auto mt_node = choice.current;
+		switch (mt_node->type) {
+		case multitree_node_type::base_single_leaf:
+			init_subtree(i, mt_node->single_leaf);
+			break;
+		case multitree_node_type::base_two_leaves:
+			init_subtree(i, mt_node->two_leaves);
+			break;
+		case multitree_node_type::base_unconstrained:
+			m_unconstrained_choices[i] =
+			        small_bipartition::full_set(mt_node->unconstrained.num_leaves());
+			init_subtree_unconstrained_at(i, mt_node->unconstrained, subtree_rank);
+			break;
+		case multitree_node_type::inner_node: {
+			init_subtree(i, mt_node->inner_node);
+			// the left subtree is the least significant digit of the rank
+			const auto num_left = mt_node->inner_node.left->num_trees.value();
+			m_rank_stack.push(subtree_rank % num_left);
+			m_rank_stack.push(subtree_rank / num_left);
+			break;
+		}
+		case multitree_node_type::alternative_array:
+			assert(false && "Malformed multitree: Nested alternative_arrays");
+			break;
+		case multitree_node_type::unexplored:
+			throw multitree_unexplored_error{};
+		}
+	}
+}
+
 bool multitree_iterator::next(index_t root) {
 	auto node = m_tree[root];
 	auto left = node.lchild();
@@ -129,7 +269,8 @@ bool multitree_iterator::next(index_t root) {
 	case multitree_node_type::inner_node:
 	case multitree_node_type::alternative_array:
 		return next(left) || (next(right) && reset(left)) ||
-		       (choice.has_choices() && choice.next() && init_subtree(root));
+		       (choice.has_choices() && choice.next() && init_subtree(root) &&
+		        changed(root, choice.current->num_leaves));
 	case multitree_node_type::unexplored:
 		throw multitree_unexplored_error{};
 	default:
@@ -148,13 +289,15 @@ bool multitree_iterator::next_unconstrained(index_t root, multitree_nodes::uncon
 	}
 	return next_unconstrained(left, data) ||
 	       (next_unconstrained(right, data) && reset_unconstrained(left, data)) ||
-	       (choice.next() && init_subtree_unconstrained(root, data));
+	       (choice.next() && init_subtree_unconstrained(root, data) &&
+	        changed(root, choice.num_leaves()));
 }
 
 bool multitree_iterator::reset(index_t root) {
 	auto& choice = m_choices[root];
 	if (choice.has_choices()) {
 		choice.reset();
+		changed(root, choice.current->num_leaves);
 	}
 	switch (choice.current->type) {
 	case multitree_node_type::base_single_leaf:
@@ -166,6 +309,10 @@ bool multitree_iterator::reset(index_t root) {
 	case multitree_node_type::inner_node:
 	case multitree_node_type::alternative_array:
 		init_subtree(root);
+		// subtrees with a single tree stay the same
+		if (choice.current->num_trees != 1) {
+			changed(root, choice.current->num_leaves);
+		}
 		break;
 	case multitree_node_type::unexplored:
 		throw multitree_unexplored_error{};
@@ -180,11 +327,36 @@ bool multitree_iterator::reset_unconstrained(index_t root, multitree_nodes::unco
 	auto& choice = m_unconstrained_choices[root];
 	if (choice.has_choices()) {
 		choice.reset();
+		changed(root, choice.num_leaves());
 	}
 	init_subtree_unconstrained(root, data);
 	return true;
 }
 
-bool multitree_iterator::next() { return next(0); }
+bool multitree_iterator::next() {
+	m_changes.clear();
+	if ((m_bounded && !(m_rank + big_integer{1} < m_end)) || !next(0)) {
+		return false;
+	}
+	m_rank += big_integer{1};
+	// the changed ranges are subtrees, so they are either nested or disjoint
+	std::sort(m_changes.begin(), m_changes.end(),
+	          [](node_range a, node_range b) { return a.begin < b.begin; });
+	index_t size = 0;
+	for (auto range : m_changes) {
+		if (size > 0 && range.begin <= m_changes[size - 1].end) {
+			auto& last = m_changes[size - 1];
+			last.end = std::max(last.end, range.end);
+		} else {
+			m_changes[size++] = range;
+		}
+	}
+	m_changes.resize(size);
+	return true;
+}
+
+terraces::tree unrank(const multitree_node* root, const big_integer& rank) {
+	return multitree_iterator{root, rank, rank + big_integer{1}}.tree();
+}
 
 } // namespace terraces
@@ -44,12 +44,30 @@ struct multitree_iterator_choicepoint {
 	void reset() { current = alternatives->alternative_array.begin; }
 };
 
+/**
+ * Iterates over all trees represented by a multitree.
+ * Every tree has a rank between 0 and root->num_trees - 1 given by its position in the
+ * iteration order, which allows starting the iteration at an arbitrary tree.
+ * Every subtree occupies a contiguous range of node indices and consecutive trees usually
+ * only differ in a few small subtrees, which are reported by \ref changed_ranges.
+ */
 class multitree_iterator {
 private:
 	terraces::tree m_tree;
 	std::vector<multitree_iterator_choicepoint> m_choices;
 	std::vector<small_bipartition> m_unconstrained_choices;
 	std::stack<index_t> m_init_stack;
+	// the ranks of the subtrees on m_init_stack while unranking
+	std::stack<big_integer> m_rank_stack;
+	// m_unrooted[n] contains the number of unrooted trees with n leaves
+	std::vector<big_integer> m_unrooted;
+	big_integer m_rank;
+	big_integer m_end;
+	bool m_bounded;
+	// the subtrees that were reinitialized by the last call to next()
+	std::vector<node_range> m_changes;
+
+	bool changed(index_t subtree_root, index_t num_leaves);
 
 	bool init_subtree(index_t subtree_root);
 	void init_subtree(index_t subtree_root, index_t single_leaf);
@@ -57,6 +75,13 @@ private:
 	void init_subtree(index_t subtree_root, multitree_nodes::inner_node inner);
 	void init_subtree(index_t subtree_root, multitree_nodes::unconstrained unconstrained);
 	bool init_subtree_unconstrained(index_t subtree_root, multitree_nodes::unconstrained data);
+	bool init_unconstrained_node(index_t node, multitree_nodes::unconstrained data);
+
+	void init_subtree_at(index_t subtree_root, big_integer rank);
+	void init_subtree_unconstrained_at(index_t subtree_root,
+	                                   multitree_nodes::unconstrained data, big_integer rank);
+	big_integer unrank_bipartition(small_bipartition& bip, big_integer rank);
+	const big_integer& unrooted_trees(index_t num_leaves);
 
 	bool next(index_t root);
 	bool next_unconstrained(index_t root, multitree_nodes::unconstrained unconstrained);
@@ -65,10 +90,33 @@ private:
 
 public:
 	multitree_iterator(const multitree_node* root);
+	/**
+	 * Iterates only over the trees with ranks \p first <= rank < \p last.
+	 * Disjoint rank ranges can thus be enumerated independently, e.g. in parallel.
+	 * \throws std::out_of_range if the range is empty or exceeds root->num_trees.
+	 */
+	multitree_iterator(const multitree_node* root, const big_integer& first,
+	                   const big_integer& last);
 	bool next();
 	const terraces::tree& tree() const { return m_tree; }
+	/**
+	 * Returns the sorted and disjoint ranges of node indices that changed between the
+	 * previous and the current tree, i.e. all other nodes are the same in both trees.
+	 * Initially, this is the whole tree, after the last tree it is empty.
+	 */
+	const std::vector<node_range>& changed_ranges() const { return m_changes; }
+	/** Returns the rank of the current tree. */
+	const big_integer& rank() const { return m_rank; }
 };
 
+/**
+ * Returns the tree with the given \p rank in the iteration order of \ref multitree_iterator
+ * without enumerating the preceding trees.
+ * Choosing the rank uniformly at random thus samples the trees uniformly.
+ * \throws std::out_of_range if rank >= root->num_trees.
+ */
+terraces::tree unrank(const multitree_node* root, const big_integer& rank);
+
 } // namespace terraces
 
 #endif // MULTITREE_ITERATOR_H
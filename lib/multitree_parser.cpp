@@ -0,0 +1,241 @@
+#include "multitree_parser.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <terraces/errors.hpp>
+
+#include "utils.hpp"
+
+namespace terraces {
+
+namespace {
+
+class multitree_parser {
+private:
+	using iterator = std::istreambuf_iterator<char>;
+
+	// a subtree, i.e. a list of alternatives or a reference to a labelled subtree
+	struct frame {
+		index_t label;
+		multitree_node* reference;
+		std::vector<multitree_node> alternatives;
+		// the left subtree of the inner node that is currently being parsed
+		multitree_node* left;
+		bool open_inner;
+
+		frame() : label{none}, reference{nullptr}, left{nullptr}, open_inner{false} {}
+	};
+
+	iterator m_it;
+	iterator m_end;
+	const index_map& m_taxa;
+	parsed_multitree m_result;
+	std::unordered_map<index_t, multitree_node*> m_labels;
+	std::vector<frame> m_stack;
+	std::vector<index_t> m_leaf_buffer;
+
+	static void ensure(bool condition,
+	                   bad_input_error_type type = bad_input_error_type::nwk_malformed) {
+		utils::ensure<bad_input_error>(condition, type);
+	}
+
+	char peek() {
+		while (m_it != m_end && std::isspace(static_cast<unsigned char>(*m_it))) {
+			++m_it;
+		}
+		return m_it == m_end ? '\0' : *m_it;
+	}
+
+	void expect(char c) {
+		ensure(peek() == c);
+		++m_it;
+	}
+
+	index_t read_number() {
+		ensure(std::isdigit(static_cast<unsigned char>(peek())) != 0);
+		index_t result = 0;
+		for (; m_it != m_end && std::isdigit(static_cast<unsigned char>(*m_it)); ++m_it) {
+			result = result * 10 + index_t(*m_it - '0');
+		}
+		return result;
+	}
+
+	index_t read_leaf() {
+		peek();
+		std::string name;
+		for (; m_it != m_end && std::strchr("(),|{}[];", *m_it) == nullptr; ++m_it) {
+			name.push_back(*m_it);
+		}
+		name.erase(utils::reverse_skip_ws(name.begin(), name.end()), name.end());
+		auto it = m_taxa.find(name);
+		utils::ensure<bad_input_error>(it != m_taxa.end(),
+		                               bad_input_error_type::nwk_taxon_unknown, name);
+		return it->second;
+	}
+
+	std::pair<index_t*, index_t*> read_leaf_list(char close) {
+		m_leaf_buffer.assign(1, read_leaf());
+		while (peek() == ',') {
+			++m_it;
+			m_leaf_buffer.push_back(read_leaf());
+		}
+		expect(close);
+		auto leaves = m_result.leaves.get_range(m_leaf_buffer.size());
+		std::copy(m_leaf_buffer.begin(), m_leaf_buffer.end(), leaves);
+		return {leaves, leaves + m_leaf_buffer.size()};
+	}
+
+	multitree_node& new_alternative() {
+		m_stack.back().alternatives.emplace_back();
+		return m_stack.back().alternatives.back();
+	}
+
+	/** Returns true if and only if the alternative is an inner node. */
+	bool begin_alternative() {
+		switch (peek()) {
+		case '(':
+			++m_it;
+			m_stack.back().open_inner = true;
+			return true;
+		case '{':
+			++m_it;
+			multitree_impl::make_unconstrained(&new_alternative(), read_leaf_list('}'));
+			return false;
+		case '[':
+			++m_it;
+			multitree_impl::make_unexplored(&new_alternative(), read_leaf_list(']'));
+			return false;
+		default:
+			multitree_impl::make_single_leaf(&new_alternative(), read_leaf());
+			return false;
+		}
+	}
+
+	/** Begins a subtree and all subtrees that are the left child of an inner node on it. */
+	void begin_subtree() {
+		bool open_inner;
+		do {
+			m_stack.emplace_back();
+			if (peek() == '#') {
+				++m_it;
+				auto label = read_number();
+				if (peek() == '#') {
+					++m_it;
+					auto it = m_labels.find(label);
+					ensure(it != m_labels.end());
+					m_stack.back().reference = it->second;
+					return;
+				}
+				expect('=');
+				m_stack.back().label = label;
+			}
+			open_inner = begin_alternative();
+		} while (open_inner);
+	}
+
+	multitree_node* finish_subtree() {
+		ensure(!m_stack.empty(), bad_input_error_type::nwk_mismatched_parentheses);
+		auto f = std::move(m_stack.back());
+		m_stack.pop_back();
+		ensure(!f.open_inner, bad_input_error_type::nwk_mismatched_parentheses);
+		if (f.reference != nullptr) {
+			return f.reference;
+		}
+		auto& alternatives = f.alternatives;
+		multitree_node* result = m_result.nodes.get();
+		if (alternatives.size() == 1) {
+			*result = alternatives.front();
+		} else {
+			auto num_leaves = alternatives.front().num_leaves;
+			auto begin = m_result.nodes.get_range(alternatives.size());
+			multitree_impl::make_alternative_array(result, begin, num_leaves);
+			for (const auto& alternative : alternatives) {
+				ensure(alternative.num_leaves == num_leaves);
+				result->num_trees += alternative.num_trees;
+				*(result->alternative_array.end) = alternative;
+				++(result->alternative_array.end);
+			}
+		}
+		if (f.label != none) {
+			ensure(m_labels.emplace(f.label, result).second);
+		}
+		return result;
+	}
+
+	void finish_inner(multitree_node* right) {
+		ensure(!m_stack.empty(), bad_input_error_type::nwk_mismatched_parentheses);
+		auto& parent = m_stack.back();
+		ensure(parent.open_inner && parent.left != nullptr);
+		auto left = parent.left;
+		parent.open_inner = false;
+		parent.left = nullptr;
+		auto& node = new_alternative();
+		if (left->type == multitree_node_type::base_single_leaf &&
+		    right->type == multitree_node_type::base_single_leaf) {
+			multitree_impl::make_two_leaves(&node, left->single_leaf,
+			                                right->single_leaf);
+		} else {
+			multitree_impl::make_inner_node(&node, left, right);
+		}
+	}
+
+public:
+	multitree_parser(std::istream& input, const index_map& taxa)
+	        : m_it{input}, m_end{}, m_taxa{taxa}, m_result{{}, {}, nullptr} {}
+
+	parsed_multitree parse() {
+		begin_subtree();
+		bool finished = false;
+		while (!finished) {
+			switch (peek()) {
+			case '|':
+				++m_it;
+				ensure(m_stack.back().reference == nullptr);
+				if (begin_alternative()) {
+					begin_subtree();
+				}
+				break;
+			case ',': {
+				++m_it;
+				auto left = finish_subtree();
+				ensure(!m_stack.empty() && m_stack.back().open_inner &&
+				               m_stack.back().left == nullptr,
+				       bad_input_error_type::nwk_multifurcating);
+				m_stack.back().left = left;
+				begin_subtree();
+				break;
+			}
+			case ')':
+				++m_it;
+				finish_inner(finish_subtree());
+				break;
+			case ';':
+				++m_it;
+				finished = true;
+				break;
+			case '\0':
+				finished = true;
+				break;
+			default:
+				ensure(false);
+			}
+		}
+		m_result.root = finish_subtree();
+		ensure(m_stack.empty(), bad_input_error_type::nwk_mismatched_parentheses);
+		return std::move(m_result);
+	}
+};
+
+} // anonymous namespace
+
+parsed_multitree parse_multitree(std::istream& input, const index_map& taxa) {
+	return multitree_parser{input, taxa}.parse();
+}
+
+} // namespace terraces
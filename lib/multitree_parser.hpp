@@ -0,0 +1,30 @@
+#ifndef TERRACES_MULTITREE_PARSER_HPP
+#define TERRACES_MULTITREE_PARSER_HPP
+
+#include <istream>
+
+#include <terraces/trees.hpp>
+
+#include "multitree_impl.hpp"
+
+namespace terraces {
+
+/** A multitree together with the storage of its nodes and leaves. */
+struct parsed_multitree {
+	multitree_impl::storage_blocks<multitree_node> nodes;
+	multitree_impl::storage_blocks<index_t> leaves;
+	multitree_node* root;
+};
+
+/**
+ * Parses a multitree in the compressed Newick format written by \ref as_newick
+ * in a single pass over the input and recomputes the number of trees of every node.
+ * Labelled subtrees (#k=) are shared by all of their references (#k#),
+ * alternatives with only two leaves are stored as base cases.
+ * \throws bad_input_error if the input is malformed or an unknown taxon is encountered.
+ */
+parsed_multitree parse_multitree(std::istream& input, const index_map& taxa);
+
+} // namespace terraces
+
+#endif // TERRACES_MULTITREE_PARSER_HPP
@@ -13,7 +13,7 @@ public:
 private:
 	using base = basic_bitvector<Alloc>;
 
-	std::vector<value_type, Alloc> m_ranks;
+	typename base::block_storage m_ranks;
 	index_t m_count;
 #ifndef NDEBUG
 	bool m_ranks_dirty;
@@ -27,6 +27,14 @@ public:
 		m_ranks_dirty = true;
 #endif // NDEBUG
 	}
+	/** Copies a bitvector into storage obtained from the given allocator. */
+	basic_ranked_bitvector(const basic_ranked_bitvector& other, Alloc alloc)
+	        : basic_bitvector<Alloc>{other, alloc}, m_ranks(other.m_ranks, alloc),
+	          m_count{other.m_count} {
+#ifndef NDEBUG
+		m_ranks_dirty = other.m_ranks_dirty;
+#endif // NDEBUG
+	}
 
 	/** Sets a bit in the bitvector. */
 	void set(index_t i) {
@@ -56,6 +64,9 @@ public:
 	void invert();
 	/** Applies element-wise xor from another bitvector. */
 	void bitwise_xor(const basic_bitvector<Alloc>& other);
+	/** Applies element-wise xor from the blocks [first_block, end_block) of another vector. */
+	void bitwise_xor(const basic_bitvector<Alloc>& other, index_t first_block,
+	                 index_t end_block);
 	/** Sets the values of this bitvector to the bitwise or of two bitvectors. */
 	void set_bitwise_or(const basic_bitvector<Alloc>& fst, const basic_bitvector<Alloc>& snd);
 
@@ -67,6 +78,12 @@ public:
 
 	/** Updates the internal data structures after editing the vector. */
 	void update_ranks();
+	/**
+	 * Updates the internal data structures after editing the vector,
+	 * assuming that the ranks were up-to-date before
+	 * and only the blocks starting at first_block changed.
+	 */
+	void update_ranks(index_t first_block);
 	/** Returns the rank of an index, i.e. the number of set bits in the range [0..i) */
 	index_t rank(index_t i) const;
 	index_t select(index_t i) const;
@@ -108,6 +125,15 @@ void basic_ranked_bitvector<Alloc>::bitwise_xor(const basic_bitvector<Alloc>& ot
 #endif // NDEBUG
 }
 
+template <typename Alloc>
+void basic_ranked_bitvector<Alloc>::bitwise_xor(const basic_bitvector<Alloc>& other,
+                                                index_t first_block, index_t end_block) {
+	base::bitwise_xor(other, first_block, end_block);
+#ifndef NDEBUG
+	m_ranks_dirty = true;
+#endif // NDEBUG
+}
+
 template <typename Alloc>
 void basic_ranked_bitvector<Alloc>::invert() {
 	base::invert();
@@ -138,6 +164,20 @@ void basic_ranked_bitvector<Alloc>::update_ranks() {
 #endif // NDEBUG
 }
 
+template <typename Alloc>
+void basic_ranked_bitvector<Alloc>::update_ranks(index_t first_block) {
+	assert(first_block < base::m_blocks.size());
+	m_count = m_ranks[first_block];
+	for (index_t b = first_block; b < base::m_blocks.size(); ++b) {
+		m_ranks[b] = m_count;
+		m_count += bits::popcount(base::m_blocks[b]);
+	}
+	assert(m_count > 0);
+#ifndef NDEBUG
+	m_ranks_dirty = false;
+#endif // NDEBUG
+}
+
 /** Returns a basic_ranked_bitvector<Alloc> containing size elements. */
 template <typename Alloc>
 basic_ranked_bitvector<Alloc> full_ranked_set(index_t size, Alloc a) {
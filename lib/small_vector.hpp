@@ -0,0 +1,131 @@
+#ifndef TERRACES_SMALL_VECTOR_HPP
+#define TERRACES_SMALL_VECTOR_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+namespace terraces {
+namespace utils {
+
+/**
+ * A fixed-size array of trivially copyable elements that is stored inline
+ * if it has at most N elements and uses the allocator otherwise.
+ * Only the operations needed by the bitvectors are provided.
+ */
+template <typename T, typename Alloc, std::size_t N>
+class small_vector {
+	static_assert(std::is_trivially_copyable<T>::value,
+	              "small_vector only stores trivially copyable types");
+
+public:
+	using value_type = T;
+	using allocator_type = Alloc;
+
+private:
+	Alloc m_alloc;
+	std::size_t m_size;
+	T* m_data;
+	T m_inline[N];
+
+	bool is_inline() const { return m_data == m_inline; }
+
+	T* allocate(std::size_t size) {
+		return size <= N ? m_inline : std::allocator_traits<Alloc>::allocate(m_alloc, size);
+	}
+
+	void deallocate() {
+		if (!is_inline()) {
+			std::allocator_traits<Alloc>::deallocate(m_alloc, m_data, m_size);
+		}
+	}
+
+public:
+	small_vector(std::size_t size, T value, Alloc alloc)
+	        : m_alloc{alloc}, m_size{size}, m_data{allocate(size)} {
+		std::fill(begin(), end(), value);
+	}
+
+	small_vector(const small_vector& other)
+	        : m_alloc{other.m_alloc}, m_size{other.m_size}, m_data{allocate(m_size)} {
+		std::copy(other.begin(), other.end(), begin());
+	}
+
+	/** Copies another vector into storage obtained from the given allocator. */
+	small_vector(const small_vector& other, Alloc alloc)
+	        : m_alloc{alloc}, m_size{other.m_size}, m_data{allocate(m_size)} {
+		std::copy(other.begin(), other.end(), begin());
+	}
+
+	small_vector(small_vector&& other) noexcept
+	        : m_alloc{other.m_alloc}, m_size{other.m_size}, m_data{m_inline} {
+		if (other.is_inline()) {
+			std::copy(other.begin(), other.end(), begin());
+		} else {
+			m_data = other.m_data;
+			other.m_data = other.m_inline;
+			other.m_size = 0;
+		}
+	}
+
+	small_vector& operator=(const small_vector& other) {
+		if (this != &other) {
+			// like std::vector, the allocator is not propagated
+			if (m_size != other.m_size) {
+				deallocate();
+				m_size = other.m_size;
+				m_data = allocate(m_size);
+			}
+			std::copy(other.begin(), other.end(), begin());
+		}
+		return *this;
+	}
+
+	small_vector& operator=(small_vector&& other) {
+		if (this == &other) {
+			return *this;
+		}
+		if (other.is_inline() || !(m_alloc == other.m_alloc)) {
+			return *this = static_cast<const small_vector&>(other);
+		}
+		// like std::vector, take over the storage of an equal allocator
+		deallocate();
+		m_size = other.m_size;
+		m_data = other.m_data;
+		other.m_data = other.m_inline;
+		other.m_size = 0;
+		return *this;
+	}
+
+	~small_vector() { deallocate(); }
+
+	std::size_t size() const { return m_size; }
+	T& operator[](std::size_t i) {
+		assert(i < m_size);
+		return m_data[i];
+	}
+	const T& operator[](std::size_t i) const {
+		assert(i < m_size);
+		return m_data[i];
+	}
+	T* begin() { return m_data; }
+	T* end() { return m_data + m_size; }
+	const T* begin() const { return m_data; }
+	const T* end() const { return m_data + m_size; }
+
+	Alloc get_allocator() const { return m_alloc; }
+
+	bool operator==(const small_vector& other) const {
+		return m_size == other.m_size && std::equal(begin(), end(), other.begin());
+	}
+	bool operator<(const small_vector& other) const {
+		return std::lexicographical_compare(begin(), end(), other.begin(), other.end());
+	}
+};
+
+} // namespace utils
+} // namespace terraces
+
+#endif // TERRACES_SMALL_VECTOR_HPP
@@ -1,11 +1,14 @@
 #ifndef TERRACES_STACK_ALLOCATOR_HPP
 #define TERRACES_STACK_ALLOCATOR_HPP
 
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <memory>
 #include <new>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -35,6 +38,146 @@ private:
 	std::vector<char_buffer> m_list;
 };
 
+/**
+ * A LIFO memory region for the temporary data of an enumeration.
+ * Memory is handed out by bumping a pointer without any per-object bookkeeping
+ * and only reclaimed by releasing everything that was allocated after a \ref mark.
+ * The region consists of a list of chunks, so growing it never moves existing allocations.
+ * Between two calls to \ref reset, an arena may only be used by a single thread,
+ * which is checked in debug builds.
+ */
+class arena {
+public:
+	/** A position in the arena, see \ref mark and \ref release. */
+	struct marker {
+		std::size_t chunk;
+		std::size_t offset;
+	};
+
+	arena() : m_chunk{0}, m_offset{0}, m_peak{0} {}
+
+	/** Releases all memory and makes sure the first chunk can hold the given byte count. */
+	void reset(std::size_t bytes) {
+		m_chunks.clear();
+#ifndef NDEBUG
+		m_owner = std::thread::id{};
+#endif
+		m_chunk = 0;
+		m_offset = 0;
+		m_peak = 0;
+		if (bytes > 0) {
+			add_chunk(bytes);
+		}
+	}
+
+	void* allocate(std::size_t bytes) {
+		check_owner();
+		// keep all allocations maximally aligned
+		const auto align = alignof(std::max_align_t);
+		bytes = (bytes + align - 1) / align * align;
+		if (m_chunks.empty() || m_offset + bytes > m_chunks[m_chunk].size) {
+			next_chunk(bytes);
+		}
+		auto result = m_chunks[m_chunk].data.get() + m_offset;
+		m_offset += bytes;
+		m_peak = std::max(m_peak, used_bytes());
+		return result;
+	}
+
+	/** Returns the current position, which can later be restored using \ref release. */
+	marker mark() const {
+		check_owner();
+		return {m_chunk, m_offset};
+	}
+	/** Frees all memory allocated since the given \ref mark. */
+	void release(marker m) {
+		check_owner();
+		assert(m.chunk < m_chunk || (m.chunk == m_chunk && m.offset <= m_offset));
+		m_chunk = m.chunk;
+		m_offset = m.offset;
+	}
+
+	/** Returns the number of bytes currently in use, including unused chunk tails. */
+	std::size_t used_bytes() const {
+		return m_chunks.empty() ? 0 : m_chunks[m_chunk].first_byte + m_offset;
+	}
+	/** Returns the maximal number of bytes in use since the last \ref reset. */
+	std::size_t peak_bytes() const { return m_peak; }
+	/** Returns the number of bytes allocated from the system. */
+	std::size_t capacity_bytes() const {
+		return m_chunks.empty() ? 0 : m_chunks.back().first_byte + m_chunks.back().size;
+	}
+
+private:
+	struct chunk {
+		char_buffer data;
+		std::size_t size;
+		// number of bytes in all previous chunks
+		std::size_t first_byte;
+	};
+
+	std::vector<chunk> m_chunks;
+	std::size_t m_chunk;
+	std::size_t m_offset;
+	std::size_t m_peak;
+#ifndef NDEBUG
+	// the thread using the arena since the last reset, arenas must never be shared
+	mutable std::thread::id m_owner;
+#endif
+
+	void check_owner() const {
+#ifndef NDEBUG
+		if (m_owner == std::thread::id{}) {
+			m_owner = std::this_thread::get_id();
+		}
+		assert(m_owner == std::this_thread::get_id());
+#endif
+	}
+
+	void add_chunk(std::size_t bytes) {
+		auto first_byte = capacity_bytes();
+		char_buffer buffer{static_cast<char*>(::operator new[](bytes))};
+		m_chunks.push_back({std::move(buffer), bytes, first_byte});
+	}
+
+	void next_chunk(std::size_t bytes) {
+		if (!m_chunks.empty() && m_chunk + 1 < m_chunks.size() &&
+		    m_chunks[m_chunk + 1].size >= bytes) {
+			++m_chunk;
+			m_offset = 0;
+			return;
+		}
+		// the chunks after the current one are unused, replace them by a larger one
+		auto size = std::max(bytes, 2 * capacity_bytes());
+		if (!m_chunks.empty()) {
+			m_chunks.erase(m_chunks.begin() + static_cast<std::ptrdiff_t>(m_chunk) + 1,
+			               m_chunks.end());
+			++m_chunk;
+		}
+		add_chunk(size);
+		m_offset = 0;
+	}
+};
+
+/** Releases all allocations of an arena made during the lifetime of this object. */
+class arena_scope {
+public:
+	explicit arena_scope(arena& a) : m_arena{a}, m_mark{a.mark()} {}
+	~arena_scope() { m_arena.release(m_mark); }
+	arena_scope(const arena_scope&) = delete;
+	arena_scope& operator=(const arena_scope&) = delete;
+
+private:
+	arena& m_arena;
+	arena::marker m_mark;
+};
+
+/**
+ * An allocator for buffers of a fixed maximal size,
+ * which are either recycled through a \ref free_list or taken from an \ref arena.
+ * Deallocating from an arena is a no-op, the memory is reclaimed using \ref arena::release.
+ * Allocators with neither backend use the system allocator.
+ */
 template <typename T>
 class stack_allocator {
 	template <typename U>
@@ -45,25 +188,45 @@ public:
 	 * The debug stdlib of cl uses a _Container_proxy with the allocator that contains two
 	 * pointers. So we use a sufficient upper bound instead of the exact vector storage size.
 	 */
-	stack_allocator(free_list& fl, std::size_t n) : m_fl{&fl}, m_expected_size {
-		n*
+	static std::size_t expected_size(std::size_t n) {
+		return n *
 #if defined(_MSC_VER) && defined(_DEBUG)
-		        (sizeof(T) + 2 * sizeof(void*))
+		       (sizeof(T) + 2 * sizeof(void*));
 #else
-		        sizeof(T)
+		       sizeof(T);
 #endif
 	}
-	{}
+
+	stack_allocator(free_list& fl, std::size_t n)
+	        : m_fl{&fl}, m_arena{nullptr}, m_expected_size{expected_size(n)} {}
+
+	stack_allocator(arena& a, std::size_t n)
+	        : m_fl{nullptr}, m_arena{&a}, m_expected_size{expected_size(n)} {}
 
 	template <typename U>
 	stack_allocator(const stack_allocator<U>& other)
-	        : m_fl{other.m_fl}, m_expected_size{other.m_expected_size} {}
+	        : m_fl{other.m_fl}, m_arena{other.m_arena},
+	          m_expected_size{other.m_expected_size} {}
+
+	/**
+	 * Creates an allocator for buffers of n objects using the arena of another allocator.
+	 * Buffers of a different size cannot be recycled through the same free list,
+	 * so allocators backed by a free list are replaced by the system allocator.
+	 */
+	template <typename U>
+	stack_allocator(const stack_allocator<U>& other, std::size_t n)
+	        : m_fl{nullptr}, m_arena{other.m_arena}, m_expected_size{expected_size(n)} {}
 
 	using value_type = T;
 
 	T* allocate(std::size_t n) {
 		assert(n * sizeof(T) <= m_expected_size);
-		(void)n;
+		if (m_arena != nullptr) {
+			return static_cast<T*>(m_arena->allocate(n * sizeof(T)));
+		}
+		if (m_fl == nullptr) {
+			return system_allocate();
+		}
 		auto ret = m_fl->pop();
 		if (ret == nullptr) {
 			return system_allocate();
@@ -72,12 +235,19 @@ public:
 	}
 
 	void deallocate(T* ptr, std::size_t) {
+		if (m_arena != nullptr) {
+			return;
+		}
 		auto p = char_buffer{reinterpret_cast<char*>(ptr)};
-		m_fl->push(std::move(p));
+		if (m_fl != nullptr) {
+			m_fl->push(std::move(p));
+		}
 	}
 
 	friend bool operator==(const stack_allocator& lhs, const stack_allocator& rhs) {
-		return lhs.m_expected_size == rhs.m_expected_size;
+		// memory can only be exchanged between allocators with the same backend
+		return lhs.m_fl == rhs.m_fl && lhs.m_arena == rhs.m_arena &&
+		       lhs.m_expected_size == rhs.m_expected_size;
 	}
 
 	friend bool operator!=(const stack_allocator& lhs, const stack_allocator& rhs) {
@@ -91,6 +261,7 @@ private:
 	}
 
 	free_list* m_fl;
+	arena* m_arena;
 	std::size_t m_expected_size;
 };
 
@@ -0,0 +1,172 @@
+#ifndef TERRACES_SUBPROBLEM_CACHE_HPP
+#define TERRACES_SUBPROBLEM_CACHE_HPP
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include <terraces/definitions.hpp>
+
+namespace terraces {
+
+/** Statistics collected by a \ref subproblem_cache. */
+struct cache_statistics {
+	/** Number of successful lookups. */
+	index_t hits{};
+	/** Number of unsuccessful lookups. */
+	index_t misses{};
+	/** Number of inserted entries. */
+	index_t insertions{};
+	/** Number of entries evicted to stay within the memory budget. */
+	index_t evictions{};
+	/** Approximate number of bytes currently occupied by the entries. */
+	index_t bytes{};
+	/** Maximal value of \ref bytes. */
+	index_t peak_bytes{};
+};
+
+/**
+ * A bounded cache mapping leaf sets to the results of the corresponding recursive subcall.
+ * The leaf sets are stored as a copy of their bitvector blocks together with a hash value.
+ * If the memory budget is exceeded, the least recently used entries are evicted.
+ */
+template <typename Value>
+class subproblem_cache {
+private:
+	struct entry {
+		std::size_t hash;
+		std::vector<index_t> blocks;
+		Value value;
+	};
+	using entry_list = std::list<entry>;
+	using entry_iterator = typename entry_list::iterator;
+
+	// most recently used entries come first
+	entry_list m_entries;
+	std::unordered_multimap<std::size_t, entry_iterator> m_index;
+	index_t m_max_bytes;
+	cache_statistics m_stats;
+
+	template <typename Bitvector>
+	static std::size_t hash(const Bitvector& set) {
+		std::size_t result = set.num_blocks();
+		for (index_t b = 0; b < set.num_blocks(); ++b) {
+			result ^= std::hash<index_t>{}(set.block(b)) + 0x9e3779b9 + (result << 6) +
+			          (result >> 2);
+		}
+		return result;
+	}
+
+	template <typename Bitvector>
+	static bool equal(const entry& e, const Bitvector& set) {
+		if (e.blocks.size() != set.num_blocks()) {
+			return false;
+		}
+		for (index_t b = 0; b < set.num_blocks(); ++b) {
+			if (e.blocks[b] != set.block(b)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static index_t entry_bytes(const entry& e) {
+		// list node, index node and key storage
+		return sizeof(entry) + 4 * sizeof(void*) + e.blocks.size() * sizeof(index_t);
+	}
+
+	template <typename Bitvector>
+	entry_iterator lookup(const Bitvector& set, std::size_t h) {
+		auto range = m_index.equal_range(h);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (equal(*it->second, set)) {
+				return it->second;
+			}
+		}
+		return m_entries.end();
+	}
+
+	void evict_last() {
+		auto last = std::prev(m_entries.end());
+		auto range = m_index.equal_range(last->hash);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (it->second == last) {
+				m_index.erase(it);
+				break;
+			}
+		}
+		m_stats.bytes -= entry_bytes(*last);
+		++m_stats.evictions;
+		m_entries.erase(last);
+	}
+
+public:
+	/** Initializes an empty cache that occupies at most \p max_bytes bytes (approximately). */
+	explicit subproblem_cache(index_t max_bytes) : m_max_bytes{max_bytes} {}
+
+	/**
+	 * Returns a pointer to the value stored for the given leaf set or nullptr if there is none.
+	 * The pointer stays valid until the next call to \ref insert.
+	 */
+	template <typename Bitvector>
+	const Value* find(const Bitvector& set) {
+		auto it = lookup(set, hash(set));
+		if (it == m_entries.end()) {
+			++m_stats.misses;
+			return nullptr;
+		}
+		++m_stats.hits;
+		m_entries.splice(m_entries.begin(), m_entries, it);
+		return &it->value;
+	}
+
+	/** Stores the value for the given leaf set, evicting old entries if necessary. */
+	template <typename Bitvector>
+	void insert(const Bitvector& set, Value value) {
+		auto h = hash(set);
+		auto it = lookup(set, h);
+		if (it != m_entries.end()) {
+			it->value = std::move(value);
+			m_entries.splice(m_entries.begin(), m_entries, it);
+			return;
+		}
+		std::vector<index_t> blocks(set.num_blocks());
+		for (index_t b = 0; b < set.num_blocks(); ++b) {
+			blocks[b] = set.block(b);
+		}
+		m_entries.push_front({h, std::move(blocks), std::move(value)});
+		auto bytes = entry_bytes(m_entries.front());
+		if (bytes > m_max_bytes) {
+			// the entry would never fit
+			m_entries.pop_front();
+			return;
+		}
+		m_index.emplace(h, m_entries.begin());
+		++m_stats.insertions;
+		m_stats.bytes += bytes;
+		while (m_stats.bytes > m_max_bytes) {
+			evict_last();
+		}
+		m_stats.peak_bytes = std::max(m_stats.peak_bytes, m_stats.bytes);
+	}
+
+	/** Returns the number of stored entries. */
+	index_t size() const { return m_index.size(); }
+
+	/** Returns the statistics collected since the construction. */
+	const cache_statistics& statistics() const { return m_stats; }
+
+	/** Removes all entries from the cache. */
+	void clear() {
+		m_entries.clear();
+		m_index.clear();
+		m_stats.bytes = 0;
+	}
+};
+
+} // namespace terraces
+
+#endif // TERRACES_SUBPROBLEM_CACHE_HPP
@@ -10,26 +10,33 @@
 
 namespace terraces {
 
+template <typename Callback>
+class parallel_tree_enumerator;
+
 template <typename Callback>
 class tree_enumerator {
 	using result_type = typename Callback::result_type;
+	friend class parallel_tree_enumerator<Callback>;
 
 private:
 	Callback m_cb;
 
-	utils::free_list m_fl1;
-	utils::free_list m_fl2;
-	utils::free_list m_fl3;
+	utils::arena m_arena;
 	index_t m_fl1_allocsize;
 	index_t m_fl2_allocsize;
 	index_t m_fl3_allocsize;
 
 	const constraints* m_constraints;
+	leaf_constraint_index m_constraint_index;
+	constraint_table m_constraint_table;
+	rollback_union_find m_union_find_scratch;
 
-	result_type run(const ranked_bitvector& leaves, const bitvector& constraint_occ);
+	result_type run(const ranked_bitvector& leaves, const ranked_bitvector& parent_leaves,
+	                const bitvector& constraint_occ);
 	result_type iterate(bipartitions& bip_it, const bitvector& new_constraint_occ);
 
 	void init_freelists(index_t leaf_count, index_t constraint_count);
+	void init_constraints(index_t leaf_count, const constraints& constraints);
 	utils::stack_allocator<index_t> leaf_allocator();
 	utils::stack_allocator<index_t> c_occ_allocator();
 	utils::stack_allocator<index_t> union_find_allocator();
@@ -40,7 +47,17 @@ public:
 	                const std::vector<bool>& root_split);
 	result_type run(index_t num_leaves, const constraints& constraints, index_t root_leaf);
 	result_type run(index_t num_leaves, const constraints& constraints);
+	/**
+	 * Enumerates the trees on the subset [begin, end) of the leaves
+	 * that satisfy all constraints on leaves from this subset,
+	 * as the recursion would for the same leaf set.
+	 */
+	result_type run_subproblem(index_t num_leaves, const constraints& constraints,
+	                           const index_t* begin, const index_t* end);
 	const Callback& callback() const { return m_cb; }
+	Callback& callback() { return m_cb; }
+	/** Returns the maximal amount of temporary memory used by the last run in bytes. */
+	std::size_t peak_scratch_bytes() const { return m_arena.peak_bytes(); }
 };
 
 template <typename Callback>
@@ -54,8 +71,8 @@ auto tree_enumerator<Callback>::run(index_t num_leaves, const constraints& const
 	auto leaves = full_ranked_set(num_leaves, leaf_allocator());
 	auto c_occ = full_set(constraints.size(), c_occ_allocator());
 	assert(filter_constraints(leaves, c_occ, constraints, c_occ_allocator()) == c_occ);
-	m_constraints = &constraints;
-	return run(leaves, c_occ);
+	init_constraints(num_leaves, constraints);
+	return run(leaves, leaves, c_occ);
 }
 
 template <typename Callback>
@@ -73,7 +90,7 @@ auto tree_enumerator<Callback>::run(index_t num_leaves, const constraints& const
 	// assert(!constraints.empty()); is not necessary, since is returns correct values anyway
 	// build bipartition iterator:
 	auto sets = union_find::make_bipartition(root_split, union_find_allocator());
-	m_constraints = &constraints;
+	init_constraints(num_leaves, constraints);
 	auto bip_it = bipartitions{leaves, sets, leaf_allocator()};
 	return m_cb.exit(iterate(bip_it, c_occ));
 }
@@ -87,8 +104,28 @@ auto tree_enumerator<Callback>::run(index_t num_leaves, const constraints& const
 }
 
 template <typename Callback>
-auto tree_enumerator<Callback>::run(const ranked_bitvector& leaves, const bitvector& constraint_occ)
+auto tree_enumerator<Callback>::run_subproblem(index_t num_leaves, const constraints& constraints,
+                                               const index_t* begin, const index_t* end)
         -> result_type {
+	init_freelists(num_leaves, constraints.size());
+	auto all_leaves = full_ranked_set(num_leaves, leaf_allocator());
+	ranked_bitvector leaves{num_leaves, leaf_allocator()};
+	for (auto it = begin; it != end; ++it) {
+		assert(*it < num_leaves);
+		leaves.set(*it);
+	}
+	leaves.update_ranks();
+	auto c_occ = full_set(constraints.size(), c_occ_allocator());
+	init_constraints(num_leaves, constraints);
+	return run(leaves, all_leaves, c_occ);
+}
+
+template <typename Callback>
+auto tree_enumerator<Callback>::run(const ranked_bitvector& leaves,
+                                    const ranked_bitvector& parent_leaves,
+                                    const bitvector& constraint_occ) -> result_type {
+	// all temporary data of this call is released when it returns
+	utils::arena_scope scope{m_arena};
 	m_cb.enter(leaves);
 
 	// base cases: only a few leaves
@@ -103,18 +140,34 @@ auto tree_enumerator<Callback>::run(const ranked_bitvector& leaves, const bitvec
 		return m_cb.exit(m_cb.base_two_leaves(fst, snd));
 	}
 
+	if (m_cb.has_memoized(leaves)) {
+		return m_cb.exit(m_cb.memoized_value(leaves));
+	}
+
 	bitvector new_constraint_occ =
-	        filter_constraints(leaves, constraint_occ, *m_constraints, c_occ_allocator());
+	        filter_constraints(parent_leaves, leaves, constraint_occ, m_constraint_table,
+	                           m_constraint_index, c_occ_allocator());
 	// base case: no constraints left
 	if (new_constraint_occ.empty()) {
 		return m_cb.exit(m_cb.base_unconstrained(leaves));
 	}
 
-	union_find sets = apply_constraints(leaves, new_constraint_occ, *m_constraints,
-	                                    union_find_allocator());
+	if (m_cb.separate_free_leaves()) {
+		auto constrained = constrained_leaves(leaves, new_constraint_occ, *m_constraints,
+		                                      leaf_allocator());
+		auto num_free = leaves.count() - constrained.count();
+		if (num_free > 0) {
+			auto result = run(constrained, leaves, new_constraint_occ);
+			return m_cb.exit(
+			        m_cb.add_free_leaves(result, constrained.count(), num_free));
+		}
+	}
+
+	union_find sets = apply_constraints(leaves, new_constraint_occ, m_constraint_table,
+	                                    m_union_find_scratch, union_find_allocator());
 	bipartitions bip_it(leaves, sets, leaf_allocator());
 
-	return m_cb.exit(iterate(bip_it, new_constraint_occ));
+	return m_cb.exit(m_cb.memoize(leaves, iterate(bip_it, new_constraint_occ)));
 }
 
 template <typename Callback>
@@ -122,24 +175,31 @@ void tree_enumerator<Callback>::init_freelists(index_t leaf_count, index_t const
 	m_fl1_allocsize = ranked_bitvector::alloc_size(leaf_count);
 	m_fl2_allocsize = ranked_bitvector::alloc_size(constraint_count);
 	m_fl3_allocsize = leaf_count;
-	m_fl1 = {};
-	m_fl2 = {};
-	m_fl3 = {};
+	m_arena.reset(initial_arena_bytes(leaf_count, constraint_count));
+}
+
+template <typename Callback>
+void tree_enumerator<Callback>::init_constraints(index_t leaf_count,
+                                                 const constraints& constraints) {
+	m_constraints = &constraints;
+	m_constraint_index = {leaf_count, constraints};
+	m_constraint_table = {leaf_count, constraints};
+	m_union_find_scratch = rollback_union_find{leaf_count};
 }
 
 template <typename Callback>
 utils::stack_allocator<index_t> tree_enumerator<Callback>::leaf_allocator() {
-	return {m_fl1, m_fl1_allocsize};
+	return {m_arena, m_fl1_allocsize};
 }
 
 template <typename Callback>
 utils::stack_allocator<index_t> tree_enumerator<Callback>::c_occ_allocator() {
-	return {m_fl2, m_fl2_allocsize};
+	return {m_arena, m_fl2_allocsize};
 }
 
 template <typename Callback>
 utils::stack_allocator<index_t> tree_enumerator<Callback>::union_find_allocator() {
-	return {m_fl3, m_fl3_allocsize};
+	return {m_arena, m_fl3_allocsize};
 }
 
 template <typename Callback>
@@ -151,15 +211,18 @@ auto tree_enumerator<Callback>::iterate(bipartitions& bip_it, const bitvector& n
 
 	auto result = m_cb.begin_iteration(bip_it, new_constraint_occ, *m_constraints);
 	// iterate over all possible bipartitions
+	auto set = bip_it.get_first_set(0, leaf_allocator());
 	for (auto bip = bip_it.begin_bip();
 	     bip < bip_it.end_bip() && m_cb.continue_iteration(result); ++bip) {
+		utils::arena_scope scope{m_arena};
 		m_cb.step_iteration(bip_it, bip);
-		auto set = bip_it.get_first_set(bip, leaf_allocator());
+		bip_it.next_first_set(set, bip);
 		m_cb.left_subcall();
-		auto left_result = run(set, new_constraint_occ);
-		bip_it.flip_set(set);
+		auto left_result = run(set, bip_it.leaves(), new_constraint_occ);
+		auto other_set = set;
+		bip_it.flip_set(other_set);
 		m_cb.right_subcall();
-		auto right_result = run(set, new_constraint_occ);
+		auto right_result = run(other_set, bip_it.leaves(), new_constraint_occ);
 		// accumulate result
 		result = m_cb.accumulate(result, m_cb.combine(left_result, right_result));
 	}
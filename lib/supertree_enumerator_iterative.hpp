@@ -0,0 +1,433 @@
+#ifndef SUPERTREE_ENUMERATOR_ITERATIVE_HPP
+#define SUPERTREE_ENUMERATOR_ITERATIVE_HPP
+
+#include <memory>
+#include <type_traits>
+
+#include "bipartitions.hpp"
+#include "stack_allocator.hpp"
+#include "union_find.hpp"
+
+#include "supertree_helpers.hpp"
+#include "utils.hpp"
+
+namespace terraces {
+
+/**
+ * A non-recursive version of \ref tree_enumerator.
+ * Instead of native stack frames, the state of every recursive call that iterates over
+ * bipartitions is stored in a frame on an explicit stack, which is allocated contiguously
+ * once per run and can hold one frame per leaf.
+ * The callback methods are called in exactly the same order as by \ref tree_enumerator.
+ * The enumeration can be executed step by step using \ref start and \ref step,
+ * which allows inspecting the recursion state in between.
+ */
+template <typename Callback>
+class iterative_tree_enumerator {
+	using result_type = typename Callback::result_type;
+
+private:
+	enum class frame_stage { begin, next_bip, left, right };
+
+	struct frame {
+		ranked_bitvector leaves;
+		bitvector c_occ;
+		union_find sets;
+		bipartitions bip_it;
+		// first and second leaf set of the current bipartition
+		ranked_bitvector subset;
+		ranked_bitvector other_subset;
+		index_t bip;
+		// number of leaves that were separated from the leaf set by the caller
+		index_t num_free;
+		bool memoize;
+		frame_stage stage;
+		result_type result;
+		result_type left_result;
+		// arena position before the call was started, restored when the frame is popped
+		utils::arena::marker scratch_mark;
+
+		frame(const ranked_bitvector& leaves, bitvector c_occ, union_find sets,
+		      utils::stack_allocator<index_t> leaf_alloc, index_t num_free, bool memoize)
+		        : leaves{leaves}, c_occ{std::move(c_occ)}, sets{std::move(sets)},
+		          bip_it{this->leaves, this->sets, leaf_alloc},
+		          subset{bip_it.get_first_set(0, leaf_alloc)},
+		          other_subset{leaves.size(), leaf_alloc}, bip{}, num_free{num_free},
+		          memoize{memoize}, stage{frame_stage::begin}, result{}, left_result{},
+		          scratch_mark{} {}
+	};
+	using frame_storage = typename std::aligned_storage<sizeof(frame), alignof(frame)>::type;
+
+	Callback m_cb;
+
+	utils::arena m_arena;
+	index_t m_fl1_allocsize;
+	index_t m_fl2_allocsize;
+	index_t m_fl3_allocsize;
+
+	const constraints* m_constraints;
+	leaf_constraint_index m_constraint_index;
+	constraint_table m_constraint_table;
+	rollback_union_find m_union_find_scratch;
+
+	std::unique_ptr<frame_storage[]> m_frames;
+	index_t m_capacity;
+	index_t m_depth;
+	bool m_finished;
+	result_type m_result;
+
+	frame& top() { return frame_at(m_depth - 1); }
+	frame& frame_at(index_t level) { return *reinterpret_cast<frame*>(&m_frames[level]); }
+	const frame& frame_at(index_t level) const {
+		return *reinterpret_cast<const frame*>(&m_frames[level]);
+	}
+	void push(const ranked_bitvector& leaves, bitvector c_occ, union_find sets,
+	          index_t num_free, bool memoize);
+	void pop();
+	void clear();
+
+	bool start_call(const ranked_bitvector& leaves, const ranked_bitvector& parent_leaves,
+	                const bitvector& constraint_occ, index_t num_free, result_type& result);
+	bool begin_call(const ranked_bitvector& leaves, const ranked_bitvector& parent_leaves,
+	                const bitvector& constraint_occ, index_t num_free, result_type& result);
+	void finish_call(result_type result);
+	void deliver(result_type result);
+
+	void init(index_t num_leaves, const constraints& constraints);
+	utils::stack_allocator<index_t> leaf_allocator();
+	utils::stack_allocator<index_t> c_occ_allocator();
+	utils::stack_allocator<index_t> union_find_allocator();
+
+public:
+	explicit iterative_tree_enumerator(Callback cb);
+	~iterative_tree_enumerator();
+	iterative_tree_enumerator(const iterative_tree_enumerator&) = delete;
+	iterative_tree_enumerator& operator=(const iterative_tree_enumerator&) = delete;
+
+	result_type run(index_t num_leaves, const constraints& constraints,
+	                const std::vector<bool>& root_split);
+	result_type run(index_t num_leaves, const constraints& constraints, index_t root_leaf);
+	result_type run(index_t num_leaves, const constraints& constraints);
+
+	/** Prepares a step-by-step enumeration of all trees with the given root split. */
+	void start(index_t num_leaves, const constraints& constraints,
+	           const std::vector<bool>& root_split);
+	/** Prepares a step-by-step enumeration of all trees. */
+	void start(index_t num_leaves, const constraints& constraints);
+	/**
+	 * Executes a single step of the enumeration, i.e. starts or finishes the iteration over
+	 * the bipartitions of the topmost frame or executes one of its subcalls.
+	 * \returns false if and only if the enumeration has finished.
+	 */
+	bool step();
+	/** Returns true if and only if the enumeration has finished. */
+	bool finished() const { return m_finished; }
+	/** Returns the result of a finished enumeration. */
+	const result_type& result() const { return m_result; }
+
+	/** Returns the number of frames on the stack. */
+	index_t depth() const { return m_depth; }
+	/** Returns the leaf set of the frame at the given level (0 is the outermost call). */
+	const ranked_bitvector& leaves(index_t level) const { return frame_at(level).leaves; }
+	/** Returns the bipartitions of the frame at the given level. */
+	const bipartitions& bipartitions_at(index_t level) const { return frame_at(level).bip_it; }
+	/** Returns the current bipartition index of the frame at the given level. */
+	index_t current_bip(index_t level) const { return frame_at(level).bip; }
+	/** Returns the result accumulated so far in the frame at the given level. */
+	const result_type& intermediate_result(index_t level) const {
+		return frame_at(level).result;
+	}
+
+	const Callback& callback() const { return m_cb; }
+	/** Returns the maximal amount of temporary memory used by the last run in bytes. */
+	std::size_t peak_scratch_bytes() const { return m_arena.peak_bytes(); }
+};
+
+template <typename Callback>
+iterative_tree_enumerator<Callback>::iterative_tree_enumerator(Callback cb)
+        : m_cb{std::move(cb)}, m_fl1_allocsize{}, m_fl2_allocsize{}, m_fl3_allocsize{},
+          m_constraints{nullptr}, m_capacity{}, m_depth{}, m_finished{true}, m_result{} {}
+
+template <typename Callback>
+iterative_tree_enumerator<Callback>::~iterative_tree_enumerator() {
+	clear();
+}
+
+template <typename Callback>
+void iterative_tree_enumerator<Callback>::init(index_t num_leaves, const constraints& constraints) {
+	clear();
+	m_fl1_allocsize = ranked_bitvector::alloc_size(num_leaves);
+	m_fl2_allocsize = ranked_bitvector::alloc_size(constraints.size());
+	m_fl3_allocsize = num_leaves;
+	m_arena.reset(initial_arena_bytes(num_leaves, constraints.size()));
+	m_constraints = &constraints;
+	m_constraint_index = {num_leaves, constraints};
+	m_constraint_table = {num_leaves, constraints};
+	m_union_find_scratch = rollback_union_find{num_leaves};
+	// every frame has fewer leaves than its parent, except for the frame of the constrained
+	// leaves after separating free leaves
+	if (m_capacity < num_leaves + 1) {
+		m_capacity = num_leaves + 1;
+		m_frames.reset(new frame_storage[m_capacity]);
+	}
+	m_finished = false;
+	m_result = result_type{};
+}
+
+template <typename Callback>
+utils::stack_allocator<index_t> iterative_tree_enumerator<Callback>::leaf_allocator() {
+	return {m_arena, m_fl1_allocsize};
+}
+
+template <typename Callback>
+utils::stack_allocator<index_t> iterative_tree_enumerator<Callback>::c_occ_allocator() {
+	return {m_arena, m_fl2_allocsize};
+}
+
+template <typename Callback>
+utils::stack_allocator<index_t> iterative_tree_enumerator<Callback>::union_find_allocator() {
+	return {m_arena, m_fl3_allocsize};
+}
+
+template <typename Callback>
+void iterative_tree_enumerator<Callback>::push(const ranked_bitvector& leaves, bitvector c_occ,
+                                               union_find sets, index_t num_free, bool memoize) {
+	assert(m_depth < m_capacity);
+	auto mark = m_arena.mark();
+	new (&m_frames[m_depth]) frame{leaves, std::move(c_occ), std::move(sets), leaf_allocator(),
+	                               num_free, memoize};
+	frame_at(m_depth).scratch_mark = mark;
+	++m_depth;
+}
+
+template <typename Callback>
+void iterative_tree_enumerator<Callback>::pop() {
+	assert(m_depth > 0);
+	--m_depth;
+	auto mark = frame_at(m_depth).scratch_mark;
+	frame_at(m_depth).~frame();
+	m_arena.release(mark);
+}
+
+template <typename Callback>
+void iterative_tree_enumerator<Callback>::clear() {
+	while (m_depth > 0) {
+		pop();
+	}
+}
+
+template <typename Callback>
+void iterative_tree_enumerator<Callback>::start(index_t num_leaves, const constraints& constraints,
+                                                const std::vector<bool>& root_split) {
+	init(num_leaves, constraints);
+	auto mark = m_arena.mark();
+	auto leaves = full_ranked_set(num_leaves, leaf_allocator());
+	auto c_occ = full_set(constraints.size(), c_occ_allocator());
+	assert(filter_constraints(leaves, c_occ, constraints, c_occ_allocator()) == c_occ);
+	assert(root_split.size() == num_leaves);
+	m_cb.enter(leaves);
+	// no base cases
+	assert(num_leaves > 2);
+	auto sets = union_find::make_bipartition(root_split, union_find_allocator());
+	push(leaves, std::move(c_occ), std::move(sets), 0, false);
+	top().scratch_mark = mark;
+}
+
+template <typename Callback>
+void iterative_tree_enumerator<Callback>::start(index_t num_leaves,
+                                                const constraints& constraints) {
+	init(num_leaves, constraints);
+	auto leaves = full_ranked_set(num_leaves, leaf_allocator());
+	auto c_occ = full_set(constraints.size(), c_occ_allocator());
+	assert(filter_constraints(leaves, c_occ, constraints, c_occ_allocator()) == c_occ);
+	result_type result{};
+	if (start_call(leaves, leaves, c_occ, 0, result)) {
+		m_result = result;
+		m_finished = true;
+	}
+}
+
+template <typename Callback>
+auto iterative_tree_enumerator<Callback>::run(index_t num_leaves, const constraints& constraints,
+                                              const std::vector<bool>& root_split)
+        -> result_type {
+	start(num_leaves, constraints, root_split);
+	while (step()) {
+	}
+	return m_result;
+}
+
+template <typename Callback>
+auto iterative_tree_enumerator<Callback>::run(index_t num_leaves, const constraints& constraints,
+                                              index_t root_leaf) -> result_type {
+	std::vector<bool> root_split(num_leaves);
+	root_split[root_leaf] = true;
+	return run(num_leaves, constraints, root_split);
+}
+
+template <typename Callback>
+auto iterative_tree_enumerator<Callback>::run(index_t num_leaves, const constraints& constraints)
+        -> result_type {
+	start(num_leaves, constraints);
+	while (step()) {
+	}
+	return m_result;
+}
+
+template <typename Callback>
+bool iterative_tree_enumerator<Callback>::start_call(const ranked_bitvector& leaves,
+                                                     const ranked_bitvector& parent_leaves,
+                                                     const bitvector& constraint_occ,
+                                                     index_t num_free, result_type& result) {
+	// the temporary data of the call lives until the call finishes,
+	// which is either now or when its frame is popped
+	auto mark = m_arena.mark();
+	if (begin_call(leaves, parent_leaves, constraint_occ, num_free, result)) {
+		m_arena.release(mark);
+		return true;
+	}
+	top().scratch_mark = mark;
+	return false;
+}
+
+template <typename Callback>
+bool iterative_tree_enumerator<Callback>::begin_call(const ranked_bitvector& leaves,
+                                                     const ranked_bitvector& parent_leaves,
+                                                     const bitvector& constraint_occ,
+                                                     index_t num_free, result_type& result) {
+	m_cb.enter(leaves);
+
+	// base cases: only a few leaves
+	assert(leaves.count() > 0);
+	if (leaves.count() == 1) {
+		result = m_cb.exit(m_cb.base_one_leaf(leaves.first_set()));
+		return true;
+	}
+
+	if (leaves.count() == 2) {
+		auto fst = leaves.first_set();
+		auto snd = leaves.next_set(fst);
+		result = m_cb.exit(m_cb.base_two_leaves(fst, snd));
+		return true;
+	}
+
+	if (m_cb.has_memoized(leaves)) {
+		result = m_cb.exit(m_cb.memoized_value(leaves));
+		return true;
+	}
+
+	bitvector new_constraint_occ =
+	        filter_constraints(parent_leaves, leaves, constraint_occ, m_constraint_table,
+	                           m_constraint_index, c_occ_allocator());
+	// base case: no constraints left
+	if (new_constraint_occ.empty()) {
+		result = m_cb.exit(m_cb.base_unconstrained(leaves));
+		return true;
+	}
+
+	if (m_cb.separate_free_leaves()) {
+		auto constrained = constrained_leaves(leaves, new_constraint_occ, *m_constraints,
+		                                      leaf_allocator());
+		auto new_num_free = leaves.count() - constrained.count();
+		if (new_num_free > 0) {
+			if (begin_call(constrained, leaves, new_constraint_occ, new_num_free,
+			               result)) {
+				result = m_cb.exit(m_cb.add_free_leaves(result, constrained.count(),
+				                                        new_num_free));
+				return true;
+			}
+			return false;
+		}
+	}
+
+	union_find sets = apply_constraints(leaves, new_constraint_occ, m_constraint_table,
+	                                    m_union_find_scratch, union_find_allocator());
+	push(leaves, std::move(new_constraint_occ), std::move(sets), num_free, true);
+	return false;
+}
+
+template <typename Callback>
+void iterative_tree_enumerator<Callback>::finish_call(result_type result) {
+	auto& f = top();
+	auto num_free = f.num_free;
+	auto num_constrained = f.leaves.count();
+	if (f.memoize) {
+		result = m_cb.memoize(f.leaves, result);
+	}
+	pop();
+	result = m_cb.exit(result);
+	if (num_free > 0) {
+		result = m_cb.exit(m_cb.add_free_leaves(result, num_constrained, num_free));
+	}
+	deliver(result);
+}
+
+template <typename Callback>
+void iterative_tree_enumerator<Callback>::deliver(result_type result) {
+	if (m_depth == 0) {
+		m_result = result;
+		m_finished = true;
+		return;
+	}
+	auto& f = top();
+	if (f.stage == frame_stage::left) {
+		f.left_result = result;
+		f.other_subset = f.subset;
+		f.bip_it.flip_set(f.other_subset);
+		m_cb.right_subcall();
+		f.stage = frame_stage::right;
+		result_type right_result{};
+		if (start_call(f.other_subset, f.leaves, f.c_occ, 0, right_result)) {
+			deliver(right_result);
+		}
+	} else {
+		assert(f.stage == frame_stage::right);
+		// accumulate result
+		f.result = m_cb.accumulate(f.result, m_cb.combine(f.left_result, result));
+		++f.bip;
+		f.stage = frame_stage::next_bip;
+	}
+}
+
+template <typename Callback>
+bool iterative_tree_enumerator<Callback>::step() {
+	if (m_finished) {
+		return false;
+	}
+	auto& f = top();
+	switch (f.stage) {
+	case frame_stage::begin:
+		if (m_cb.fast_return(f.bip_it)) {
+			finish_call(m_cb.fast_return_value(f.bip_it));
+			break;
+		}
+		f.result = m_cb.begin_iteration(f.bip_it, f.c_occ, *m_constraints);
+		f.bip = f.bip_it.begin_bip();
+		f.stage = frame_stage::next_bip;
+		break;
+	case frame_stage::next_bip:
+		if (f.bip < f.bip_it.end_bip() && m_cb.continue_iteration(f.result)) {
+			m_cb.step_iteration(f.bip_it, f.bip);
+			f.bip_it.next_first_set(f.subset, f.bip);
+			m_cb.left_subcall();
+			f.stage = frame_stage::left;
+			result_type left_result{};
+			if (start_call(f.subset, f.leaves, f.c_occ, 0, left_result)) {
+				deliver(left_result);
+			}
+		} else {
+			m_cb.finish_iteration();
+			finish_call(f.result);
+		}
+		break;
+	case frame_stage::left:
+	case frame_stage::right:
+		assert(false && "Subcall frames must be on top of the stack");
+		break;
+	}
+	return !m_finished;
+}
+
+} // namespace terraces
+
+#endif // SUPERTREE_ENUMERATOR_ITERATIVE_HPP
@@ -0,0 +1,341 @@
+#ifndef SUPERTREE_ENUMERATOR_PARALLEL_HPP
+#define SUPERTREE_ENUMERATOR_PARALLEL_HPP
+
+#include <algorithm>
+
+#include "supertree_enumerator.hpp"
+#include "work_stealing.hpp"
+
+namespace terraces {
+
+/**
+ * A multithreaded version of \ref tree_enumerator.
+ * Every worker owns a \ref tree_enumerator (and thus its own free lists and callback copy)
+ * that is used for subproblems with less than \p min_parallel_leaves leaves.
+ * Limits stored in the callback, like the cache size of \ref variants::memoization_decorator,
+ * therefore apply to every worker separately.
+ * For larger subproblems, the bipartition loop and the right subcalls are forked onto a
+ * \ref parallel::work_stealing_pool.
+ * The bipartition ranges are always split at the same points and the partial results are
+ * reduced in bipartition order, so the result does not depend on the thread scheduling.
+ * It should only be used with callbacks whose result does not depend on the order in which the
+ * callback methods are called, e.g. \ref variants::count_callback or \ref variants::check_callback.
+ */
+template <typename Callback>
+class parallel_tree_enumerator {
+	using result_type = typename Callback::result_type;
+
+private:
+	class subcall_task;
+	class range_task;
+
+	std::vector<tree_enumerator<Callback>> m_workers;
+	parallel::work_stealing_pool m_pool;
+	index_t m_min_parallel_leaves;
+
+	const constraints* m_constraints;
+
+	void init(index_t num_leaves, const constraints& constraints);
+	result_type run(index_t worker, const ranked_bitvector& leaves,
+	                const ranked_bitvector& parent_leaves, const bitvector& constraint_occ);
+	result_type iterate(index_t worker, const bipartitions& bip_it,
+	                    const bitvector& new_constraint_occ);
+	result_type iterate_range(index_t worker, const bipartitions& bip_it,
+	                          const bitvector& new_constraint_occ, index_t first, index_t last);
+	result_type subcalls(index_t worker, const bipartitions& bip_it,
+	                     const bitvector& new_constraint_occ, index_t bip);
+	result_type right_subcall(index_t worker, const ranked_bitvector& leaves,
+	                          const ranked_bitvector& parent_leaves,
+	                          const bitvector& constraint_occ);
+
+public:
+	parallel_tree_enumerator(Callback cb, index_t num_threads,
+	                         index_t min_parallel_leaves = 32);
+	result_type run(index_t num_leaves, const constraints& constraints, index_t root_leaf);
+	result_type run(index_t num_leaves, const constraints& constraints);
+	/** Returns the number of workers (including the calling thread). */
+	index_t num_workers() const { return m_workers.size(); }
+	/** Returns the callback used by the given worker. */
+	const Callback& callback(index_t worker = 0) const { return m_workers[worker].callback(); }
+	/** Returns the maximal amount of temporary memory used by the last run, summed over all
+	 * workers, in bytes. */
+	std::size_t peak_scratch_bytes() const {
+		std::size_t result = 0;
+		for (auto& worker : m_workers) {
+			result += worker.peak_scratch_bytes();
+		}
+		return result;
+	}
+};
+
+/**
+ * The inputs of a task live in the arena of the worker that forked it.
+ * If the task is stolen, they are copied into the arena of the executing worker first,
+ * so every worker only ever allocates from and releases to its own arena.
+ */
+template <typename Callback>
+class parallel_tree_enumerator<Callback>::subcall_task : public parallel::task {
+private:
+	parallel_tree_enumerator<Callback>& m_enumerator;
+	index_t m_worker;
+	const ranked_bitvector& m_leaves;
+	const ranked_bitvector& m_parent_leaves;
+	const bitvector& m_constraint_occ;
+
+public:
+	result_type result;
+
+	subcall_task(parallel_tree_enumerator<Callback>& enumerator, index_t worker,
+	             const ranked_bitvector& leaves, const ranked_bitvector& parent_leaves,
+	             const bitvector& constraint_occ)
+	        : m_enumerator(enumerator), m_worker{worker}, m_leaves(leaves),
+	          m_parent_leaves(parent_leaves), m_constraint_occ(constraint_occ) {}
+
+	void execute(index_t worker) override {
+		if (worker == m_worker) {
+			result = m_enumerator.right_subcall(worker, m_leaves, m_parent_leaves,
+			                                    m_constraint_occ);
+			return;
+		}
+		auto& e = m_enumerator.m_workers[worker];
+		utils::arena_scope scope{e.m_arena};
+		ranked_bitvector leaves{m_leaves, e.leaf_allocator()};
+		ranked_bitvector parent_leaves{m_parent_leaves, e.leaf_allocator()};
+		bitvector constraint_occ{m_constraint_occ, e.c_occ_allocator()};
+		result = m_enumerator.right_subcall(worker, leaves, parent_leaves, constraint_occ);
+	}
+};
+
+/** A range of bipartitions, see \ref subcall_task for the handling of stolen tasks. */
+template <typename Callback>
+class parallel_tree_enumerator<Callback>::range_task : public parallel::task {
+private:
+	parallel_tree_enumerator<Callback>& m_enumerator;
+	index_t m_worker;
+	const bipartitions& m_bip_it;
+	const bitvector& m_constraint_occ;
+	index_t m_first;
+	index_t m_last;
+
+public:
+	result_type result;
+
+	range_task(parallel_tree_enumerator<Callback>& enumerator, index_t worker,
+	           const bipartitions& bip_it, const bitvector& constraint_occ, index_t first,
+	           index_t last)
+	        : m_enumerator(enumerator), m_worker{worker}, m_bip_it(bip_it),
+	          m_constraint_occ(constraint_occ), m_first{first}, m_last{last} {}
+
+	void execute(index_t worker) override {
+		if (worker == m_worker) {
+			result = m_enumerator.iterate_range(worker, m_bip_it, m_constraint_occ,
+			                                    m_first, m_last);
+			return;
+		}
+		auto& e = m_enumerator.m_workers[worker];
+		utils::arena_scope scope{e.m_arena};
+		ranked_bitvector leaves{m_bip_it.leaves(), e.leaf_allocator()};
+		union_find sets{m_bip_it.sets(), e.union_find_allocator()};
+		// rebuilding the bipartitions from the same sets preserves their order
+		bipartitions bip_it{leaves, sets, e.leaf_allocator()};
+		bitvector constraint_occ{m_constraint_occ, e.c_occ_allocator()};
+		result = m_enumerator.iterate_range(worker, bip_it, constraint_occ, m_first,
+		                                    m_last);
+	}
+};
+
+template <typename Callback>
+parallel_tree_enumerator<Callback>::parallel_tree_enumerator(Callback cb, index_t num_threads,
+                                                             index_t min_parallel_leaves)
+        : m_pool{std::max<index_t>(num_threads, 1)},
+          m_min_parallel_leaves{std::max<index_t>(min_parallel_leaves, 3)},
+          m_constraints{nullptr} {
+	// reserve beforehand, since tree_enumerator is not nothrow-movable for every callback
+	m_workers.reserve(m_pool.num_workers());
+	for (index_t i = 0; i < m_pool.num_workers(); ++i) {
+		m_workers.emplace_back(cb);
+	}
+}
+
+template <typename Callback>
+void parallel_tree_enumerator<Callback>::init(index_t num_leaves, const constraints& constraints) {
+	m_constraints = &constraints;
+	m_workers[0].init_constraints(num_leaves, constraints);
+	for (auto& worker : m_workers) {
+		worker.init_freelists(num_leaves, constraints.size());
+		worker.m_constraints = &constraints;
+		worker.m_constraint_index = m_workers[0].m_constraint_index;
+		worker.m_constraint_table = m_workers[0].m_constraint_table;
+		worker.m_union_find_scratch = rollback_union_find{num_leaves};
+	}
+}
+
+template <typename Callback>
+auto parallel_tree_enumerator<Callback>::run(index_t num_leaves, const constraints& constraints)
+        -> result_type {
+	init(num_leaves, constraints);
+	result_type result{};
+	m_pool.run([&]() {
+		auto& e = m_workers[0];
+		auto leaves = full_ranked_set(num_leaves, e.leaf_allocator());
+		auto c_occ = full_set(constraints.size(), e.c_occ_allocator());
+		result = run(0, leaves, leaves, c_occ);
+	});
+	return result;
+}
+
+template <typename Callback>
+auto parallel_tree_enumerator<Callback>::run(index_t num_leaves, const constraints& constraints,
+                                             index_t root_leaf) -> result_type {
+	init(num_leaves, constraints);
+	std::vector<bool> root_split(num_leaves);
+	root_split[root_leaf] = true;
+	result_type result{};
+	m_pool.run([&]() {
+		auto& e = m_workers[0];
+		auto leaves = full_ranked_set(num_leaves, e.leaf_allocator());
+		auto c_occ = full_set(constraints.size(), e.c_occ_allocator());
+		e.m_cb.enter(leaves);
+		// no base cases
+		assert(num_leaves > 2);
+		auto sets = union_find::make_bipartition(root_split, e.union_find_allocator());
+		bipartitions bip_it{leaves, sets, e.leaf_allocator()};
+		result = e.m_cb.exit(iterate(0, bip_it, c_occ));
+	});
+	return result;
+}
+
+template <typename Callback>
+auto parallel_tree_enumerator<Callback>::run(index_t worker, const ranked_bitvector& leaves,
+                                             const ranked_bitvector& parent_leaves,
+                                             const bitvector& constraint_occ) -> result_type {
+	auto& e = m_workers[worker];
+	// small subproblems are not worth the synchronization overhead
+	if (leaves.count() < m_min_parallel_leaves) {
+		return e.run(leaves, parent_leaves, constraint_occ);
+	}
+	// all temporary data of this call is released when it returns
+	utils::arena_scope scope{e.m_arena};
+	e.m_cb.enter(leaves);
+	if (e.m_cb.has_memoized(leaves)) {
+		return e.m_cb.exit(e.m_cb.memoized_value(leaves));
+	}
+
+	bitvector new_constraint_occ =
+	        filter_constraints(parent_leaves, leaves, constraint_occ, e.m_constraint_table,
+	                           e.m_constraint_index, e.c_occ_allocator());
+	// base case: no constraints left
+	if (new_constraint_occ.empty()) {
+		return e.m_cb.exit(e.m_cb.base_unconstrained(leaves));
+	}
+
+	if (e.m_cb.separate_free_leaves()) {
+		auto constrained = constrained_leaves(leaves, new_constraint_occ, *m_constraints,
+		                                      e.leaf_allocator());
+		auto num_free = leaves.count() - constrained.count();
+		if (num_free > 0) {
+			auto result = run(worker, constrained, leaves, new_constraint_occ);
+			return e.m_cb.exit(
+			        e.m_cb.add_free_leaves(result, constrained.count(), num_free));
+		}
+	}
+
+	union_find sets = apply_constraints(leaves, new_constraint_occ, e.m_constraint_table,
+	                                    e.m_union_find_scratch, e.union_find_allocator());
+	bipartitions bip_it(leaves, sets, e.leaf_allocator());
+
+	return e.m_cb.exit(e.m_cb.memoize(leaves, iterate(worker, bip_it, new_constraint_occ)));
+}
+
+template <typename Callback>
+auto parallel_tree_enumerator<Callback>::iterate(index_t worker, const bipartitions& bip_it,
+                                                 const bitvector& new_constraint_occ)
+        -> result_type {
+	auto& cb = m_workers[worker].m_cb;
+	if (cb.fast_return(bip_it)) {
+		return cb.fast_return_value(bip_it);
+	}
+
+	auto result = cb.begin_iteration(bip_it, new_constraint_occ, *m_constraints);
+	if (bip_it.num_bip() > 0 && cb.continue_iteration(result)) {
+		result = cb.accumulate(result, iterate_range(worker, bip_it, new_constraint_occ,
+		                                             bip_it.begin_bip(), bip_it.end_bip()));
+	}
+	cb.finish_iteration();
+
+	return result;
+}
+
+template <typename Callback>
+auto parallel_tree_enumerator<Callback>::iterate_range(index_t worker, const bipartitions& bip_it,
+                                                       const bitvector& new_constraint_occ,
+                                                       index_t first, index_t last)
+        -> result_type {
+	assert(first < last);
+	if (last - first == 1) {
+		return subcalls(worker, bip_it, new_constraint_occ, first);
+	}
+	auto mid = first + (last - first) / 2;
+	range_task upper{*this, worker, bip_it, new_constraint_occ, mid, last};
+	m_pool.fork(worker, upper);
+	result_type lower;
+	try {
+		lower = iterate_range(worker, bip_it, new_constraint_occ, first, mid);
+	} catch (...) {
+		// upper references our stack frame, so we need to wait for it
+		m_pool.join(worker, upper);
+		throw;
+	}
+	m_pool.join(worker, upper);
+	upper.rethrow_if_failed();
+	auto& cb = m_workers[worker].m_cb;
+	if (!cb.continue_iteration(lower)) {
+		return lower;
+	}
+	return cb.accumulate(lower, upper.result);
+}
+
+template <typename Callback>
+auto parallel_tree_enumerator<Callback>::subcalls(index_t worker, const bipartitions& bip_it,
+                                                  const bitvector& new_constraint_occ,
+                                                  index_t bip) -> result_type {
+	auto& e = m_workers[worker];
+	utils::arena_scope scope{e.m_arena};
+	e.m_cb.step_iteration(bip_it, bip);
+	auto sets = bip_it.get_both_sets(bip, e.leaf_allocator());
+	if (sets.second.count() < m_min_parallel_leaves) {
+		e.m_cb.left_subcall();
+		auto left_result = run(worker, sets.first, bip_it.leaves(), new_constraint_occ);
+		auto right_result =
+		        right_subcall(worker, sets.second, bip_it.leaves(), new_constraint_occ);
+		return e.m_cb.combine(left_result, right_result);
+	}
+	subcall_task right{*this, worker, sets.second, bip_it.leaves(), new_constraint_occ};
+	m_pool.fork(worker, right);
+	e.m_cb.left_subcall();
+	result_type left_result;
+	try {
+		left_result = run(worker, sets.first, bip_it.leaves(), new_constraint_occ);
+	} catch (...) {
+		// right references our stack frame, so we need to wait for it
+		m_pool.join(worker, right);
+		throw;
+	}
+	m_pool.join(worker, right);
+	right.rethrow_if_failed();
+	return e.m_cb.combine(left_result, right.result);
+}
+
+template <typename Callback>
+auto parallel_tree_enumerator<Callback>::right_subcall(index_t worker,
+                                                       const ranked_bitvector& leaves,
+                                                       const ranked_bitvector& parent_leaves,
+                                                       const bitvector& constraint_occ)
+        -> result_type {
+	m_workers[worker].m_cb.right_subcall();
+	return run(worker, leaves, parent_leaves, constraint_occ);
+}
+
+} // namespace terraces
+
+#endif // SUPERTREE_ENUMERATOR_PARALLEL_HPP
@@ -1,8 +1,45 @@
 #include "supertree_helpers.hpp"
 #include "trees_impl.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 
 namespace terraces {
 
+leaf_constraint_index::leaf_constraint_index(index_t num_leaves, const constraints& c)
+        : m_offsets(num_leaves + 1), m_constraints(3 * c.size()) {
+	for (auto& cons : c) {
+		++m_offsets[cons.left + 1];
+		++m_offsets[cons.shared + 1];
+		++m_offsets[cons.right + 1];
+	}
+	for (index_t i = 0; i < num_leaves; ++i) {
+		m_offsets[i + 1] += m_offsets[i];
+	}
+	std::vector<index_t> pos(m_offsets.begin(), m_offsets.end() - 1);
+	for (index_t c_i = 0; c_i < c.size(); ++c_i) {
+		m_constraints[pos[c[c_i].left]++] = c_i;
+		m_constraints[pos[c[c_i].shared]++] = c_i;
+		m_constraints[pos[c[c_i].right]++] = c_i;
+	}
+}
+
+std::size_t initial_arena_bytes(index_t num_leaves, index_t num_constraints) {
+	// small bitvectors are stored inline, so only the large ones use the arena
+	auto allocated_words = [](index_t size) {
+		auto words = bitvector::alloc_size(size);
+		return words > bitvector::inline_blocks ? words : 0;
+	};
+	// per recursion level: a union-find structure, a few (ranked) leaf sets
+	// and the filtered constraints
+	const auto level_words = num_leaves + 8 * allocated_words(num_leaves) +
+	                         2 * allocated_words(num_constraints);
+	const index_t levels = 16;
+	return levels * level_words * sizeof(index_t);
+}
+
 bitvector filter_constraints(const ranked_bitvector& leaves, const bitvector& c_occ,
                              const constraints& c, utils::stack_allocator<index_t> a) {
 	bitvector result{c_occ.size(), a};
@@ -15,6 +52,117 @@ bitvector filter_constraints(const ranked_bitvector& leaves, const bitvector& c_
 	return result;
 }
 
+namespace {
+
+inline index_t contains_leaf(const ranked_bitvector& leaves, std::uint32_t leaf) {
+	return (leaves.block(bits::block_index(leaf)) >> bits::shift_index(leaf)) & 1;
+}
+
+} // anonymous namespace
+
+constraint_table::constraint_table(index_t num_leaves, const constraints& c)
+        : m_left(c.size()), m_shared(c.size()), m_right(c.size()) {
+	utils::ensure<std::invalid_argument>(
+	        num_leaves <= std::numeric_limits<std::uint32_t>::max(),
+	        "too many leaves for a constraint table");
+	for (index_t i = 0; i < c.size(); ++i) {
+		assert(c[i].left < num_leaves && c[i].shared < num_leaves &&
+		       c[i].right < num_leaves);
+		m_left[i] = static_cast<std::uint32_t>(c[i].left);
+		m_shared[i] = static_cast<std::uint32_t>(c[i].shared);
+		m_right[i] = static_cast<std::uint32_t>(c[i].right);
+	}
+}
+
+bitvector filter_constraints(const ranked_bitvector& leaves, const bitvector& c_occ,
+                             const constraint_table& table, utils::stack_allocator<index_t> a) {
+	assert(c_occ.size() == table.size());
+	bitvector result{c_occ.size(), a};
+	const auto left = table.left();
+	const auto shared = table.shared();
+	const auto right = table.right();
+	for (index_t b = 0; b < c_occ.num_blocks(); ++b) {
+		const auto base = bits::base_index(b);
+		// mask out the sentinel bit
+		auto occ = c_occ.block(b);
+		if (base + bits::word_bits > c_occ.size()) {
+			occ &= bits::prefix_mask(c_occ.size() - base);
+		}
+		if (occ == 0) {
+			continue;
+		}
+		index_t survivors = 0;
+		if (bits::popcount(occ) * 4 >= bits::word_bits) {
+			// dense block: test every constraint without branches
+			const auto end = std::min(bits::word_bits, c_occ.size() - base);
+			for (index_t j = 0; j < end; ++j) {
+				const auto c_i = base + j;
+				survivors |= (contains_leaf(leaves, left[c_i]) &
+				              contains_leaf(leaves, shared[c_i]) &
+				              contains_leaf(leaves, right[c_i]))
+				             << j;
+			}
+			survivors &= occ;
+		} else {
+			for (; occ != 0; occ &= occ - 1) {
+				const auto j = bits::bitscan(occ);
+				const auto c_i = base + j;
+				survivors |= (contains_leaf(leaves, left[c_i]) &
+				              contains_leaf(leaves, shared[c_i]) &
+				              contains_leaf(leaves, right[c_i]))
+				             << j;
+			}
+		}
+		result.set_block(b, result.block(b) | survivors);
+	}
+	return result;
+}
+
+bitvector filter_constraints(const ranked_bitvector& parent_leaves, const ranked_bitvector& leaves,
+                             const bitvector& c_occ, const constraint_table& c,
+                             const leaf_constraint_index& index,
+                             utils::stack_allocator<index_t> a) {
+	assert(parent_leaves.size() == leaves.size());
+	// count the constraints touched by removed leaves
+	index_t work = 0;
+	for (index_t b = 0; b < leaves.num_blocks(); ++b) {
+		for (auto removed = parent_leaves.block(b) & ~leaves.block(b); removed != 0;
+		     removed &= removed - 1) {
+			work += index.degree(bits::base_index(b) + bits::bitscan(removed));
+		}
+	}
+	if (work >= c_occ.count()) {
+		return filter_constraints(leaves, c_occ, c, a);
+	}
+	// copy into the given allocator, c_occ may belong to another worker's arena
+	bitvector result{c_occ.size(), a};
+	for (index_t b = 0; b < c_occ.num_blocks(); ++b) {
+		result.set_block(b, c_occ.block(b));
+	}
+	for (index_t b = 0; b < leaves.num_blocks(); ++b) {
+		for (auto removed = parent_leaves.block(b) & ~leaves.block(b); removed != 0;
+		     removed &= removed - 1) {
+			auto leaf = bits::base_index(b) + bits::bitscan(removed);
+			for (auto it = index.begin(leaf); it != index.end(leaf); ++it) {
+				result.clr(*it);
+			}
+		}
+	}
+	return result;
+}
+
+ranked_bitvector constrained_leaves(const ranked_bitvector& leaves, const bitvector& c_occ,
+                                    const constraints& c, utils::stack_allocator<index_t> a) {
+	ranked_bitvector result{leaves.size(), a};
+	for (auto c_i = c_occ.first_set(); c_i < c_occ.last_set(); c_i = c_occ.next_set(c_i)) {
+		result.set(c[c_i].left);
+		result.set(c[c_i].shared);
+		result.set(c[c_i].right);
+	}
+	result.update_ranks();
+	return result;
+}
+
 union_find apply_constraints(const ranked_bitvector& leaves, const bitvector& c_occ,
                              const constraints& c, utils::stack_allocator<index_t> a) {
 	auto sets = union_find(leaves.count(), a);
@@ -26,6 +174,30 @@ union_find apply_constraints(const ranked_bitvector& leaves, const bitvector& c_
 	return sets;
 }
 
+union_find apply_constraints(const ranked_bitvector& leaves, const bitvector& c_occ,
+                             const constraint_table& c, rollback_union_find& scratch,
+                             utils::stack_allocator<index_t> a) {
+	const auto checkpoint = scratch.checkpoint();
+	for (auto c_i = c_occ.first_set(); c_i < c_occ.last_set(); c_i = c_occ.next_set(c_i)) {
+		scratch.merge(c.left()[c_i], c.shared()[c_i]);
+	}
+	// the leaves that were not merged form singletons, so every leaf can be linked
+	// to the rank of its representative directly
+	auto sets = union_find(leaves.count(), a);
+	if (scratch.checkpoint() != checkpoint) {
+		index_t i = 0;
+		for (auto leaf : leaves) {
+			auto rep = scratch.find(leaf);
+			if (rep != leaf) {
+				sets.link_compressed(i, leaves.rank(rep));
+			}
+			++i;
+		}
+		scratch.rollback(checkpoint);
+	}
+	return sets;
+}
+
 constraints map_constraints(const ranked_bitvector& leaves, const constraints& cs) {
 	auto result = cs;
 	for (auto& c : result) {
@@ -1,6 +1,8 @@
 #ifndef SUPERTREE_HELPERS_HPP
 #define SUPERTREE_HELPERS_HPP
 
+#include <cstdint>
+
 #include <terraces/constraints.hpp>
 #include <terraces/trees.hpp>
 
@@ -10,6 +12,60 @@
 
 namespace terraces {
 
+/**
+ * An index mapping every leaf to the constraints it occurs in,
+ * stored in compressed sparse row format.
+ */
+class leaf_constraint_index {
+private:
+	std::vector<index_t> m_offsets;
+	std::vector<index_t> m_constraints;
+
+public:
+	leaf_constraint_index() = default;
+	/** Builds the index for the given constraints on \p num_leaves leaves. */
+	leaf_constraint_index(index_t num_leaves, const constraints& c);
+
+	/** Returns the number of constraints the given leaf occurs in. */
+	index_t degree(index_t leaf) const { return m_offsets[leaf + 1] - m_offsets[leaf]; }
+	/** Returns the first index of a constraint the given leaf occurs in. */
+	const index_t* begin(index_t leaf) const { return m_constraints.data() + m_offsets[leaf]; }
+	/** Returns the end of the constraint indices the given leaf occurs in. */
+	const index_t* end(index_t leaf) const {
+		return m_constraints.data() + m_offsets[leaf + 1];
+	}
+};
+
+/**
+ * A copy of a set of constraints stored as three separate arrays of 32 bit leaf indices,
+ * which allows \ref filter_constraints to test a whole bitvector block of constraints
+ * without loading the unused parts of the \ref constraint structs.
+ */
+class constraint_table {
+private:
+	std::vector<std::uint32_t> m_left;
+	std::vector<std::uint32_t> m_shared;
+	std::vector<std::uint32_t> m_right;
+
+public:
+	constraint_table() = default;
+	/** Copies the given constraints on \p num_leaves leaves into the table. */
+	constraint_table(index_t num_leaves, const constraints& c);
+
+	/** Returns the number of constraints. */
+	index_t size() const { return m_left.size(); }
+	const std::uint32_t* left() const { return m_left.data(); }
+	const std::uint32_t* shared() const { return m_shared.data(); }
+	const std::uint32_t* right() const { return m_right.data(); }
+};
+
+/**
+ * Returns the initial size of the \ref utils::arena used by an enumerator
+ * for the temporary data of the given number of leaves and constraints.
+ * It holds a few recursion levels, larger enumerations grow the arena as needed.
+ */
+std::size_t initial_arena_bytes(index_t num_leaves, index_t num_constraints);
+
 /**
  * Filters the given constraints using the given leaves.
  * \param leaves The leaf set.
@@ -22,6 +78,45 @@ namespace terraces {
 bitvector filter_constraints(const ranked_bitvector& leaves, const bitvector& c_occ,
                              const constraints& c, utils::stack_allocator<index_t> a);
 
+/**
+ * Filters the given constraints using the given leaves,
+ * processing one block of \p c_occ at a time.
+ * \returns The same result as filter_constraints(leaves, c_occ, c, a)
+ *          for the constraints stored in \p table.
+ */
+bitvector filter_constraints(const ranked_bitvector& leaves, const bitvector& c_occ,
+                             const constraint_table& table, utils::stack_allocator<index_t> a);
+
+/**
+ * Filters the given constraints incrementally for a subset of the leaves they were filtered with.
+ * Only the constraints containing leaves from \p parent_leaves that are missing in \p leaves
+ * are inspected, unless scanning \p c_occ is cheaper.
+ * \param parent_leaves The leaf set that was used to filter \p c_occ.
+ * \param leaves The leaf set, a subset of \p parent_leaves.
+ * \param c_occ The set containing all constraint indices that are in the constraint set.
+ * \param c The constraints themselves.
+ * \param index The index mapping leaves to the constraints \p c.
+ * \param a The allocator used to construct the result bitvector.
+ * \returns The same result as filter_constraints(leaves, c_occ, c, a).
+ */
+bitvector filter_constraints(const ranked_bitvector& parent_leaves, const ranked_bitvector& leaves,
+                             const bitvector& c_occ, const constraint_table& c,
+                             const leaf_constraint_index& index,
+                             utils::stack_allocator<index_t> a);
+
+/**
+ * Computes the leaves that occur in at least one of the given constraints.
+ * \param leaves The leaf set.
+ * \param c_occ The indices of all constraints to be considered.
+ *              They must have been filtered with \p leaves
+ *              using \ref filter_constraints.
+ * \param c The constraints themselves.
+ * \param a The allocator used to construct the result.
+ * \returns The subset of \p leaves that occur in any constraint from \p c_occ.
+ */
+ranked_bitvector constrained_leaves(const ranked_bitvector& leaves, const bitvector& c_occ,
+                                    const constraints& c, utils::stack_allocator<index_t> a);
+
 /**
  * Applies the given constraints to the given leaves to
  * \param leaves The leaf set.
@@ -35,6 +130,17 @@ bitvector filter_constraints(const ranked_bitvector& leaves, const bitvector& c_
 union_find apply_constraints(const ranked_bitvector& leaves, const bitvector& c_occ,
                              const constraints& c, utils::stack_allocator<index_t> a);
 
+/**
+ * Applies the given constraints to the given leaves like
+ * apply_constraints(leaves, c_occ, c, a), but merges the sets
+ * in a scratch structure on the original leaf indices that is restored afterwards.
+ * \param scratch A union-find structure on all leaves that contains no merges.
+ *                It is left unchanged when the function returns.
+ */
+union_find apply_constraints(const ranked_bitvector& leaves, const bitvector& c_occ,
+                             const constraint_table& c, rollback_union_find& scratch,
+                             utils::stack_allocator<index_t> a);
+
 } // namespace terraces
 
 #endif // SUPERTREE_HELPERS_HPP
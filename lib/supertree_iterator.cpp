@@ -0,0 +1,227 @@
+#include "supertree_iterator.hpp"
+
+#include <terraces/errors.hpp>
+
+#include "bipartitions.hpp"
+#include "supertree_helpers.hpp"
+#include "utils.hpp"
+
+namespace terraces {
+
+supertree_iterator::supertree_iterator(index_t num_leaves, const constraints& constraints,
+                                       index_t root_leaf)
+        : m_constraint_table{num_leaves, constraints}, m_union_find_scratch{num_leaves},
+          m_fl1_allocsize{ranked_bitvector::alloc_size(num_leaves)},
+          m_fl2_allocsize{ranked_bitvector::alloc_size(constraints.size())},
+          m_fl3_allocsize{num_leaves}, m_tree(2 * num_leaves - 1), m_kinds(m_tree.size()),
+          m_states(m_tree.size()), m_unconstrained_leaves(m_tree.size()),
+          m_unconstrained_choices(m_tree.size()), m_valid{false} {
+	// no base cases
+	assert(num_leaves > 2);
+	std::vector<bool> root_split(num_leaves);
+	root_split[root_leaf] = true;
+	auto leaves = full_ranked_set(num_leaves, leaf_allocator());
+	auto c_occ = full_set(constraints.size(), c_occ_allocator());
+	auto sets = union_find::make_bipartition(root_split, union_find_allocator());
+	m_kinds[0] = node_kind::constrained;
+	m_states[0].reset(
+	        new constrained_state{std::move(leaves), std::move(c_occ), std::move(sets)});
+	m_valid = init_constrained(0);
+}
+
+utils::stack_allocator<index_t> supertree_iterator::leaf_allocator() {
+	return {m_fl1, m_fl1_allocsize};
+}
+
+utils::stack_allocator<index_t> supertree_iterator::c_occ_allocator() {
+	return {m_fl2, m_fl2_allocsize};
+}
+
+utils::stack_allocator<index_t> supertree_iterator::union_find_allocator() {
+	return {m_fl3, m_fl3_allocsize};
+}
+
+bool supertree_iterator::init_subtree(index_t i, const ranked_bitvector& leaves,
+                                      const bitvector& c_occ) {
+	assert(leaves.count() > 0);
+	if (leaves.count() == 1) {
+		m_kinds[i] = node_kind::fixed;
+		m_tree[i].lchild() = none;
+		m_tree[i].rchild() = none;
+		m_tree[i].taxon() = leaves.first_set();
+		return true;
+	}
+	if (leaves.count() == 2) {
+		const auto l = i + 1;
+		const auto r = i + 2;
+		auto fst = leaves.first_set();
+		auto snd = leaves.next_set(fst);
+		m_kinds[i] = node_kind::fixed;
+		m_tree[i].lchild() = l;
+		m_tree[i].rchild() = r;
+		m_tree[i].taxon() = none;
+		m_tree[l] = {i, none, none, fst};
+		m_tree[r] = {i, none, none, snd};
+		return true;
+	}
+	auto new_c_occ = filter_constraints(leaves, c_occ, m_constraint_table, c_occ_allocator());
+	if (new_c_occ.empty()) {
+		init_unconstrained(i, leaves);
+		return true;
+	}
+	auto sets = apply_constraints(leaves, new_c_occ, m_constraint_table, m_union_find_scratch,
+	                              union_find_allocator());
+	m_kinds[i] = node_kind::constrained;
+	m_states[i].reset(new constrained_state{leaves, std::move(new_c_occ), std::move(sets)});
+	return init_constrained(i);
+}
+
+bool supertree_iterator::init_constrained(index_t root) {
+	auto& state = *m_states[root];
+	bipartitions bip_it{state.leaves, state.sets, leaf_allocator()};
+	state.bip = bip_it.begin_bip();
+	state.end_bip = bip_it.end_bip();
+	return find_bipartition(root);
+}
+
+bool supertree_iterator::find_bipartition(index_t root) {
+	auto& state = *m_states[root];
+	// skip bipartitions without compatible subtrees
+	for (; state.bip < state.end_bip; ++state.bip) {
+		if (init_bipartition(root)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool supertree_iterator::init_bipartition(index_t root) {
+	auto& state = *m_states[root];
+	bipartitions bip_it{state.leaves, state.sets, leaf_allocator()};
+	auto sets = bip_it.get_both_sets(state.bip, leaf_allocator());
+	const auto left = root + 1;
+	const auto right = left + (2 * sets.first.count() - 1);
+	m_tree[root].lchild() = left;
+	m_tree[root].rchild() = right;
+	m_tree[root].taxon() = none;
+	m_tree[left].parent() = root;
+	m_tree[right].parent() = root;
+	return init_subtree(left, sets.first, state.c_occ) &&
+	       init_subtree(right, sets.second, state.c_occ);
+}
+
+void supertree_iterator::init_unconstrained(index_t i, const ranked_bitvector& leaves) {
+	utils::ensure<tree_count_overflow_error>(leaves.count() < bits::word_bits,
+	                                         "Huge unconstrained subtree encountered");
+	m_kinds[i] = node_kind::unconstrained;
+	auto& leaf_list = m_unconstrained_leaves[i];
+	leaf_list.clear();
+	for (auto el : leaves) {
+		leaf_list.push_back(el);
+	}
+	m_unconstrained_choices[i] = small_bipartition::full_set(leaves.count());
+	init_subtree_unconstrained(i, leaf_list.data());
+}
+
+bool supertree_iterator::init_subtree_unconstrained(index_t root, const index_t* leaves) {
+	auto init_size = m_init_stack.size();
+	m_init_stack.emplace(root);
+	while (m_init_stack.size() > init_size) {
+		auto i = m_init_stack.top();
+		m_init_stack.pop();
+		const auto& bip = m_unconstrained_choices[i];
+		auto& node = m_tree[i];
+		if (bip.num_leaves() <= 2) {
+			if (bip.num_leaves() == 1) {
+				node.lchild() = none;
+				node.rchild() = none;
+				node.taxon() = leaves[bip.leftmost_leaf()];
+			} else {
+				node.lchild() = i + 1;
+				node.rchild() = i + 2;
+				node.taxon() = none;
+				m_tree[i + 1] = {i, none, none, leaves[bip.leftmost_leaf()]};
+				m_tree[i + 2] = {i, none, none, leaves[bip.rightmost_leaf()]};
+			}
+		} else {
+			const auto lbip = small_bipartition{bip.left_mask()};
+			const auto rbip = small_bipartition{bip.right_mask()};
+			const auto left = i + 1;
+			const auto right = i + 1 + 2 * lbip.num_leaves() - 1;
+			node.lchild() = left;
+			node.rchild() = right;
+			node.taxon() = none;
+			m_unconstrained_choices[left] = lbip;
+			m_unconstrained_choices[right] = rbip;
+			m_tree[left].parent() = i;
+			m_tree[right].parent() = i;
+			m_init_stack.push(left);
+			m_init_stack.push(right);
+		}
+	}
+	return true;
+}
+
+bool supertree_iterator::next(index_t root) {
+	switch (m_kinds[root]) {
+	case node_kind::fixed:
+		return false;
+	case node_kind::unconstrained:
+		return next_unconstrained(root, m_unconstrained_leaves[root].data());
+	case node_kind::constrained: {
+		auto left = m_tree[root].lchild();
+		auto right = m_tree[root].rchild();
+		if (next(left) || (next(right) && reset(left))) {
+			return true;
+		}
+		++m_states[root]->bip;
+		return find_bipartition(root);
+	}
+	default:
+		assert(false && "Unknown node kind");
+		return false;
+	}
+}
+
+bool supertree_iterator::next_unconstrained(index_t root, const index_t* leaves) {
+	auto node = m_tree[root];
+	auto left = node.lchild();
+	auto right = node.rchild();
+	auto& choice = m_unconstrained_choices[root];
+	if (!choice.has_choices()) {
+		return false;
+	}
+	return next_unconstrained(left, leaves) ||
+	       (next_unconstrained(right, leaves) && reset_unconstrained(left, leaves)) ||
+	       (choice.next() && init_subtree_unconstrained(root, leaves));
+}
+
+bool supertree_iterator::reset(index_t root) {
+	switch (m_kinds[root]) {
+	case node_kind::fixed:
+		return true;
+	case node_kind::unconstrained:
+		return reset_unconstrained(root, m_unconstrained_leaves[root].data());
+	case node_kind::constrained:
+		return init_constrained(root);
+	default:
+		assert(false && "Unknown node kind");
+		return false;
+	}
+}
+
+bool supertree_iterator::reset_unconstrained(index_t root, const index_t* leaves) {
+	auto& choice = m_unconstrained_choices[root];
+	if (choice.has_choices()) {
+		choice.reset();
+	}
+	init_subtree_unconstrained(root, leaves);
+	return true;
+}
+
+bool supertree_iterator::next() {
+	m_valid = m_valid && next(0);
+	return m_valid;
+}
+
+} // namespace terraces
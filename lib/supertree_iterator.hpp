@@ -0,0 +1,98 @@
+#ifndef SUPERTREE_ITERATOR_HPP
+#define SUPERTREE_ITERATOR_HPP
+
+#include <memory>
+#include <stack>
+
+#include <terraces/constraints.hpp>
+#include <terraces/trees.hpp>
+
+#include "ranked_bitvector.hpp"
+#include "small_bipartition.hpp"
+#include "stack_allocator.hpp"
+#include "supertree_helpers.hpp"
+#include "union_find.hpp"
+
+namespace terraces {
+
+/**
+ * Enumerates all trees on a terrace directly from the recursion of \ref tree_enumerator
+ * without materializing a multitree first.
+ * Every inner node of the current tree stores the state of its recursive call
+ * (leaf set, constraints and current bipartition), so the memory usage only depends on the
+ * number of leaves and not on the number of trees.
+ * The trees are produced in the same order as by a \ref multitree_iterator
+ * on the result of a \ref variants::multitree_callback.
+ */
+class supertree_iterator {
+private:
+	enum class node_kind { fixed, unconstrained, constrained };
+
+	struct constrained_state {
+		ranked_bitvector leaves;
+		bitvector c_occ;
+		union_find sets;
+		index_t bip;
+		index_t end_bip;
+
+		constrained_state(ranked_bitvector leaves, bitvector c_occ, union_find sets)
+		        : leaves{std::move(leaves)}, c_occ{std::move(c_occ)}, sets{std::move(sets)},
+		          bip{}, end_bip{} {}
+	};
+
+	constraint_table m_constraint_table;
+	rollback_union_find m_union_find_scratch;
+
+	utils::free_list m_fl1;
+	utils::free_list m_fl2;
+	utils::free_list m_fl3;
+	index_t m_fl1_allocsize;
+	index_t m_fl2_allocsize;
+	index_t m_fl3_allocsize;
+
+	terraces::tree m_tree;
+	std::vector<node_kind> m_kinds;
+	std::vector<std::unique_ptr<constrained_state>> m_states;
+	std::vector<std::vector<index_t>> m_unconstrained_leaves;
+	std::vector<small_bipartition> m_unconstrained_choices;
+	std::stack<index_t> m_init_stack;
+	bool m_valid;
+
+	utils::stack_allocator<index_t> leaf_allocator();
+	utils::stack_allocator<index_t> c_occ_allocator();
+	utils::stack_allocator<index_t> union_find_allocator();
+
+	bool init_subtree(index_t root, const ranked_bitvector& leaves, const bitvector& c_occ);
+	bool init_constrained(index_t root);
+	bool init_bipartition(index_t root);
+	bool find_bipartition(index_t root);
+	void init_unconstrained(index_t root, const ranked_bitvector& leaves);
+	bool init_subtree_unconstrained(index_t root, const index_t* leaves);
+
+	bool next(index_t root);
+	bool next_unconstrained(index_t root, const index_t* leaves);
+	bool reset(index_t root);
+	bool reset_unconstrained(index_t root, const index_t* leaves);
+
+public:
+	/**
+	 * Initializes the iterator with the first tree on the terrace.
+	 * \param num_leaves The number of leaves.
+	 * \param constraints The constraints the trees need to satisfy.
+	 * \param root_leaf The leaf that is separated from all others at the root.
+	 */
+	supertree_iterator(index_t num_leaves, const constraints& constraints, index_t root_leaf);
+	/** Returns true if and only if \ref tree is a valid tree, i.e. the terrace is not empty. */
+	bool is_valid() const { return m_valid; }
+	/**
+	 * Advances to the next tree on the terrace.
+	 * \returns false if the previous tree was the last one.
+	 */
+	bool next();
+	/** Returns the current tree. */
+	const terraces::tree& tree() const { return m_tree; }
+};
+
+} // namespace terraces
+
+#endif // SUPERTREE_ITERATOR_HPP
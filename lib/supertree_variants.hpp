@@ -1,7 +1,11 @@
 #ifndef SUPERTREE_VARIANTS_HPP
 #define SUPERTREE_VARIANTS_HPP
 
+#include <cassert>
 #include <chrono>
+#include <cmath>
+#include <limits>
+#include <utility>
 
 #include <terraces/constraints.hpp>
 
@@ -9,6 +13,7 @@
 #include <terraces/clamped_uint.hpp>
 
 #include "bipartitions.hpp"
+#include "subproblem_cache.hpp"
 #include "trees_impl.hpp"
 
 namespace terraces {
@@ -60,6 +65,50 @@ public:
 	/** Returns the result to be returned in case \ref fast_return is true. */
 	Result fast_return_value(const bipartitions&);
 
+	/**
+	 * Called after entering a subcall with at least three leaves to check if the result
+	 * for this leaf set is already known.
+	 * \see memoized_value
+	 * \returns true if and only if we want to skip the subcall.
+	 *          (default: false)
+	 */
+	bool has_memoized(const ranked_bitvector&) { return false; }
+	/** Returns the result to be returned in case \ref has_memoized is true. */
+	Result memoized_value(const ranked_bitvector&) {
+		assert(false && "memoized_value needs to be overridden");
+		return Result{};
+	}
+	/**
+	 * Called with the result of iterating over the bipartitions of a leaf set.
+	 * \returns The result that should be passed to \ref exit. (default: \p val)
+	 */
+	Result memoize(const ranked_bitvector& leaves, Result val) {
+		(void)leaves;
+		return val;
+	}
+
+	/**
+	 * Called after filtering the constraints to check if leaves that do not occur in any
+	 * remaining constraint should be removed before iterating over the bipartitions.
+	 * The result for the remaining leaves is then passed to \ref add_free_leaves.
+	 * \returns true if and only if we want to separate these leaves. (default: false)
+	 */
+	bool separate_free_leaves() { return false; }
+	/**
+	 * Extends the result for a leaf set by leaves that do not occur in any constraint.
+	 * Only called if \ref separate_free_leaves returned true.
+	 * \param val The result for the constrained leaves.
+	 * \param num_constrained The number of constrained leaves.
+	 * \param num_free The number of unconstrained leaves.
+	 * \returns The result for the whole leaf set.
+	 */
+	Result add_free_leaves(Result val, index_t num_constrained, index_t num_free) {
+		(void)num_constrained;
+		(void)num_free;
+		assert(false && "add_free_leaves needs to be overridden");
+		return val;
+	}
+
 	/**
 	 * Called when we begin iterating over the bipartitions.
 	 * \param
@@ -126,6 +175,16 @@ public:
 	// The number of bipartitions gives a lower bound on the number of trees.
 	index_t fast_return_value(const bipartitions& bip_it) { return bip_it.num_bip(); }
 
+	// Unconstrained leaves can be inserted into any edge (or above the root) one after another,
+	// so we don't need to consider them when iterating over the bipartitions.
+	bool separate_free_leaves() { return true; }
+	return_type add_free_leaves(return_type val, index_t num_constrained, index_t num_free) {
+		for (index_t i = num_constrained; i < num_constrained + num_free; ++i) {
+			val *= (2 * i - 1);
+		}
+		return val;
+	}
+
 	// Multiple choices are counted independently
 	return_type accumulate(return_type acc, return_type val) { return acc + val; }
 	// Choices from two the subtrees can be combined in any possible way
@@ -144,6 +203,149 @@ public:
 	bool continue_iteration(return_type result) { return !result.is_clamped(); }
 };
 
+/**
+ * A callback implementation that approximately counts all trees in log-space,
+ * i.e. every result is the natural logarithm of the number of trees.
+ * Results are summed using log-sum-exp and multiplied by adding their logarithms,
+ * so they never overflow and are accurate up to floating-point precision.
+ */
+class approx_count_callback : public abstract_callback<double> {
+public:
+	using return_type = double;
+
+	/** Returns the natural logarithm of the number of unrooted trees with the given leaves. */
+	static double log_unrooted_trees(index_t num_leaves) {
+		if (num_leaves <= 2) {
+			return 0;
+		}
+		// (2n - 3)!! = (2n - 2)! / (2^(n - 1) * (n - 1)!)
+		auto n = double(num_leaves);
+		return std::lgamma(2 * n - 1) - std::lgamma(n) - (n - 1) * std::log(2.0);
+	}
+
+	// only one choice for one or two leaves
+	double base_one_leaf(index_t) { return 0; }
+	double base_two_leaves(index_t, index_t) { return 0; }
+	double base_unconstrained(const ranked_bitvector& leaves) {
+		return log_unrooted_trees(leaves.count());
+	}
+	double null_result() const { return -std::numeric_limits<double>::infinity(); }
+
+	double fast_return_value(const bipartitions& bip_it) {
+		return std::log(double(bip_it.num_bip()));
+	}
+
+	bool separate_free_leaves() { return true; }
+	double add_free_leaves(double val, index_t num_constrained, index_t num_free) {
+		return val + log_unrooted_trees(num_constrained + num_free) -
+		       log_unrooted_trees(num_constrained);
+	}
+
+	// the value-initialized 0 would represent a single tree
+	double begin_iteration(const bipartitions&, const bitvector&, const constraints&) {
+		return null_result();
+	}
+	double accumulate(double acc, double val) {
+		if (acc < val) {
+			std::swap(acc, val);
+		}
+		if (val == null_result()) {
+			return acc;
+		}
+		return acc + std::log1p(std::exp(val - acc));
+	}
+	double combine(double left, double right) { return left + right; }
+};
+
+/** A lower and an upper bound on the number of trees. */
+struct count_interval {
+	big_integer lower;
+	big_integer upper;
+};
+
+/**
+ * A callback implementation that computes guaranteed bounds on the number of trees
+ * while only exploring the recursion up to a given depth.
+ * Below this depth (or after the deadline has passed), every leaf set is bounded
+ * from below by its number of bipartitions, since every bipartition allows at least one tree,
+ * and from above by the number of unrooted trees on its leaves.
+ * The bounds are exact if the recursion is not cut off.
+ */
+class interval_count_callback : public abstract_callback<count_interval> {
+private:
+	index_t m_depth;
+	index_t m_max_depth;
+	std::chrono::system_clock::time_point m_deadline;
+	bool m_deadline_passed;
+	bool m_cut_off;
+
+	static count_interval exact(big_integer value) { return {value, value}; }
+
+public:
+	using return_type = count_interval;
+
+	/**
+	 * Initializes the callback to explore leaf sets up to the given recursion depth
+	 * and stop exploring once the deadline has passed.
+	 */
+	interval_count_callback(index_t max_depth, std::chrono::system_clock::time_point deadline)
+	        : m_depth{0}, m_max_depth{max_depth}, m_deadline{deadline},
+	          m_deadline_passed{false}, m_cut_off{false} {}
+
+	/** Returns true if and only if any part of the recursion was not explored. */
+	bool was_cut_off() const { return m_cut_off; }
+	/** Returns true if and only if the deadline has passed during the enumeration. */
+	bool deadline_passed() const { return m_deadline_passed; }
+
+	void enter(const ranked_bitvector&) { ++m_depth; }
+	count_interval exit(count_interval val) {
+		--m_depth;
+		return val;
+	}
+
+	count_interval base_one_leaf(index_t) { return exact(1); }
+	count_interval base_two_leaves(index_t, index_t) { return exact(1); }
+	count_interval base_unconstrained(const ranked_bitvector& leaves) {
+		return exact(count_unrooted_trees<big_integer>(leaves.count()));
+	}
+	count_interval null_result() const { return exact(0); }
+
+	bool fast_return(const bipartitions&) {
+		if (!m_deadline_passed && std::chrono::system_clock::now() > m_deadline) {
+			m_deadline_passed = true;
+		}
+		if (m_depth >= m_max_depth || m_deadline_passed) {
+			m_cut_off = true;
+		}
+		return m_depth >= m_max_depth || m_deadline_passed;
+	}
+	count_interval fast_return_value(const bipartitions& bip_it) {
+		return {bip_it.num_bip(),
+		        count_unrooted_trees<big_integer>(bip_it.leaves().count())};
+	}
+
+	bool separate_free_leaves() { return true; }
+	count_interval add_free_leaves(count_interval val, index_t num_constrained,
+	                               index_t num_free) {
+		for (index_t i = num_constrained; i < num_constrained + num_free; ++i) {
+			val.lower *= (2 * i - 1);
+			val.upper *= (2 * i - 1);
+		}
+		return val;
+	}
+
+	count_interval accumulate(count_interval acc, const count_interval& val) {
+		acc.lower += val.lower;
+		acc.upper += val.upper;
+		return acc;
+	}
+	count_interval combine(count_interval left, const count_interval& right) {
+		left.lower *= right.lower;
+		left.upper *= right.upper;
+		return left;
+	}
+};
+
 /**
  * A callback implementation that returns a simple lower bound to the number
  * of trees compatible with the given constraints.
@@ -213,6 +415,43 @@ public:
 	bool has_timed_out() const { return m_timed_out; }
 };
 
+/**
+ * A callback decorator that stores the results of subcalls in a \ref subproblem_cache
+ * and reuses them when the same leaf set is encountered again.
+ * This is only correct for callbacks whose result for a leaf set does not depend on
+ * the position of the subcall in the recursion, e.g. \ref count_callback.
+ */
+template <typename Callback>
+class memoization_decorator : public Callback {
+public:
+	using result_type = typename Callback::result_type;
+
+private:
+	subproblem_cache<result_type> m_cache;
+	const result_type* m_hit;
+
+public:
+	template <typename... Args>
+	memoization_decorator(index_t max_cache_bytes, Args&&... args)
+	        : Callback{std::forward<Args>(args)...}, m_cache{max_cache_bytes},
+	          m_hit{nullptr} {}
+
+	bool has_memoized(const ranked_bitvector& leaves) {
+		m_hit = m_cache.find(leaves);
+		return m_hit != nullptr || Callback::has_memoized(leaves);
+	}
+	result_type memoized_value(const ranked_bitvector& leaves) {
+		return m_hit != nullptr ? *m_hit : Callback::memoized_value(leaves);
+	}
+	result_type memoize(const ranked_bitvector& leaves, result_type val) {
+		auto result = Callback::memoize(leaves, val);
+		m_cache.insert(leaves, result);
+		return result;
+	}
+
+	const cache_statistics& statistics() const { return m_cache.statistics(); }
+};
+
 } // namespace variants
 } // namespace terraces
 
@@ -4,17 +4,27 @@
 #include "multitree_impl.hpp"
 #include "supertree_variants.hpp"
 
+#include <algorithm>
 #include <memory>
 #include <stack>
+#include <string>
+#include <vector>
 
 namespace terraces {
 namespace variants {
 
+/**
+ * A callback implementation that builds a multitree representing all trees.
+ * The multitree is a DAG: The result for a leaf set is computed only once
+ * and shared by all inner nodes that use it as a subtree.
+ */
 class multitree_callback : public abstract_callback<multitree_node*> {
 private:
 	friend class memory_limited_multitree_callback;
 	multitree_impl::storage_blocks<multitree_node> m_nodes;
 	multitree_impl::storage_blocks<index_t> m_leaves;
+	multitree_impl::node_table m_shared;
+	multitree_node* m_hit;
 
 	multitree_node* alloc_node() { return m_nodes.get(); }
 
@@ -33,9 +43,18 @@ private:
 protected:
 	void set_node_memory_limit(index_t limit) { m_nodes.set_memory_limit(limit); }
 
+	void set_leaf_memory_limit(index_t limit) { m_leaves.set_memory_limit(limit); }
+
+	void set_spill_directory(const std::string& directory) {
+		m_nodes.set_spill_directory(directory);
+		m_leaves.set_spill_directory(directory);
+	}
+
 public:
 	using return_type = multitree_node*;
 
+	multitree_callback() : m_hit{nullptr} {}
+
 	return_type base_one_leaf(index_t i) {
 		return multitree_impl::make_single_leaf(alloc_node(), i);
 	}
@@ -43,7 +62,10 @@ public:
 		return multitree_impl::make_two_leaves(alloc_node(), i, j);
 	}
 	return_type base_unconstrained(const ranked_bitvector& leaves) {
-		return multitree_impl::make_unconstrained(alloc_node(), alloc_leaves(leaves));
+		auto result =
+		        multitree_impl::make_unconstrained(alloc_node(), alloc_leaves(leaves));
+		m_shared.insert(leaves, result);
+		return result;
 	}
 	return_type null_result() const { return nullptr; }
 
@@ -66,6 +88,43 @@ public:
 		}
 	}
 
+	bool has_memoized(const ranked_bitvector& leaves) {
+		m_hit = m_shared.find(leaves);
+		return m_hit != nullptr;
+	}
+	return_type memoized_value(const ranked_bitvector&) { return m_hit; }
+	return_type memoize(const ranked_bitvector& leaves, return_type val) {
+		m_shared.insert(leaves, val);
+		return val;
+	}
+
+	/**
+	 * Uses a sub-multitree representing all trees on the given leaves,
+	 * e.g. from an earlier enumeration, instead of enumerating them again.
+	 */
+	void reuse(const ranked_bitvector& leaves, multitree_node* node) {
+		m_shared.insert(leaves, node);
+	}
+
+	/** Returns the statistics of the sub-multitree sharing. */
+	const cache_statistics& sharing_statistics() const { return m_shared.statistics(); }
+
+	/** Returns the statistics of the blocks storing the nodes. */
+	multitree_impl::storage_statistics node_statistics() const { return m_nodes.statistics(); }
+
+	/** Returns the statistics of the blocks storing the leaves of unexplored nodes etc. */
+	multitree_impl::storage_statistics leaf_statistics() const {
+		return m_leaves.statistics();
+	}
+
+	/** Returns the size of the nodes and leaves placed in scratch files in bytes. */
+	index_t spilled_size() const { return m_nodes.spilled_size() + m_leaves.spilled_size(); }
+
+	// begin_iteration may have returned an unexplored node that cannot store alternatives
+	bool continue_iteration(return_type acc) {
+		return acc->type == multitree_node_type::alternative_array;
+	}
+
 	return_type accumulate(multitree_node* acc, multitree_node* node) {
 		assert(acc->num_leaves == node->num_leaves);
 		acc->num_trees += node->num_trees;
@@ -79,31 +138,107 @@ public:
 	}
 };
 
+/**
+ * A multitree callback that stops exploring subtrees once the memory limit is hit.
+ * If an iteration is cut short by the limit or by a \ref timeout_decorator,
+ * an unexplored alternative stands for the remaining alternatives,
+ * so the multitree never silently misses any trees.
+ */
 class memory_limited_multitree_callback : public multitree_callback {
 private:
+	struct iteration {
+		multitree_node* node;
+		index_t num_bip;
+		// the position of its leaves in m_iteration_leaves
+		index_t leaves_begin;
+	};
+
 	index_t m_memory_limit;
 	bool m_hit_memory_limit;
+	bool m_spill;
+	std::vector<iteration> m_iterations;
+	std::vector<index_t> m_iteration_leaves;
 
 	bool check_memory_limit() {
-		auto memory = m_leaves.total_size() + m_nodes.total_size();
-		if (memory > m_memory_limit) {
+		if (memory_usage() > m_memory_limit) {
 			m_hit_memory_limit = true;
 		}
 		return m_hit_memory_limit;
 	}
 
 public:
-	memory_limited_multitree_callback(index_t limit)
-	        : m_memory_limit(limit), m_hit_memory_limit{false} {
-		// this is only a rough upper bound, but the number of leaves should be much below
-		// the number of nodes in the multitree.
-		set_node_memory_limit(limit);
+	/**
+	 * If a spill directory is given, nodes and leaves exceeding their share of the memory
+	 * limit are placed in scratch files in this directory, so only the remaining memory
+	 * usage can hit the limit.
+	 */
+	memory_limited_multitree_callback(index_t limit, const std::string& spill_directory = {})
+	        : m_memory_limit(limit), m_hit_memory_limit{false},
+	          m_spill{!spill_directory.empty()} {
+		if (m_spill) {
+			// leave half of the memory for the table of shared sub-multitrees
+			set_node_memory_limit(limit / 4);
+			set_leaf_memory_limit(limit / 4);
+			set_spill_directory(spill_directory);
+		} else {
+			set_node_memory_limit(limit);
+		}
+	}
+
+	/**
+	 * Returns the memory used by the multitree in bytes, i.e. the blocks of nodes and leaves
+	 * in memory and the table of shared sub-multitrees.
+	 */
+	index_t memory_usage() const {
+		return m_nodes.resident_size() + m_leaves.resident_size() + m_shared.total_size();
 	}
 
 	bool fast_return(const bipartitions& bip_it) {
 		return multitree_callback::fast_return(bip_it) || check_memory_limit();
 	}
 
+	return_type begin_iteration(const bipartitions& bip_it, const bitvector& c_occ,
+	                            const constraints& c) {
+		if (!m_spill) {
+			// the alternatives may only use the memory not used by anything else
+			auto other = m_leaves.resident_size() + m_shared.total_size();
+			set_node_memory_limit(m_memory_limit - std::min(m_memory_limit, other));
+		}
+		auto result = multitree_callback::begin_iteration(bip_it, c_occ, c);
+		// the alternatives did not fit into the memory limit
+		if (result->type == multitree_node_type::unexplored) {
+			m_hit_memory_limit = true;
+		}
+		m_iterations.push_back({result, bip_it.num_bip(), m_iteration_leaves.size()});
+		for (auto leaf : bip_it.leaves()) {
+			m_iteration_leaves.push_back(leaf);
+		}
+		return result;
+	}
+
+	void finish_iteration() {
+		multitree_callback::finish_iteration();
+		auto it = m_iterations.back();
+		m_iterations.pop_back();
+		auto node = it.node;
+		if (node->type == multitree_node_type::alternative_array &&
+		    node->alternative_array.num_alternatives() < it.num_bip) {
+			auto size = m_iteration_leaves.size() - it.leaves_begin;
+			auto leaves = m_leaves.get_range(size);
+			std::copy(m_iteration_leaves.data() + it.leaves_begin,
+			          m_iteration_leaves.data() + m_iteration_leaves.size(), leaves);
+			auto& aa = node->alternative_array;
+			if (aa.num_alternatives() == 0) {
+				multitree_impl::make_unexplored(node, {leaves, leaves + size});
+			} else {
+				// there is space for all alternatives, so at least for one more
+				multitree_impl::make_unexplored(aa.end, {leaves, leaves + size});
+				++aa.end;
+			}
+		}
+		m_iteration_leaves.resize(it.leaves_begin);
+	}
+
 	bool continue_iteration(result_type acc) {
 		return multitree_callback::continue_iteration(acc) && !check_memory_limit();
 	}
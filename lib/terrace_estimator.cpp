@@ -0,0 +1,106 @@
+#include "terrace_estimator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "supertree_variants.hpp"
+
+namespace terraces {
+
+namespace {
+double log_unrooted_trees(index_t num_leaves) {
+	return variants::approx_count_callback::log_unrooted_trees(num_leaves);
+}
+} // anonymous namespace
+
+terrace_estimator::terrace_estimator(index_t num_leaves, const constraints& constraints,
+                                     std::uint64_t seed)
+        : m_leaf_allocsize{ranked_bitvector::alloc_size(num_leaves)},
+          m_c_occ_allocsize{ranked_bitvector::alloc_size(constraints.size())},
+          m_num_leaves{num_leaves}, m_constraints{&constraints},
+          m_constraint_index{num_leaves, constraints},
+          m_constraint_table{num_leaves, constraints},
+          m_union_find_scratch{num_leaves}, m_rng{seed} {
+	m_arena.reset(initial_arena_bytes(num_leaves, constraints.size()));
+}
+
+double terrace_estimator::probe(index_t root_leaf) {
+	utils::arena_scope scope{m_arena};
+	assert(m_num_leaves > 2);
+	auto leaves = full_ranked_set(m_num_leaves, leaf_allocator());
+	auto c_occ = full_set(m_constraints->size(), c_occ_allocator());
+	std::vector<bool> root_split(m_num_leaves);
+	root_split[root_leaf] = true;
+	auto sets = union_find::make_bipartition(root_split, union_find_allocator());
+	bipartitions bip_it{leaves, sets, leaf_allocator()};
+	return probe(bip_it, c_occ);
+}
+
+double terrace_estimator::probe(const ranked_bitvector& leaves,
+                                const ranked_bitvector& parent_leaves,
+                                const bitvector& constraint_occ) {
+	utils::arena_scope scope{m_arena};
+	// base cases: only one choice for a few leaves
+	assert(leaves.count() > 0);
+	if (leaves.count() <= 2) {
+		return 0;
+	}
+
+	auto new_constraint_occ =
+	        filter_constraints(parent_leaves, leaves, constraint_occ, m_constraint_table,
+	                           m_constraint_index, c_occ_allocator());
+	// base case: no constraints left
+	if (new_constraint_occ.empty()) {
+		return log_unrooted_trees(leaves.count());
+	}
+
+	// free leaves can be inserted into any edge of the trees on the constrained leaves
+	auto constrained = constrained_leaves(leaves, new_constraint_occ, *m_constraints,
+	                                      leaf_allocator());
+	if (constrained.count() < leaves.count()) {
+		return probe(constrained, leaves, new_constraint_occ) +
+		       log_unrooted_trees(leaves.count()) - log_unrooted_trees(constrained.count());
+	}
+
+	auto sets = apply_constraints(leaves, new_constraint_occ, m_constraint_table,
+	                              m_union_find_scratch, union_find_allocator());
+	bipartitions bip_it{leaves, sets, leaf_allocator()};
+	return probe(bip_it, new_constraint_occ);
+}
+
+double terrace_estimator::probe(const bipartitions& bip_it, const bitvector& constraint_occ) {
+	std::uniform_int_distribution<index_t> choice{bip_it.begin_bip(), bip_it.end_bip() - 1};
+	auto sets = bip_it.get_both_sets(choice(m_rng), leaf_allocator());
+	return std::log(double(bip_it.num_bip())) +
+	       probe(sets.first, bip_it.leaves(), constraint_occ) +
+	       probe(sets.second, bip_it.leaves(), constraint_occ);
+}
+
+estimate_statistics log_estimate_statistics(const std::vector<double>& log_estimates) {
+	assert(!log_estimates.empty());
+	// scale all estimates by the largest one to avoid overflows
+	auto scale = *std::max_element(log_estimates.begin(), log_estimates.end());
+	auto n = double(log_estimates.size());
+	double mean = 0;
+	for (auto log_estimate : log_estimates) {
+		mean += std::exp(log_estimate - scale);
+	}
+	mean /= n;
+	double variance = 0;
+	for (auto log_estimate : log_estimates) {
+		auto diff = std::exp(log_estimate - scale) - mean;
+		variance += diff * diff;
+	}
+	variance = log_estimates.size() > 1 ? variance / (n - 1) : 0;
+	// normal approximation for the distribution of the mean
+	auto half_width = 1.96 * std::sqrt(variance / n);
+	estimate_statistics result;
+	result.log_mean = scale + std::log(mean);
+	result.log_upper = scale + std::log(mean + half_width);
+	result.log_lower = mean > half_width ? scale + std::log(mean - half_width) : 0;
+	result.log_lower = std::max(result.log_lower, 0.0);
+	return result;
+}
+
+} // namespace terraces
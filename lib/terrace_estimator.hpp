@@ -0,0 +1,80 @@
+#ifndef TERRACES_TERRACE_ESTIMATOR_HPP
+#define TERRACES_TERRACE_ESTIMATOR_HPP
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "bipartitions.hpp"
+#include "stack_allocator.hpp"
+#include "supertree_helpers.hpp"
+#include "union_find.hpp"
+
+namespace terraces {
+
+/**
+ * Estimates the number of trees on a terrace using Knuth's random probing.
+ * Every probe follows the recursion of \ref tree_enumerator, but only descends into
+ * a single uniformly chosen bipartition of every leaf set,
+ * multiplying the results from both subsets by the number of bipartitions.
+ * This gives an unbiased estimate of the number of trees.
+ * All results are natural logarithms, since the estimates can exceed the range of double.
+ */
+class terrace_estimator {
+private:
+	utils::arena m_arena;
+	index_t m_leaf_allocsize;
+	index_t m_c_occ_allocsize;
+	index_t m_num_leaves;
+
+	const constraints* m_constraints;
+	leaf_constraint_index m_constraint_index;
+	constraint_table m_constraint_table;
+	rollback_union_find m_union_find_scratch;
+
+	std::mt19937_64 m_rng;
+
+	double probe(const ranked_bitvector& leaves, const ranked_bitvector& parent_leaves,
+	             const bitvector& constraint_occ);
+	double probe(const bipartitions& bip_it, const bitvector& constraint_occ);
+
+	utils::stack_allocator<index_t> leaf_allocator() { return {m_arena, m_leaf_allocsize}; }
+	utils::stack_allocator<index_t> c_occ_allocator() { return {m_arena, m_c_occ_allocsize}; }
+	utils::stack_allocator<index_t> union_find_allocator() {
+		return {m_arena, m_num_leaves};
+	}
+
+public:
+	/**
+	 * Initializes the estimator for the given constraints.
+	 * \param seed The seed for the random choices of the probes.
+	 */
+	terrace_estimator(index_t num_leaves, const constraints& constraints, std::uint64_t seed);
+
+	/**
+	 * Returns the logarithm of a single random estimate for the number of trees
+	 * with the given leaf placed below the root.
+	 */
+	double probe(index_t root_leaf);
+};
+
+/**
+ * The mean of a set of random estimates together with a confidence interval,
+ * all represented by their natural logarithms.
+ */
+struct estimate_statistics {
+	double log_mean;
+	double log_lower;
+	double log_upper;
+};
+
+/**
+ * Computes the mean and a 95% confidence interval of the mean
+ * from the natural logarithms of the estimates.
+ * The lower bound is clamped to 1, since every terrace contains at least one tree.
+ */
+estimate_statistics log_estimate_statistics(const std::vector<double>& log_estimates);
+
+} // namespace terraces
+
+#endif // TERRACES_TERRACE_ESTIMATOR_HPP
@@ -56,6 +56,38 @@ void union_find::merge(index_t x, index_t y) {
 	}
 }
 
+void rollback_union_find::merge(index_t x, index_t y) {
+	auto i = find(x);
+	auto j = find(y);
+	if (i == j) {
+		return;
+	}
+	if (m_rank[i] < m_rank[j]) {
+		std::swap(i, j);
+	}
+	// link the smaller group to the larger one
+	m_log.emplace_back(j, none);
+	m_parent[j] = i;
+	if (m_rank[i] == m_rank[j]) {
+		// rank changes are logged with an offset to distinguish them from parent changes
+		m_log.emplace_back(size() + i, m_rank[i]);
+		++m_rank[i];
+	}
+}
+
+void rollback_union_find::rollback(index_t checkpoint) {
+	assert(checkpoint <= m_log.size());
+	while (m_log.size() > checkpoint) {
+		auto entry = m_log.back();
+		m_log.pop_back();
+		if (entry.first < size()) {
+			m_parent[entry.first] = entry.second;
+		} else {
+			m_rank[entry.first - size()] = entry.second;
+		}
+	}
+}
+
 union_find union_find::make_bipartition(const std::vector<bool>& split,
                                         utils::stack_allocator<index_t> alloc) {
 	union_find result(split.size(), alloc);
@@ -2,6 +2,9 @@
 #define TERRACES_UNION_FIND_HPP
 
 #include <algorithm>
+#include <cassert>
+#include <utility>
+#include <vector>
 
 #include <terraces/trees.hpp>
 
@@ -21,6 +24,13 @@ private:
 
 public:
 	union_find(index_t, utils::stack_allocator<index_t> a);
+	/** Copies a union-find structure into storage obtained from the given allocator. */
+	union_find(const union_find& other, utils::stack_allocator<index_t> a)
+	        : m_parent(other.m_parent, a) {
+#ifndef NDEBUG
+		m_compressed = other.m_compressed;
+#endif // NDEBUG
+	}
 	index_t find(index_t);
 	index_t simple_find(index_t x) const {
 		assert(m_compressed);
@@ -30,11 +40,53 @@ public:
 	void compress();
 	void merge(index_t, index_t);
 	bool is_representative(index_t x) const { return m_parent[x] >= m_parent.size(); }
+	/**
+	 * Links an element directly to a representative without changing its rank.
+	 * Used to build an already compressed structure from a precomputed partition.
+	 */
+	void link_compressed(index_t x, index_t rep) {
+		assert(is_representative(rep) && x != rep);
+		m_parent[x] = rep;
+	}
 
 	static union_find make_bipartition(const std::vector<bool>& split,
 	                                   utils::stack_allocator<index_t> alloc);
 };
 
+/**
+ * A union-find structure without path compression that logs all of its modifications,
+ * so merges can be undone in reverse order.
+ * It can be kept over the whole enumeration and restored after every use
+ * in time proportional to the number of merges, instead of being rebuilt from scratch.
+ */
+class rollback_union_find {
+private:
+	// parent index, or none for representatives
+	std::vector<index_t> m_parent;
+	std::vector<index_t> m_rank;
+	// pairs of (index into m_parent or m_rank, old value)
+	std::vector<std::pair<index_t, index_t>> m_log;
+
+public:
+	rollback_union_find() = default;
+	explicit rollback_union_find(index_t n) : m_parent(n, none), m_rank(n, 0) {}
+
+	index_t size() const { return m_parent.size(); }
+	index_t find(index_t x) const {
+		assert(x < size());
+		while (m_parent[x] != none) {
+			x = m_parent[x];
+		}
+		return x;
+	}
+	/** Merges the sets containing the given elements. */
+	void merge(index_t x, index_t y);
+	/** Returns a marker for the current state that can be restored using \ref rollback. */
+	index_t checkpoint() const { return m_log.size(); }
+	/** Undoes all merges since the given \ref checkpoint. */
+	void rollback(index_t checkpoint);
+};
+
 } // namespace terraces
 
 #endif // TERRACES_UNION_FIND_HPP
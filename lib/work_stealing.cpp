@@ -0,0 +1,104 @@
+#include "work_stealing.hpp"
+
+#include <cassert>
+#include <thread>
+
+namespace terraces {
+namespace parallel {
+
+work_stealing_pool::work_stealing_pool(index_t num_workers) : m_finished{false} {
+	assert(num_workers > 0);
+	for (index_t i = 0; i < num_workers; ++i) {
+		m_queues.emplace_back(new worker_queue{});
+	}
+}
+
+void work_stealing_pool::execute(index_t worker, task& t) {
+	try {
+		t.execute(worker);
+	} catch (...) {
+		t.m_exception = std::current_exception();
+	}
+	t.m_done.store(true, std::memory_order_release);
+}
+
+task* work_stealing_pool::steal(index_t thief) {
+	for (index_t offset = 1; offset < num_workers(); ++offset) {
+		auto& victim = *m_queues[(thief + offset) % num_workers()];
+		std::lock_guard<std::mutex> lock{victim.mutex};
+		if (!victim.tasks.empty()) {
+			auto result = victim.tasks.front();
+			victim.tasks.pop_front();
+			return result;
+		}
+	}
+	return nullptr;
+}
+
+void work_stealing_pool::worker_loop(index_t worker) {
+	while (!m_finished.load(std::memory_order_acquire)) {
+		auto t = steal(worker);
+		if (t != nullptr) {
+			execute(worker, *t);
+		} else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void work_stealing_pool::run(const std::function<void()>& root) {
+	m_finished = false;
+	std::vector<std::thread> threads;
+	for (index_t i = 1; i < num_workers(); ++i) {
+		threads.emplace_back([this, i]() { worker_loop(i); });
+	}
+	std::exception_ptr exception;
+	try {
+		root();
+	} catch (...) {
+		exception = std::current_exception();
+	}
+	m_finished = true;
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	if (exception) {
+		std::rethrow_exception(exception);
+	}
+}
+
+void work_stealing_pool::fork(index_t worker, task& t) {
+	auto& queue = *m_queues[worker];
+	std::lock_guard<std::mutex> lock{queue.mutex};
+	queue.tasks.push_back(&t);
+}
+
+void work_stealing_pool::join(index_t worker, task& t) {
+	bool stolen = true;
+	{
+		auto& queue = *m_queues[worker];
+		std::lock_guard<std::mutex> lock{queue.mutex};
+		// all tasks forked after t have already been joined,
+		// so t is either at the back of our queue or was stolen.
+		if (!queue.tasks.empty() && queue.tasks.back() == &t) {
+			queue.tasks.pop_back();
+			stolen = false;
+		}
+	}
+	if (!stolen) {
+		execute(worker, t);
+		return;
+	}
+	// help the other workers while waiting for the thief to finish
+	while (!t.done()) {
+		auto other = steal(worker);
+		if (other != nullptr) {
+			execute(worker, *other);
+		} else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+} // namespace parallel
+} // namespace terraces
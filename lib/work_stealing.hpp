@@ -0,0 +1,92 @@
+#ifndef TERRACES_WORK_STEALING_HPP
+#define TERRACES_WORK_STEALING_HPP
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <terraces/definitions.hpp>
+
+namespace terraces {
+namespace parallel {
+
+/**
+ * A unit of work that can be forked onto a \ref work_stealing_pool.
+ * Tasks are owned by the frame that forks them, which must join them before returning.
+ */
+class task {
+public:
+	task() : m_done{false} {}
+	virtual ~task() = default;
+	task(const task&) = delete;
+	task& operator=(const task&) = delete;
+
+	/** Executes the task on the given worker. */
+	virtual void execute(index_t worker) = 0;
+
+	/** Returns true if and only if the task has finished executing. */
+	bool done() const { return m_done.load(std::memory_order_acquire); }
+	/** Rethrows the exception that terminated the task, if there was one. */
+	void rethrow_if_failed() const {
+		if (m_exception) {
+			std::rethrow_exception(m_exception);
+		}
+	}
+
+private:
+	friend class work_stealing_pool;
+	std::atomic<bool> m_done;
+	std::exception_ptr m_exception;
+};
+
+/**
+ * A fork-join thread pool where every worker owns a task deque.
+ * Workers push and pop forked tasks at the back of their own deque,
+ * idle workers steal the oldest (and thus largest) tasks from the front of other deques.
+ */
+class work_stealing_pool {
+private:
+	struct worker_queue {
+		std::mutex mutex;
+		std::deque<task*> tasks;
+	};
+
+	std::vector<std::unique_ptr<worker_queue>> m_queues;
+	std::atomic<bool> m_finished;
+
+	void execute(index_t worker, task& t);
+	task* steal(index_t thief);
+	void worker_loop(index_t worker);
+
+public:
+	/** Initializes a pool with the given number of workers (including the calling thread). */
+	explicit work_stealing_pool(index_t num_workers);
+
+	/** Returns the number of workers. */
+	index_t num_workers() const { return m_queues.size(); }
+
+	/**
+	 * Executes the given function as worker 0 on the calling thread,
+	 * while the remaining workers are running on their own threads.
+	 * Exceptions thrown by the function are propagated to the caller.
+	 */
+	void run(const std::function<void()>& root);
+
+	/** Makes a task available for execution by any worker. */
+	void fork(index_t worker, task& t);
+	/**
+	 * Waits until a previously forked task has been executed.
+	 * If it was not stolen yet, it is executed by the calling worker,
+	 * otherwise the worker executes stolen tasks until it is done.
+	 */
+	void join(index_t worker, task& t);
+};
+
+} // namespace parallel
+} // namespace terraces
+
+#endif // TERRACES_WORK_STEALING_HPP
@@ -4,6 +4,8 @@
 #include <terraces/errors.hpp>
 #include <terraces/parser.hpp>
 
+#include <cmath>
+
 namespace terraces {
 namespace tests {
 
@@ -115,12 +117,13 @@ TEST_CASE("advanced_results", "[advanced-api]") {
 	CHECK(fast_count_terrace(d3) > 1);
 	CHECK(count_terrace(d3) == 35);
 	CHECK(count_terrace_bigint(d3).value() == 35);
+	CHECK(approx_count_terrace(d1) == Approx(0));
+	CHECK(approx_count_terrace(d3) == Approx(std::log10(35)));
 	std::stringstream ss;
 	print_terrace_compressed(d3, m3.names, ss);
-	CHECK(ss.str() == "(s5,(s2,((s3,s6),(s1,s4))|(s4,{s1,s3,s6})|((s4,(s3,s6)),s1))|((s3,"
-	                  "s6),{s1,s2,s4})|({s2,s3,s6},(s1,s4))|(s4,{s1,s2,s3,s6})|((s2,s4),{"
-	                  "s1,s3,s6})|((s4,(s3,s6)),(s1,s2))|(((s3,s6),(s2,s4))|(s4,{s2,s3,s6})"
-	                  "|((s4,(s3,s6)),s2),s1))");
+	CHECK(ss.str() == "(s5,(s2,((s3,s6),(s1,s4))|(s4,#1={s1,s3,s6})|(#2=(s4,(s3,s6)),s1))|((s3,"
+	                  "s6),{s1,s2,s4})|(#3={s2,s3,s6},(s1,s4))|(s4,{s1,s2,s3,s6})|((s2,s4),#1#)"
+	                  "|(#2#,(s1,s2))|(((s3,s6),(s2,s4))|(s4,#3#)|(#2#,s2),s1))");
 	ss.str("");
 	print_terrace(d3, m3.names, ss);
 	REQUIRE(ss.str() == "(s5,(s2,((s3,s6),(s1,s4))));\n"
@@ -163,5 +166,51 @@ TEST_CASE("advanced_results", "[advanced-api]") {
 	CHECK(ss.str() == ss2.str());
 }
 
+TEST_CASE("bound_terrace", "[advanced-api]") {
+	auto m = parse_bitmatrix_str(
+	        "6 3\n1 0 0 s1\n1 0 0 s2\n0 0 1 s3\n0 1 1 s4\n1 1 1 s5\n0 1 1 s6");
+	auto t = parse_nwk("((s4, (s3, (s2, (s1, s6)))), s5)", m.indices);
+	auto d = create_supertree_data(t, m.matrix);
+	auto bounds = bound_terrace(d, {});
+	CHECK(bounds.is_exact());
+	CHECK(bounds.lower.value() == 35);
+
+	constraints c = {{0, 1, 3}, {3, 2, 0}, {4, 5, 6}, {6, 3, 4}, {2, 3, 6}, {2, 6, 7}};
+	supertree_data d2{c, 12, 0};
+	auto exact = count_terrace_bigint(d2);
+	std::vector<terrace_bounds> rounds;
+	bounds = bound_terrace(d2, {}, [&](const terrace_bounds& b) {
+		rounds.push_back(b);
+		return true;
+	});
+	CHECK(bounds.is_exact());
+	CHECK(bounds.lower == exact);
+	REQUIRE(!rounds.empty());
+	for (index_t i = 0; i < rounds.size(); ++i) {
+		CHECK(rounds[i].lower.value() <= exact.value());
+		CHECK(rounds[i].upper.value() >= exact.value());
+		CHECK(!rounds[i].is_exact());
+		if (i > 0) {
+			CHECK(rounds[i].lower.value() >= rounds[i - 1].lower.value());
+			CHECK(rounds[i].upper.value() <= rounds[i - 1].upper.value());
+		}
+	}
+	// stop after the first round
+	index_t num_rounds = 0;
+	bounds = bound_terrace(d2, {}, [&](const terrace_bounds&) {
+		++num_rounds;
+		return false;
+	});
+	CHECK(num_rounds == 1);
+	CHECK(bounds.lower == rounds[0].lower);
+	CHECK(bounds.upper == rounds[0].upper);
+	// the time limit interrupts the first round immediately
+	execution_limits limits{};
+	limits.time_limit_seconds = 0;
+	bounds = bound_terrace(d2, limits);
+	CHECK(bounds.lower.value() <= exact.value());
+	CHECK(bounds.upper.value() >= exact.value());
+}
+
 } // namespace tests
 } // namespace terraces
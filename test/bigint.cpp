@@ -0,0 +1,70 @@
+#include <catch.hpp>
+
+#include <terraces/bigint.hpp>
+
+#include <limits>
+
+namespace terraces {
+namespace tests {
+
+#ifdef USE_GMP
+TEST_CASE("big_integer small values", "[big_integer]") {
+	big_integer a{6};
+	big_integer b{7};
+	CHECK((a * b) == big_integer{42});
+	CHECK((a + b) == big_integer{13});
+	CHECK((a * b).is_small());
+	CHECK((a + b).is_small());
+	CHECK((a * b).value() == 42);
+}
+
+TEST_CASE("big_integer overflow", "[big_integer]") {
+	auto max = std::numeric_limits<index_t>::max();
+	mpz_class max_mpz{max};
+	big_integer a{max};
+	auto sum = a + big_integer{1};
+	CHECK(!sum.is_small());
+	CHECK(sum.value() == max_mpz + 1);
+	auto product = a * a;
+	CHECK(!product.is_small());
+	CHECK(product.value() == max_mpz * max_mpz);
+	// mixed operands
+	CHECK((product + a).value() == max_mpz * max_mpz + max_mpz);
+	CHECK((a + product).value() == max_mpz * max_mpz + max_mpz);
+	CHECK((product * big_integer{2}).value() == max_mpz * max_mpz * 2);
+	// equality does not depend on the representation
+	CHECK((sum * big_integer{0}) == big_integer{0});
+	CHECK(sum != a);
+	// copies of spilled values are independent
+	auto copy = sum;
+	copy += big_integer{1};
+	CHECK(sum.value() == max_mpz + 1);
+	CHECK(copy.value() == max_mpz + 2);
+	copy = a;
+	CHECK(copy.is_small());
+	CHECK(copy == a);
+}
+
+TEST_CASE("big_integer division", "[big_integer]") {
+	auto max = std::numeric_limits<index_t>::max();
+	mpz_class max_mpz{max};
+	big_integer a{max};
+	auto product = a * big_integer{1000};
+	CHECK(big_integer{41} / big_integer{6} == big_integer{6});
+	CHECK(big_integer{41} % big_integer{6} == big_integer{5});
+	CHECK(big_integer{41} - big_integer{6} == big_integer{35});
+	CHECK(big_integer{6} < big_integer{41});
+	CHECK(a < product);
+	CHECK(!(product < a));
+	CHECK((product % big_integer{7}).value() == (max_mpz * 1000) % 7);
+	// results that fit into a machine word are stored inline again
+	CHECK((product / big_integer{1000}).is_small());
+	CHECK(product / big_integer{1000} == a);
+	CHECK((product - product).is_small());
+	CHECK((product - a).value() == max_mpz * 999);
+	CHECK(product / a == big_integer{1000});
+}
+#endif // USE_GMP
+
+} // namespace tests
+} // namespace terraces
@@ -44,5 +44,36 @@ TEST_CASE("bipartition1", "[bipartition]") {
 	CHECK(bip_it.num_bip() == 3);
 }
 
+TEST_CASE("bipartition incremental", "[bipartition]") {
+	auto fl = utils::free_list{};
+	auto alloc = utils::stack_allocator<index_t>{fl, ranked_bitvector::alloc_size(200)};
+	auto uf_fl = utils::free_list{};
+	auto uf_alloc = utils::stack_allocator<index_t>{uf_fl, 100};
+	// every other leaf of 200 spread over multiple blocks, grouped into 6 sets
+	ranked_bitvector leaves{200, alloc};
+	for (index_t i = 0; i < 200; i += 2) {
+		leaves.set(i);
+	}
+	leaves.update_ranks();
+	union_find u(100, uf_alloc);
+	for (index_t i = 6; i < 100; ++i) {
+		u.merge(i, i % 6);
+	}
+	u.compress();
+	bipartitions bip_it(leaves, u, alloc);
+	CHECK(bip_it.end_bip() == 32);
+	auto set = bip_it.get_first_set(0, alloc);
+	CHECK(set.count() == 0);
+	for (auto bip = bip_it.begin_bip(); bip < bip_it.end_bip(); ++bip) {
+		bip_it.next_first_set(set, bip);
+		auto expected = bip_it.get_first_set(bip, alloc);
+		CHECK(set == expected);
+		CHECK(set.count() == expected.count());
+		for (index_t i = 0; i <= 200; i += 10) {
+			CHECK(set.rank(i) == expected.rank(i));
+		}
+	}
+}
+
 } // namespace tests
 } // namespace terraces
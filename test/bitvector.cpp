@@ -114,5 +114,53 @@ TEST_CASE("efficient bitvector xor", "[bitvector]") {
 	CHECK(b.count() == 0);
 }
 
+TEST_CASE("bitvector inline and allocated storage", "[bitvector]") {
+	for (index_t size : {10, 511, 512, 1000}) {
+		utils::free_list fl;
+		utils::stack_allocator<index_t> alloc{fl, ranked_bitvector::alloc_size(size)};
+		ranked_bitvector b{size, alloc};
+		b.set(0);
+		b.set(size - 1);
+		b.update_ranks();
+		auto copy = b;
+		CHECK(copy == b);
+		auto moved = std::move(copy);
+		CHECK(moved == b);
+		CHECK(moved.count() == 2);
+		copy = moved;
+		copy.flip(size / 2);
+		CHECK(copy != b);
+		copy = std::move(moved);
+		copy.update_ranks();
+		CHECK(copy == b);
+		CHECK(copy.rank(size - 1) == 1);
+		CHECK(copy.first_set() == 0);
+		CHECK(copy.next_set(0) == size - 1);
+		CHECK(copy.next_set(size - 1) == size);
+	}
+}
+
+TEST_CASE("bitvector copy with allocator", "[bitvector]") {
+	for (index_t size : {10, 1000}) {
+		utils::arena a1;
+		utils::arena a2;
+		a1.reset(1024);
+		a2.reset(1024);
+		utils::stack_allocator<index_t> alloc1{a1, ranked_bitvector::alloc_size(size)};
+		utils::stack_allocator<index_t> alloc2{a2, ranked_bitvector::alloc_size(size)};
+		ranked_bitvector b{size, alloc1};
+		b.set(1);
+		b.set(size - 1);
+		b.update_ranks();
+		auto used = a1.used_bytes();
+		ranked_bitvector copy{b, alloc2};
+		CHECK(a1.used_bytes() == used);
+		CHECK(copy.get_allocator() == alloc2);
+		CHECK(copy == b);
+		CHECK(copy.count() == 2);
+		CHECK(copy.rank(size - 1) == 1);
+	}
+}
+
 } // namespace tests
 } // namespace terraces
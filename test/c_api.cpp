@@ -185,6 +185,8 @@ TEST_CASE("c_api_error_flag_conflict", "[c-api]") {
 	        TERRACE_FLAG_CONFLICT_ERROR);
 	REQUIRE(terraceAnalysis(data, "((s1,s2),s3,s4)", TA_ENUMERATE_COMPRESS, nullptr, result) ==
 	        TERRACE_FLAG_CONFLICT_ERROR);
+	REQUIRE(terraceAnalysis(data, "((s1,s2),s3,s4)", TA_COUNT_APPROX | TA_COUNT, nullptr,
+	                        result) == TERRACE_FLAG_CONFLICT_ERROR);
 	freeMissingData(data);
 }
 
@@ -241,6 +243,9 @@ TEST_CASE("c_api_count_data", "[c-api]") {
 	REQUIRE(terraceAnalysis(data, "((s4, (s3, (s2, (s1, s6)))), s5)", TA_COUNT, nullptr,
 	                        result) == TERRACE_SUCCESS);
 	CHECK(mpz_cmp_ui(result, 35) == 0);
+	REQUIRE(terraceAnalysis(data, "((s4, (s3, (s2, (s1, s6)))), s5)", TA_COUNT_APPROX,
+	                        nullptr, result) == TERRACE_SUCCESS);
+	CHECK(mpz_cmp_ui(result, 35) == 0);
 	freeMissingData(data);
 }
 
@@ -270,10 +275,9 @@ TEST_CASE("c_api_enumerate_compressed_data", "[c-api]") {
 		buffer << s.rdbuf();
 	}
 	std::remove(filename);
-	CHECK(buffer.str() == "(s5,(s2,((s3,s6),(s1,s4))|(s4,{s1,s3,s6})|((s4,(s3,s6)),s1))|((s3,"
-	                      "s6),{s1,s2,s4})|({s2,s3,s6},(s1,s4))|(s4,{s1,s2,s3,s6})|((s2,s4),{"
-	                      "s1,s3,s6})|((s4,(s3,s6)),(s1,s2))|(((s3,s6),(s2,s4))|(s4,{s2,s3,s6})"
-	                      "|((s4,(s3,s6)),s2),s1))");
+	CHECK(buffer.str() == "(s5,(s2,((s3,s6),(s1,s4))|(s4,#1={s1,s3,s6})|(#2=(s4,(s3,s6)),s1))|("
+	                      "(s3,s6),{s1,s2,s4})|(#3={s2,s3,s6},(s1,s4))|(s4,{s1,s2,s3,s6})|((s2,"
+	                      "s4),#1#)|(#2#,(s1,s2))|(((s3,s6),(s2,s4))|(s4,#3#)|(#2#,s2),s1))");
 	freeMissingData(data);
 }
 
@@ -26,6 +26,11 @@ TEST_CASE("overflow_except_uint", "[checked_uint]") {
 	                terraces::tree_count_overflow_error);
 	CHECK_THROWS_AS(overflow_except_uint{max / 2} * overflow_except_uint{3},
 	                terraces::tree_count_overflow_error);
+	CHECK((overflow_except_uint{417} - overflow_except_uint{10}).value() == 417 - 10);
+	CHECK((overflow_except_uint{417} / overflow_except_uint{10}).value() == 41);
+	CHECK((overflow_except_uint{417} % overflow_except_uint{10}).value() == 7);
+	CHECK(overflow_except_uint{10} < overflow_except_uint{417});
+	CHECK(!(overflow_except_uint{417} < overflow_except_uint{417}));
 }
 
 } // namespace tests
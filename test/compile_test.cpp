@@ -1,6 +1,8 @@
 // This file is only used to instantiate some configurations of tree_enumerators
 
 #include "../lib/supertree_enumerator.hpp"
+#include "../lib/supertree_enumerator_iterative.hpp"
+#include "../lib/supertree_enumerator_parallel.hpp"
 #include "../lib/supertree_variants.hpp"
 #include "../lib/supertree_variants_debug.hpp"
 #include "../lib/supertree_variants_multitree.hpp"
@@ -58,4 +60,30 @@ template class tree_enumerator<stack_state_decorator<count_callback<clamped_uint
 template class tree_enumerator<stack_state_decorator<clamped_count_callback>>;
 
 template class tree_enumerator<stack_state_decorator<multitree_callback>>;
+
+template class parallel_tree_enumerator<check_callback>;
+
+#ifdef USE_GMP
+template class parallel_tree_enumerator<count_callback<big_integer>>;
+#endif
+
+template class parallel_tree_enumerator<clamped_count_callback>;
+
+template class parallel_tree_enumerator<timeout_decorator<clamped_count_callback>>;
+
+template class tree_enumerator<memoization_decorator<clamped_count_callback>>;
+
+template class iterative_tree_enumerator<check_callback>;
+
+template class iterative_tree_enumerator<clamped_count_callback>;
+
+template class iterative_tree_enumerator<multitree_callback>;
+
+template class iterative_tree_enumerator<stack_state_decorator<check_callback>>;
+
+template class iterative_tree_enumerator<
+        timeout_decorator<memoization_decorator<clamped_count_callback>>>;
+
+template class parallel_tree_enumerator<
+        timeout_decorator<memoization_decorator<clamped_count_callback>>>;
 } // namespace terraces
@@ -4,7 +4,9 @@
 #include <terraces/subtree_extraction.hpp>
 
 #include <algorithm>
+#include <random>
 
+#include "../lib/supertree_helpers.hpp"
 #include "../lib/trees_impl.hpp"
 
 namespace terraces {
@@ -51,5 +53,170 @@ TEST_CASE("constraint deduplication", "[deduplication], [contraints]") {
 	CHECK(dup == (constraints{{0, 1, 2}, {3, 4, 5}, {6, 7, 8}}));
 }
 
+TEST_CASE("leaf_constraint_index", "[constraints]") {
+	auto c = constraints{{0, 1, 2}, {1, 3, 2}, {4, 0, 1}};
+	leaf_constraint_index index{6, c};
+	CHECK(index.degree(0) == 2);
+	CHECK(index.degree(1) == 3);
+	CHECK(index.degree(2) == 2);
+	CHECK(index.degree(3) == 1);
+	CHECK(index.degree(4) == 1);
+	CHECK(index.degree(5) == 0);
+	CHECK(std::vector<index_t>(index.begin(1), index.end(1)) ==
+	      (std::vector<index_t>{0, 1, 2}));
+	CHECK(std::vector<index_t>(index.begin(2), index.end(2)) == (std::vector<index_t>{0, 1}));
+	CHECK(index.begin(5) == index.end(5));
+}
+
+TEST_CASE("incremental constraint filtering", "[constraints]") {
+	const index_t num_leaves = 40;
+	std::mt19937_64 rng{42};
+	std::uniform_int_distribution<index_t> leaf_dist{0, num_leaves - 1};
+	constraints c;
+	for (index_t i = 0; i < 100; ++i) {
+		c.emplace_back(leaf_dist(rng), leaf_dist(rng), leaf_dist(rng));
+	}
+	leaf_constraint_index index{num_leaves, c};
+	constraint_table table{num_leaves, c};
+	utils::free_list fl_leaves;
+	utils::free_list fl_c_occ;
+	utils::stack_allocator<index_t> leaf_alloc{fl_leaves,
+	                                           ranked_bitvector::alloc_size(num_leaves)};
+	utils::stack_allocator<index_t> c_occ_alloc{fl_c_occ, bitvector::alloc_size(c.size())};
+	std::bernoulli_distribution coin{0.9};
+	auto parent = full_ranked_set(num_leaves, leaf_alloc);
+	auto parent_c_occ = full_set(c.size(), c_occ_alloc);
+	// shrink the leaf set step by step and compare against a full scan
+	while (!parent.empty()) {
+		ranked_bitvector leaves{num_leaves, leaf_alloc};
+		for (auto leaf : parent) {
+			if (coin(rng)) {
+				leaves.set(leaf);
+			}
+		}
+		leaves.update_ranks();
+		auto scanned = filter_constraints(leaves, parent_c_occ, c, c_occ_alloc);
+		auto incremental =
+		        filter_constraints(parent, leaves, parent_c_occ, table, index, c_occ_alloc);
+		CHECK(scanned == incremental);
+		parent = std::move(leaves);
+		parent_c_occ = std::move(incremental);
+	}
+}
+
+TEST_CASE("incremental constraint filtering allocator", "[constraints]") {
+	const index_t num_leaves = 40;
+	std::mt19937_64 rng{3};
+	std::uniform_int_distribution<index_t> leaf_dist{0, num_leaves - 1};
+	constraints c;
+	// too many constraints to be stored inline
+	for (index_t i = 0; i < 600; ++i) {
+		c.emplace_back(leaf_dist(rng), leaf_dist(rng), leaf_dist(rng));
+	}
+	leaf_constraint_index index{num_leaves, c};
+	constraint_table table{num_leaves, c};
+	utils::arena parent_arena;
+	utils::arena child_arena;
+	parent_arena.reset(1024);
+	child_arena.reset(1024);
+	utils::stack_allocator<index_t> leaf_alloc{parent_arena,
+	                                           ranked_bitvector::alloc_size(num_leaves)};
+	utils::stack_allocator<index_t> parent_alloc{parent_arena, bitvector::alloc_size(c.size())};
+	utils::stack_allocator<index_t> child_alloc{child_arena, bitvector::alloc_size(c.size())};
+	auto parent = full_ranked_set(num_leaves, leaf_alloc);
+	auto parent_c_occ = full_set(c.size(), parent_alloc);
+	auto leaves = parent;
+	// removing a single leaf uses the incremental update
+	leaves.clr(0);
+	leaves.update_ranks();
+	auto parent_used = parent_arena.used_bytes();
+	auto result = filter_constraints(parent, leaves, parent_c_occ, table, index, child_alloc);
+	CHECK(result.get_allocator() == child_alloc);
+	CHECK(parent_arena.used_bytes() == parent_used);
+	CHECK(child_arena.used_bytes() > 0);
+	CHECK(result == filter_constraints(leaves, parent_c_occ, c, parent_alloc));
+}
+
+TEST_CASE("blockwise constraint filtering", "[constraints]") {
+	const index_t num_leaves = 70;
+	std::mt19937_64 rng{1};
+	std::uniform_int_distribution<index_t> leaf_dist{0, num_leaves - 1};
+	constraints c;
+	for (index_t i = 0; i < 300; ++i) {
+		c.emplace_back(leaf_dist(rng), leaf_dist(rng), leaf_dist(rng));
+	}
+	constraint_table table{num_leaves, c};
+	CHECK(table.size() == c.size());
+	CHECK(table.shared()[17] == c[17].shared);
+	utils::free_list fl_leaves;
+	utils::free_list fl_c_occ;
+	utils::stack_allocator<index_t> leaf_alloc{fl_leaves,
+	                                           ranked_bitvector::alloc_size(num_leaves)};
+	utils::stack_allocator<index_t> c_occ_alloc{fl_c_occ, bitvector::alloc_size(c.size())};
+	// cover both sparse and dense constraint blocks
+	for (auto density : {0.05, 0.5, 1.0}) {
+		std::bernoulli_distribution occ_coin{density};
+		std::bernoulli_distribution leaf_coin{0.8};
+		for (int rep = 0; rep < 20; ++rep) {
+			ranked_bitvector leaves{num_leaves, leaf_alloc};
+			for (index_t i = 0; i < num_leaves; ++i) {
+				if (leaf_coin(rng)) {
+					leaves.set(i);
+				}
+			}
+			leaves.update_ranks();
+			bitvector c_occ{c.size(), c_occ_alloc};
+			for (index_t i = 0; i < c.size(); ++i) {
+				if (occ_coin(rng)) {
+					c_occ.set(i);
+				}
+			}
+			CHECK(filter_constraints(leaves, c_occ, table, c_occ_alloc) ==
+			      filter_constraints(leaves, c_occ, c, c_occ_alloc));
+		}
+	}
+}
+
+TEST_CASE("apply_constraints with rollback", "[constraints],[union_find]") {
+	const index_t num_leaves = 50;
+	std::mt19937_64 rng{7};
+	std::uniform_int_distribution<index_t> leaf_dist{0, num_leaves - 1};
+	constraints c;
+	for (index_t i = 0; i < 30; ++i) {
+		c.emplace_back(leaf_dist(rng), leaf_dist(rng), leaf_dist(rng));
+	}
+	constraint_table table{num_leaves, c};
+	rollback_union_find scratch{num_leaves};
+	utils::free_list fl_leaves;
+	utils::free_list fl_c_occ;
+	utils::free_list fl_sets;
+	utils::stack_allocator<index_t> leaf_alloc{fl_leaves,
+	                                           ranked_bitvector::alloc_size(num_leaves)};
+	utils::stack_allocator<index_t> c_occ_alloc{fl_c_occ, bitvector::alloc_size(c.size())};
+	utils::stack_allocator<index_t> sets_alloc{fl_sets, num_leaves};
+	std::bernoulli_distribution leaf_coin{0.9};
+	for (int rep = 0; rep < 20; ++rep) {
+		ranked_bitvector leaves{num_leaves, leaf_alloc};
+		for (index_t i = 0; i < num_leaves; ++i) {
+			if (leaf_coin(rng)) {
+				leaves.set(i);
+			}
+		}
+		leaves.update_ranks();
+		auto c_occ =
+		        filter_constraints(leaves, full_set(c.size(), c_occ_alloc), c, c_occ_alloc);
+		auto expected = apply_constraints(leaves, c_occ, c, sets_alloc);
+		auto result = apply_constraints(leaves, c_occ, table, scratch, sets_alloc);
+		REQUIRE(result.size() == expected.size());
+		for (index_t i = 0; i < result.size(); ++i) {
+			for (index_t j = 0; j < result.size(); ++j) {
+				CHECK((result.simple_find(i) == result.simple_find(j)) ==
+				      (expected.simple_find(i) == expected.simple_find(j)));
+			}
+		}
+		CHECK(scratch.checkpoint() == 0);
+	}
+}
+
 } // namespace tests
 } // namespace terraces
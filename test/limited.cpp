@@ -4,51 +4,25 @@
 #include <sstream>
 
 #include <terraces/advanced.hpp>
+#include <terraces/errors.hpp>
 #include <terraces/parser.hpp>
 #include <terraces/rooting.hpp>
 #include <terraces/subtree_extraction.hpp>
 #include <thread>
 
+#include "../lib/multitree_expansion.hpp"
 #include "../lib/multitree_iterator.hpp"
 #include "../lib/supertree_enumerator.hpp"
 #include "../lib/supertree_variants_multitree.hpp"
 #include "../lib/validation.hpp"
+#include "test_data.hpp"
 
 namespace terraces {
 namespace tests {
 
 TEST_CASE("limit-tests", "[supertree],[advanced-api]") {
-	auto magic = 12u;
-	name_map nums{"root"};
-	index_map indx{{"root", 0}};
-	/**
-	 * Construct 12 nested three-taxon trees
-	 * that create many bipartitions in the first recursion step.
-	 */
-	std::stringstream nwk;
-	nwk << "(root,(";
-	for (unsigned i = 0; i < 3 * magic; i += 3) {
-		nums.push_back(std::to_string(i));
-		indx.emplace(nums.back(), i + 1);
-		nums.push_back(std::to_string(i + 1));
-		indx.emplace(nums.back(), i + 2);
-		nums.push_back(std::to_string(i + 2));
-		indx.emplace(nums.back(), i + 3);
-		nwk << "((" << i << ',' << (i + 1) << ")," << (i + 2) << ')';
-		nwk << (i < 3 * (magic - 2) ? ",(" : (i < 3 * (magic - 1) ? "," : ""));
-	}
-	for (unsigned i = 0; i < magic; ++i) {
-		nwk << ')';
-	}
-	auto tree = parse_nwk(nwk.str(), indx);
-	bitmatrix matrix{3 * magic + 1, magic};
-	for (unsigned i = 0; i < 3 * magic; ++i) {
-		matrix.set(i + 1, i / 3, 1);
-	}
-	for (unsigned i = 0; i < magic; ++i) {
-		matrix.set(0, i, 1);
-	}
-	auto d = create_supertree_data(tree, matrix);
+	name_map nums;
+	auto d = nested_three_taxon_data(12, nums);
 	SECTION("time-limit-raw") {
 		using cb = variants::timeout_decorator<variants::count_callback<index_t>>;
 		tree_enumerator<cb> enumerator{cb{1}};
@@ -87,8 +61,14 @@ TEST_CASE("limit-tests", "[supertree],[advanced-api]") {
 			CHECK(result);
 		}
 		SECTION("count-bigint") {
+#ifdef USE_GMP
 			count_terrace_bigint(d, limits, result);
 			CHECK(result);
+#else
+			// without GMP, even the lower bound returned after the time limit overflows
+			CHECK_THROWS_AS(count_terrace_bigint(d, limits, result),
+			                tree_count_overflow_error);
+#endif
 		}
 		SECTION("print") {
 			std::stringstream ss;
@@ -103,5 +83,83 @@ TEST_CASE("limit-tests", "[supertree],[advanced-api]") {
 	}
 }
 
+TEST_CASE("memory-limit-spill", "[supertree],[advanced-api]") {
+	name_map nums;
+	auto d = nested_three_taxon_data(5, nums);
+	auto expected = count_terrace_bigint(d);
+	SECTION("raw") {
+		using cb = variants::memory_limited_multitree_callback;
+		tree_enumerator<cb> enumerator{cb{1 << 20, "."}};
+		auto result = enumerator.run(d.num_leaves, d.constraints, d.root);
+		REQUIRE(!enumerator.callback().has_hit_memory_limit());
+		CHECK(enumerator.callback().spilled_size() > 0);
+		CHECK(result->num_trees == expected);
+	}
+	SECTION("advanced_api") {
+		execution_limits limits{};
+		limits.mem_limit_bytes = 1 << 20;
+		limits.spill_directory = ".";
+		bool terminated_early;
+		std::stringstream ss;
+		CHECK(print_terrace_compressed(d, nums, ss, limits, terminated_early) == expected);
+		CHECK(!terminated_early);
+		limits.spill_directory = "";
+		std::stringstream ss_limited;
+		print_terrace_compressed(d, nums, ss_limited, limits, terminated_early);
+		CHECK(terminated_early);
+	}
+}
+
+TEST_CASE("unexplored-expansion", "[supertree],[advanced-api]") {
+	name_map nums;
+	auto d = nested_three_taxon_data(5, nums);
+	auto expected = count_terrace_bigint(d);
+	using cb = variants::memory_limited_multitree_callback;
+	tree_enumerator<cb> limited{cb{1 << 20}};
+	auto result = limited.run(d.num_leaves, d.constraints, d.root);
+	REQUIRE(limited.callback().has_hit_memory_limit());
+	auto unexplored = unexplored_nodes(result);
+	REQUIRE(!unexplored.empty());
+	CHECK(result->num_trees < expected);
+	tree_enumerator<variants::multitree_callback> enumerator{{}};
+	SECTION("selective") {
+		auto num_trees = result->num_trees;
+		CHECK(expand_unexplored(enumerator, result, d,
+		                        [](const multitree_node&) { return false; }) ==
+		      unexplored.size());
+		CHECK(result->num_trees == num_trees);
+	}
+	SECTION("all") {
+		index_t num_complete = 0;
+		for_each_complete_subtree(result, d.num_leaves,
+		                          [&](const ranked_bitvector&, multitree_node*) {
+			                          ++num_complete;
+		                          });
+		CHECK(num_complete > 0);
+		CHECK(expand_unexplored(enumerator, result, d) == 0);
+		CHECK(result->num_trees == expected);
+		// the complete sub-multitrees were reused
+		CHECK(enumerator.callback().sharing_statistics().hits > 0);
+		multitree_iterator it{result};
+		CHECK(it.tree().size() == 2 * d.num_leaves - 1);
+	}
+	SECTION("advanced_api") {
+		execution_limits limits{};
+		limits.mem_limit_bytes = 1 << 20;
+		bool terminated_early;
+		std::stringstream compressed;
+		print_terrace_compressed(d, nums, compressed, limits, terminated_early);
+		REQUIRE(terminated_early);
+		std::stringstream expanded;
+		CHECK(expand_terrace_compressed(d, nums, compressed, expanded) == expected);
+		// nothing is left to expand
+		std::stringstream expanded_again;
+		CHECK(expand_terrace_compressed(d, nums, expanded, expanded_again, limits,
+		                                terminated_early) == expected);
+		CHECK(!terminated_early);
+		CHECK(expanded_again.str() == expanded.str());
+	}
+}
+
 } // namespace tests
 } // namespace terraces
@@ -0,0 +1,90 @@
+#include <catch.hpp>
+
+#include <terraces/advanced.hpp>
+
+#include "../lib/modular_count.hpp"
+#include "../lib/trees_impl.hpp"
+
+namespace terraces {
+namespace tests {
+
+TEST_CASE("montgomery arithmetic", "[modular_count]") {
+	std::uint64_t p = 1000003;
+	montgomery_modulus mod{p};
+	for (std::uint64_t a : {0u, 1u, 2u, 999999u, 1000002u, 123456789u}) {
+		for (std::uint64_t b : {0u, 1u, 3u, 500000u, 1000002u, 987654321u}) {
+			auto ma = mod.to_montgomery(a);
+			auto mb = mod.to_montgomery(b);
+			CHECK(mod.from_montgomery(ma) == a % p);
+			CHECK(mod.from_montgomery(mod.add(ma, mb)) == (a + b) % p);
+			CHECK(mod.from_montgomery(mod.sub(ma, mb)) == (a % p + p - b % p) % p);
+			CHECK(mod.from_montgomery(mod.mul(ma, mb)) == (a % p) * (b % p) % p);
+		}
+	}
+	// Fermat's little theorem
+	CHECK(mod.from_montgomery(mod.pow(mod.to_montgomery(12345), p - 1)) == 1);
+	// the largest prime below 2^62
+	std::uint64_t q = (std::uint64_t(1) << 62) - 57;
+	montgomery_modulus big_mod{q};
+	auto x = big_mod.to_montgomery(q - 1);
+	CHECK(big_mod.from_montgomery(big_mod.mul(x, x)) == 1);
+	CHECK(big_mod.from_montgomery(big_mod.add(x, x)) == q - 2);
+	CHECK(big_mod.from_montgomery(big_mod.pow(big_mod.to_montgomery(3), q - 1)) == 1);
+}
+
+TEST_CASE("modular_count primes", "[modular_count]") {
+	CHECK(is_prime(3));
+	CHECK(is_prime(1000003));
+	CHECK(is_prime((std::uint64_t(1) << 61) - 1));
+	CHECK(!is_prime(1000001));
+	// strong pseudoprime to the bases 2, 3, 5 and 7
+	CHECK(!is_prime(3215031751u));
+	auto primes = modular_count_primes(3);
+	REQUIRE(primes.size() == 3);
+	CHECK(primes[0] == (std::uint64_t(1) << 62) - 57);
+	CHECK(primes[1] == (std::uint64_t(1) << 62) - 87);
+	CHECK(primes[2] == (std::uint64_t(1) << 62) - 117);
+	CHECK(modular_count_num_primes(3) == 1);
+	// 31!! < 2^61 < 33!!
+	CHECK(modular_count_num_primes(17) == 1);
+	CHECK(modular_count_num_primes(18) == 2);
+	// 397!! has 1433 bits
+	CHECK(modular_count_num_primes(200) == 24);
+}
+
+TEST_CASE("crt_reconstruct", "[modular_count]") {
+	auto primes = modular_count_primes(2);
+	std::uint64_t x = 123456789012345ull;
+	CHECK(crt_reconstruct({x % primes[0], x % primes[1]}, primes) == big_integer{x});
+	CHECK(crt_reconstruct({0, 0}, primes) == big_integer{0});
+#ifdef USE_GMP
+	// x = 5 * p_0 + 7
+	mpz_class expected = mpz_class{primes[0]} * 5 + 7;
+	auto p1 = primes[1];
+	auto residue = ((primes[0] % p1) * 5 + 7) % p1;
+	CHECK(crt_reconstruct({7, residue}, primes).value() == expected);
+#endif // USE_GMP
+}
+
+TEST_CASE("count_terrace_modular", "[modular_count],[advanced-api]") {
+	supertree_data data{{{0, 1, 2}, {3, 4, 5}, {0, 3, 6}}, 8, 0};
+	CHECK(count_terrace_modular(data) == count_terrace_bigint(data));
+	execution_limits limits{};
+	limits.num_threads = 2;
+	limits.cache_limit_bytes = 1 << 20;
+	bool terminated_early;
+	CHECK(count_terrace_modular(data, limits, terminated_early) ==
+	      count_terrace_bigint(data));
+	CHECK(!terminated_early);
+#ifdef USE_GMP
+	// needs multiple passes
+	data.num_leaves = 200;
+	auto result = count_terrace_modular(data);
+	CHECK(!result.is_small());
+	CHECK(result == count_terrace_bigint(data));
+	CHECK(result != count_unrooted_trees<big_integer>(200));
+#endif // USE_GMP
+}
+
+} // namespace tests
+} // namespace terraces
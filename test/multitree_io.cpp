@@ -0,0 +1,221 @@
+#include <catch.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <terraces/advanced.hpp>
+#include <terraces/errors.hpp>
+#include <terraces/parser.hpp>
+#include <terraces/subtree_extraction.hpp>
+
+#include "../lib/multitree_io.hpp"
+#include "../lib/multitree_iterator.hpp"
+#include "../lib/supertree_enumerator.hpp"
+#include "../lib/supertree_variants_multitree.hpp"
+
+namespace terraces {
+namespace tests {
+
+/** Provides access to the records and counts of a binary multitree file for corrupting them. */
+class multitree_file_contents {
+private:
+	std::string m_contents;
+
+	std::uint64_t get_u64(std::size_t offset) const {
+		std::uint64_t result = 0;
+		for (int i = 0; i < 8; ++i) {
+			result |= std::uint64_t(static_cast<unsigned char>(m_contents[offset + i]))
+			          << (8 * i);
+		}
+		return result;
+	}
+
+public:
+	explicit multitree_file_contents(const std::string& filename) {
+		std::ifstream stream{filename, std::ios::binary};
+		m_contents.assign(std::istreambuf_iterator<char>{stream}, {});
+	}
+
+	void write(const std::string& filename) const {
+		std::ofstream stream{filename, std::ios::binary};
+		stream << m_contents;
+	}
+
+	std::size_t num_records() const { return get_u64(16); }
+	std::size_t record_offset(std::size_t i) const { return 40 + 24 * i; }
+	/** Returns the index of the first record of the given type. */
+	std::size_t find_record(multitree_node_type type) const {
+		for (std::size_t i = 0; i < num_records(); ++i) {
+			if (m_contents[record_offset(i)] == char(type)) {
+				return i;
+			}
+		}
+		return num_records();
+	}
+	std::size_t leaf_id_offset(std::size_t i) const {
+		return record_offset(num_records()) + 4 * i;
+	}
+	/** Returns the offset of the lowest limb of the count of the given record. */
+	std::size_t count_offset(std::size_t i) const {
+		auto num_leaf_ids = get_u64(24);
+		auto offset = leaf_id_offset(0) + (num_leaf_ids * 4 + 7) / 8 * 8;
+		for (std::size_t j = 0; j < i; ++j) {
+			offset += 8 + 8 * get_u64(offset);
+		}
+		return offset + 8;
+	}
+	/** Overwrites the lowest four bytes of a little-endian number. */
+	void set_u32(std::size_t offset, std::uint32_t value) {
+		for (int i = 0; i < 4; ++i) {
+			m_contents[offset + i] = char((value >> (8 * i)) & 0xff);
+		}
+	}
+};
+
+void check_same_multitree(const multitree_node* expected, const multitree_node* actual,
+                          const name_map& names) {
+	std::stringstream expected_nwk;
+	std::stringstream actual_nwk;
+	expected_nwk << as_newick(expected, names);
+	actual_nwk << as_newick(actual, names);
+	CHECK(expected_nwk.str() == actual_nwk.str());
+	REQUIRE(expected->num_trees == actual->num_trees);
+	multitree_iterator expected_it{expected};
+	multitree_iterator actual_it{actual};
+	bool next;
+	do {
+		REQUIRE(expected_it.tree() == actual_it.tree());
+		next = expected_it.next();
+		REQUIRE(next == actual_it.next());
+	} while (next);
+}
+
+TEST_CASE("multitree binary roundtrip", "[multitree]") {
+	auto data_stream = std::istringstream{
+	        "6 3\n1 0 0 s1\n1 0 0 s2\n0 0 1 s3\n0 1 1 s4\n1 1 1 s5\n0 1 1 s6"};
+	auto data = parse_bitmatrix(data_stream);
+	auto tree = parse_nwk("((s4, (s3, (s2, (s1, s6)))), s5)", data.indices);
+	auto supertree_data = create_supertree_data(tree, data.matrix);
+	tree_enumerator<variants::multitree_callback> enumerator{{}};
+	auto result = enumerator.run(supertree_data.num_leaves, supertree_data.constraints,
+	                             supertree_data.root);
+
+	auto filename = "terraphast_multitree_testfile.bin";
+	write_multitree(filename, result);
+	{
+		stored_multitree stored{filename};
+		CHECK(stored.root()->num_trees == 35);
+		check_same_multitree(result, stored.root(), data.names);
+	}
+
+	std::string contents;
+	{
+		std::ifstream stream{filename, std::ios::binary};
+		contents.assign(std::istreambuf_iterator<char>{stream}, {});
+	}
+	auto write_contents = [&](const std::string& new_contents) {
+		std::ofstream stream{filename, std::ios::binary};
+		stream << new_contents;
+	};
+	SECTION("truncated") {
+		write_contents(contents.substr(0, contents.size() - 1));
+		CHECK_THROWS_AS(stored_multitree{filename}, bad_input_error);
+	}
+	SECTION("wrong magic") {
+		write_contents("X" + contents.substr(1));
+		CHECK_THROWS_AS(stored_multitree{filename}, bad_input_error);
+	}
+	SECTION("wrong version") {
+		contents[8] = 2;
+		write_contents(contents);
+		CHECK_THROWS_AS(stored_multitree{filename}, bad_input_error);
+	}
+	SECTION("cyclic reference") {
+		// let the first alternative of the root (the last record) point to the root itself
+		auto num_records = static_cast<unsigned char>(contents[16]);
+		auto root_offset = 40 + 24 * (num_records - 1u);
+		CHECK(contents[root_offset] == char(multitree_node_type::alternative_array));
+		std::fill_n(contents.begin() + root_offset + 8, 8, '\0');
+		write_contents(contents);
+		CHECK_THROWS_AS(stored_multitree{filename}, bad_input_error);
+	}
+	multitree_file_contents file{filename};
+	SECTION("leaf out of range") {
+		auto leaf = file.find_record(multitree_node_type::base_single_leaf);
+		REQUIRE(leaf < file.num_records());
+		// there are only 6 leaves
+		file.set_u32(file.record_offset(leaf) + 8, 6);
+		file.write(filename);
+		CHECK_THROWS_AS(stored_multitree{filename}, bad_input_error);
+	}
+	SECTION("wrong leaf count") {
+		file.set_u32(file.count_offset(0), 2);
+		file.write(filename);
+		CHECK_THROWS_AS(stored_multitree{filename}, bad_input_error);
+	}
+	SECTION("wrong inner count") {
+		auto inner = file.find_record(multitree_node_type::inner_node);
+		REQUIRE(inner < file.num_records());
+		file.set_u32(file.count_offset(inner), 0);
+		file.write(filename);
+		CHECK_THROWS_AS(stored_multitree{filename}, bad_input_error);
+	}
+	SECTION("wrong alternative count") {
+		file.set_u32(file.count_offset(file.num_records() - 1), 34);
+		file.write(filename);
+		CHECK_THROWS_AS(stored_multitree{filename}, bad_input_error);
+	}
+	std::remove(filename);
+	CHECK_THROWS_AS(stored_multitree{filename}, file_open_error);
+}
+
+TEST_CASE("multitree binary unconstrained", "[multitree]") {
+	name_map names{"1", "2", "3", "4", "5", "6", "7", "8"};
+	tree_enumerator<variants::multitree_callback> enumerator{{}};
+	auto result = enumerator.run(names.size(), {}, 0);
+	auto filename = "terraphast_multitree_unconstrained.bin";
+	write_multitree(filename, result);
+	{
+		stored_multitree stored{filename};
+		// the root alternative, its only alternative and the two subtrees
+		CHECK(stored.num_nodes() == 4);
+		check_same_multitree(result, stored.root(), names);
+	}
+	multitree_file_contents file{filename};
+	auto unconstrained = file.find_record(multitree_node_type::base_unconstrained);
+	REQUIRE(unconstrained < file.num_records());
+	SECTION("leaf id out of range") {
+		file.set_u32(file.leaf_id_offset(3), 8);
+		file.write(filename);
+		CHECK_THROWS_AS(stored_multitree{filename}, bad_input_error);
+	}
+	SECTION("wrong unconstrained count") {
+		// 11!! trees on 7 leaves
+		file.set_u32(file.count_offset(unconstrained), 11 * 9 * 7 * 5 * 3 - 2);
+		file.write(filename);
+		CHECK_THROWS_AS(stored_multitree{filename}, bad_input_error);
+	}
+	std::remove(filename);
+}
+
+#ifdef USE_GMP
+TEST_CASE("multitree binary large counts", "[multitree]") {
+	tree_enumerator<variants::multitree_callback> enumerator{{}};
+	auto result = enumerator.run(40, {}, 0);
+	auto filename = "terraphast_multitree_large.bin";
+	write_multitree(filename, result);
+	{
+		stored_multitree stored{filename};
+		CHECK(stored.root()->num_trees == result->num_trees);
+		CHECK(stored.root()->num_trees == count_unrooted_trees<big_integer>(39));
+		CHECK(unrank(stored.root(), result->num_trees.value() - big_integer{1}) ==
+		      unrank(result, result->num_trees.value() - big_integer{1}));
+	}
+	std::remove(filename);
+}
+#endif // USE_GMP
+
+} // namespace tests
+} // namespace terraces
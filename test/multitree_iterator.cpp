@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <sstream>
+#include <stdexcept>
 
 #include <terraces/advanced.hpp>
 #include <terraces/parser.hpp>
@@ -30,6 +31,64 @@ void check_unique_trees(multitree_node* root, index_t num_trees) {
 	CHECK(bipartitions.size() == num_trees);
 }
 
+void check_ranks(multitree_node* root) {
+	std::vector<tree> trees;
+	multitree_iterator it(root);
+	do {
+		CHECK(it.rank() == big_integer{index_t(trees.size())});
+		trees.push_back(it.tree());
+	} while (it.next());
+	REQUIRE(root->num_trees == big_integer{index_t(trees.size())});
+	for (index_t k = 0; k < trees.size(); ++k) {
+		CHECK(unrank(root, k) == trees[k]);
+	}
+	// enumerate in slices of different sizes
+	std::vector<tree> sliced;
+	for (index_t first = 0, size = 1; first < trees.size(); first += size, size *= 2) {
+		auto last = std::min<index_t>(first + size, trees.size());
+		multitree_iterator slice_it(root, first, last);
+		do {
+			sliced.push_back(slice_it.tree());
+		} while (slice_it.next());
+		CHECK(slice_it.rank() == big_integer{last - 1});
+	}
+	CHECK(sliced == trees);
+	CHECK_THROWS_AS(unrank(root, trees.size()), std::out_of_range);
+	CHECK_THROWS_AS(multitree_iterator(root, 1, 1), std::out_of_range);
+}
+
+void check_changed_ranges(multitree_node* root) {
+	multitree_iterator it(root);
+	REQUIRE((it.changed_ranges() == std::vector<node_range>{{0, it.tree().size()}}));
+	auto previous = it.tree();
+	index_t num_changed = 0;
+	index_t num_nodes = 0;
+	while (it.next()) {
+		const auto& ranges = it.changed_ranges();
+		REQUIRE(!ranges.empty());
+		auto updated = previous;
+		index_t end = 0;
+		for (auto range : ranges) {
+			// sorted, disjoint and not adjacent
+			CHECK((end == 0 || end < range.begin));
+			CHECK(range.begin < range.end);
+			CHECK(range.end <= updated.size());
+			for (auto i = range.begin; i < range.end; ++i) {
+				updated[i] = it.tree()[i];
+			}
+			num_changed += range.end - range.begin;
+			end = range.end;
+		}
+		// all nodes outside of the ranges are unchanged
+		CHECK(updated == it.tree());
+		CHECK(previous != it.tree());
+		num_nodes += it.tree().size();
+		previous = it.tree();
+	}
+	CHECK(it.changed_ranges().empty());
+	CHECK(num_changed < num_nodes);
+}
+
 TEST_CASE("multitree_iterator init simple", "[multitree]") {
 	auto data_stream = std::istringstream{"7 4\n1 1 1 1 s1\n0 0 1 0 s2\n1 1 0 0 s3\n1 1 1 0 "
 	                                      "s4\n1 1 0 1 s5\n1 0 0 1 s7\n0 0 0 1 s13"};
@@ -42,6 +101,8 @@ TEST_CASE("multitree_iterator init simple", "[multitree]") {
 	                             supertree_data.root);
 
 	check_unique_trees(result, 9);
+	check_ranks(result);
+	check_changed_ranges(result);
 }
 
 TEST_CASE("multitree_iterator init unconstrained", "[multitree]") {
@@ -52,6 +113,73 @@ TEST_CASE("multitree_iterator init unconstrained", "[multitree]") {
 	auto result = enumerator.run(names.size(), constraints, root_species);
 
 	check_unique_trees(result, count_unrooted_trees<index_t>(7));
+	check_ranks(result);
+	check_changed_ranges(result);
+}
+
+TEST_CASE("multitree_iterator unrank alternatives", "[multitree]") {
+	name_map names{"1", "2", "3", "4", "5", "6", "7"};
+	constraints constraints{{0, 1, 2}, {3, 4, 5}, {0, 3, 6}};
+	index_t root_species = 0;
+	tree_enumerator<variants::multitree_callback> enumerator{{}};
+	auto result = enumerator.run(names.size(), constraints, root_species);
+
+	check_ranks(result);
+	check_changed_ranges(result);
+}
+
+TEST_CASE("multitree sharing", "[multitree]") {
+	auto data_stream = std::istringstream{
+	        "6 3\n1 0 0 s1\n1 0 0 s2\n0 0 1 s3\n0 1 1 s4\n1 1 1 s5\n0 1 1 s6"};
+	auto data = terraces::parse_bitmatrix(data_stream);
+	auto tree = terraces::parse_nwk("((s4, (s3, (s2, (s1, s6)))), s5)", data.indices);
+
+	auto supertree_data = terraces::create_supertree_data(tree, data.matrix);
+	tree_enumerator<variants::multitree_callback> enumerator{{}};
+	auto result = enumerator.run(supertree_data.num_leaves, supertree_data.constraints,
+	                             supertree_data.root);
+	CHECK(enumerator.callback().sharing_statistics().hits == 4);
+
+	std::stringstream ss;
+	ss << as_newick(result, data.names);
+	CHECK(ss.str() == "(s5,(s2,((s3,s6),(s1,s4))|(s4,#1={s1,s3,s6})|(#2=(s4,(s3,s6)),s1))|("
+	                  "(s3,s6),{s1,s2,s4})|(#3={s2,s3,s6},(s1,s4))|(s4,{s1,s2,s3,s6})|((s2,"
+	                  "s4),#1#)|(#2#,(s1,s2))|(((s3,s6),(s2,s4))|(s4,#3#)|(#2#,s2),s1))");
+
+	check_unique_trees(result, 35);
+	check_ranks(result);
+	check_changed_ranges(result);
+}
+
+TEST_CASE("tree_count", "[multitree]") {
+	auto half = index_t{1} << 62;
+	tree_count a{half};
+	tree_count b{3};
+	CHECK(!a.is_out_of_line());
+	CHECK((a * b).is_out_of_line());
+	CHECK((a * b).value() == big_integer{half} * big_integer{3});
+	CHECK((b * b) == 9);
+	auto sum = a;
+	sum += b;
+	CHECK(!sum.is_out_of_line());
+	sum += a;
+	CHECK(sum.is_out_of_line());
+	CHECK(sum.value() == big_integer{half * 2 + 3});
+	CHECK(a < sum);
+	CHECK(!(sum < a));
+	CHECK(sum != a);
+	// copies of out-of-line values are independent
+	auto copy = sum;
+	copy += tree_count{1};
+	CHECK(copy.value() == big_integer{half * 2 + 4});
+	CHECK(sum.value() == big_integer{half * 2 + 3});
+	copy = b;
+	CHECK(!copy.is_out_of_line());
+	CHECK(copy == b);
+	// values that fit are stored inline again
+	CHECK(!tree_count{big_integer{half}}.is_out_of_line());
+	CHECK(tree_count{big_integer{half * 2}} == tree_count{half * 2});
+	CHECK(sizeof(multitree_node) <= 4 * sizeof(index_t));
 }
 
 } // namespace tests
@@ -0,0 +1,105 @@
+#include <catch.hpp>
+
+#include <sstream>
+
+#include <terraces/advanced.hpp>
+#include <terraces/errors.hpp>
+#include <terraces/parser.hpp>
+#include <terraces/subtree_extraction.hpp>
+
+#include "../lib/multitree.hpp"
+#include "../lib/multitree_parser.hpp"
+#include "../lib/supertree_enumerator.hpp"
+#include "../lib/supertree_variants_multitree.hpp"
+
+namespace terraces {
+namespace tests {
+
+// defined in multitree_io.cpp
+void check_same_multitree(const multitree_node* expected, const multitree_node* actual,
+                          const name_map& names);
+
+parsed_multitree parse_multitree(const std::string& input, const index_map& indices) {
+	std::istringstream stream{input};
+	return terraces::parse_multitree(stream, indices);
+}
+
+TEST_CASE("multitree parser roundtrip", "[multitree],[parser]") {
+	auto data_stream = std::istringstream{
+	        "6 3\n1 0 0 s1\n1 0 0 s2\n0 0 1 s3\n0 1 1 s4\n1 1 1 s5\n0 1 1 s6"};
+	auto data = parse_bitmatrix(data_stream);
+	auto tree = parse_nwk("((s4, (s3, (s2, (s1, s6)))), s5)", data.indices);
+	auto supertree_data = create_supertree_data(tree, data.matrix);
+	tree_enumerator<variants::multitree_callback> enumerator{{}};
+	auto result = enumerator.run(supertree_data.num_leaves, supertree_data.constraints,
+	                             supertree_data.root);
+	std::stringstream nwk;
+	nwk << as_newick(result, data.names);
+
+	auto parsed = terraces::parse_multitree(nwk, data.indices);
+	CHECK(parsed.root->num_trees == 35);
+	check_same_multitree(result, parsed.root, data.names);
+}
+
+TEST_CASE("multitree parser shared subtrees", "[multitree],[parser]") {
+	name_map names{"1", "2", "3", "4", "5", "6", "7", "8", "9", "10"};
+	index_map indices;
+	for (index_t i = 0; i < names.size(); ++i) {
+		indices[names[i]] = i;
+	}
+	tree_enumerator<variants::multitree_callback> enumerator{{}};
+	auto result = enumerator.run(names.size(), {{0, 1, 2}, {3, 4, 2}}, 0);
+	std::stringstream nwk;
+	nwk << as_newick(result, names);
+	auto parsed = terraces::parse_multitree(nwk, indices);
+	check_same_multitree(result, parsed.root, names);
+}
+
+TEST_CASE("multitree parser base cases", "[multitree],[parser]") {
+	name_map names{"a", "b", "c", "d", "e"};
+	index_map indices{{"a", 0}, {"b", 1}, {"c", 2}, {"d", 3}, {"e", 4}};
+	auto to_string = [&](const multitree_node* root) {
+		std::stringstream stream;
+		stream << as_newick(root, names);
+		return stream.str();
+	};
+
+	auto unconstrained = parse_multitree("{a,b,c,d,e};", indices);
+	CHECK(unconstrained.root->type == multitree_node_type::base_unconstrained);
+	CHECK(unconstrained.root->num_trees == 105);
+	CHECK(to_string(unconstrained.root) == "{a,b,c,d,e}");
+
+	auto unexplored = parse_multitree("(a,[b,c,d]);", indices);
+	CHECK(unexplored.root->type == multitree_node_type::inner_node);
+	CHECK(unexplored.root->inner_node.right->type == multitree_node_type::unexplored);
+	CHECK(unexplored.root->num_trees == 0);
+
+	auto alternatives = parse_multitree(" ( a , {b,c,d} ) | ( (a , b) , {c,d} ) ", indices);
+	CHECK(alternatives.root->type == multitree_node_type::alternative_array);
+	CHECK(alternatives.root->alternative_array.num_alternatives() == 2);
+	CHECK(alternatives.root->alternative_array.begin[1].inner_node.left->type ==
+	      multitree_node_type::base_two_leaves);
+	CHECK(alternatives.root->num_trees == 4);
+
+	auto shared = parse_multitree("(#1=(a,b)|(c,d),(#1#,e))", indices);
+	auto left = shared.root->inner_node.left;
+	auto right = shared.root->inner_node.right;
+	CHECK(right->inner_node.left == left);
+	CHECK(shared.root->num_trees == 4);
+}
+
+TEST_CASE("multitree parser malformed", "[multitree],[parser]") {
+	index_map indices{{"a", 0}, {"b", 1}, {"c", 2}};
+	CHECK_THROWS_AS(parse_multitree("(a,x)", indices), bad_input_error);
+	CHECK_THROWS_AS(parse_multitree("((a,b)", indices), bad_input_error);
+	CHECK_THROWS_AS(parse_multitree("(a,b))", indices), bad_input_error);
+	CHECK_THROWS_AS(parse_multitree("(a,b,c)", indices), bad_input_error);
+	CHECK_THROWS_AS(parse_multitree("(#9#,c)", indices), bad_input_error);
+	CHECK_THROWS_AS(parse_multitree("(#1=a,#1=b)", indices), bad_input_error);
+	CHECK_THROWS_AS(parse_multitree("(a,b)|c", indices), bad_input_error);
+	CHECK_THROWS_AS(parse_multitree("{a,b", indices), bad_input_error);
+	CHECK_THROWS_AS(parse_multitree("", indices), bad_input_error);
+}
+
+} // namespace tests
+} // namespace terraces
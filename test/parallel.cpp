@@ -0,0 +1,72 @@
+#include <catch.hpp>
+
+#include <terraces/advanced.hpp>
+#include <terraces/errors.hpp>
+#include <terraces/parser.hpp>
+
+#include "../lib/supertree_enumerator.hpp"
+#include "../lib/supertree_enumerator_parallel.hpp"
+#include "../lib/supertree_variants.hpp"
+#include "test_data.hpp"
+
+namespace terraces {
+namespace tests {
+
+TEST_CASE("parallel_count_supertree", "[supertree][parallel]") {
+	constraints c = {{0, 1, 3}, {3, 2, 0}, {4, 5, 6}, {6, 3, 4}, {2, 3, 6}, {2, 6, 7}};
+	for (index_t threads = 1; threads <= 4; ++threads) {
+		parallel_tree_enumerator<variants::count_callback<uint64_t>> e{{}, threads, 3};
+		CHECK(e.run(8, c) == 173);
+		CHECK(e.run(7, {}) == 10395);
+		parallel_tree_enumerator<variants::check_callback> check{{}, threads, 3};
+		CHECK(check.run(8, c) > 1);
+	}
+}
+
+TEST_CASE("parallel_count_deterministic", "[supertree][parallel]") {
+	auto data = nested_three_taxon_data(3);
+	tree_enumerator<variants::count_callback<uint64_t>> sequential{{}};
+	auto expected = sequential.run(data.num_leaves, data.constraints, data.root);
+	for (index_t threads = 2; threads <= 8; threads *= 2) {
+		parallel_tree_enumerator<variants::count_callback<uint64_t>> e{{}, threads, 3};
+		CHECK(e.run(data.num_leaves, data.constraints, data.root) == expected);
+		parallel_tree_enumerator<variants::clamped_count_callback> clamped{{}, threads, 3};
+		CHECK(clamped.run(data.num_leaves, data.constraints, data.root).value() ==
+		      expected);
+	}
+}
+
+TEST_CASE("parallel_count_exceptions", "[supertree][parallel]") {
+	auto data = nested_three_taxon_data(65);
+	parallel_tree_enumerator<variants::count_callback<big_integer>> e{{}, 4, 3};
+	CHECK_THROWS_AS(e.run(data.num_leaves, data.constraints, data.root),
+	                tree_count_overflow_error);
+}
+
+TEST_CASE("parallel_count_many_constraints", "[supertree][parallel]") {
+	// the constraint sets are too large to be stored inline, so every task needs to
+	// allocate them from the arena of its own worker (checked by assertions in debug builds)
+	auto data = balanced_caterpillar_data(10, 64);
+	CHECK(data.constraints.size() > 511);
+	parallel_tree_enumerator<variants::count_callback<uint64_t>> e{{}, 4, 3};
+	// repeat to make it more likely that tasks get stolen
+	for (int rep = 0; rep < 4; ++rep) {
+		CHECK(e.run(data.num_leaves, data.constraints, data.root) == 1);
+	}
+}
+
+TEST_CASE("parallel_count_advanced", "[advanced-api][parallel]") {
+	auto data = nested_three_taxon_data(3);
+	execution_limits limits{};
+	bool terminated_early = true;
+	auto expected = count_terrace(data);
+	limits.num_threads = 4;
+	CHECK(count_terrace(data, limits, terminated_early) == expected);
+	CHECK(!terminated_early);
+	terminated_early = true;
+	CHECK(count_terrace_bigint(data, limits, terminated_early) == big_integer{expected});
+	CHECK(!terminated_early);
+}
+
+} // namespace tests
+} // namespace terraces
@@ -37,10 +37,9 @@ TEST_CASE("simple_results") {
 	print_terrace_compressed("((s4, (s3, (s2, (s1, s6)))), s5)",
 	                         "6 3\n1 0 0 s1\n1 0 0 s2\n0 0 1 s3\n0 1 1 s4\n1 1 1 s5\n0 1 1 s6",
 	                         ss);
-	CHECK(ss.str() == "(s5,(s2,((s3,s6),(s1,s4))|(s4,{s1,s3,s6})|((s4,(s3,s6)),s1))|((s3,s6),{"
-	                  "s1,s2,s4})|({s2,s3,s6},(s1,s4))|(s4,{s1,s2,s3,s6})|((s2,s4),{s1,s3,s6})|"
-	                  "((s4,(s3,s6)),(s1,s2))|(((s3,s6),(s2,s4))|(s4,{s2,s3,s6})|((s4,(s3,s6)),"
-	                  "s2),s1))");
+	CHECK(ss.str() == "(s5,(s2,((s3,s6),(s1,s4))|(s4,#1={s1,s3,s6})|(#2=(s4,(s3,s6)),s1))|((s3,"
+	                  "s6),{s1,s2,s4})|(#3={s2,s3,s6},(s1,s4))|(s4,{s1,s2,s3,s6})|((s2,s4),#1#)"
+	                  "|(#2#,(s1,s2))|(((s3,s6),(s2,s4))|(s4,#3#)|(#2#,s2),s1))");
 	ss.str("");
 	print_terrace("((s4, (s3, (s2, (s1, s6)))), s5)",
 	              "6 3\n1 0 0 s1\n1 0 0 s2\n0 0 1 s3\n0 1 1 s4\n1 1 1 s5\n0 1 1 s6", ss);
@@ -12,5 +12,58 @@ TEST_CASE("stack_allocator basic", "[utils][utils::stack_allocator]") {
 	CHECK_NOTHROW(vec.reserve(10));
 }
 
+TEST_CASE("stack_allocator arena", "[utils][utils::stack_allocator]") {
+	utils::arena a;
+	a.reset(256);
+	utils::stack_allocator<std::size_t> alloc{a, 10};
+	std::vector<std::size_t, utils::stack_allocator<std::size_t>> outer(10, 1, alloc);
+	auto used = a.used_bytes();
+	CHECK(used >= 10 * sizeof(std::size_t));
+	{
+		utils::arena_scope scope{a};
+		// more than the initial chunk, so the arena needs to grow
+		std::vector<std::vector<std::size_t, utils::stack_allocator<std::size_t>>> inner;
+		for (int i = 0; i < 10; ++i) {
+			inner.emplace_back(10, std::size_t(i), alloc);
+		}
+		CHECK(a.used_bytes() > 256);
+		CHECK(a.capacity_bytes() > 256);
+		for (int i = 0; i < 10; ++i) {
+			CHECK(inner[i][9] == std::size_t(i));
+		}
+	}
+	CHECK(a.used_bytes() == used);
+	CHECK(a.peak_bytes() > 256);
+	CHECK(outer[9] == 1u);
+	// released memory is reused
+	auto capacity = a.capacity_bytes();
+	{
+		utils::arena_scope scope{a};
+		std::vector<std::size_t, utils::stack_allocator<std::size_t>> tmp(10, 2, alloc);
+		CHECK(a.capacity_bytes() == capacity);
+	}
+	a.reset(0);
+	CHECK(a.used_bytes() == 0);
+	CHECK(a.capacity_bytes() == 0);
+}
+
+TEST_CASE("stack_allocator resized", "[utils][utils::stack_allocator]") {
+	utils::arena a;
+	a.reset(256);
+	utils::stack_allocator<char> small{a, 1};
+	utils::stack_allocator<std::size_t> large{small, 20};
+	std::vector<std::size_t, utils::stack_allocator<std::size_t>> vec(20, 1, large);
+	CHECK(a.used_bytes() >= 20 * sizeof(std::size_t));
+	// free lists only store buffers of a single size, so the system allocator is used
+	utils::free_list fl;
+	utils::stack_allocator<char> small_fl{fl, 1};
+	utils::stack_allocator<std::size_t> large_fl{small_fl, 20};
+	CHECK(large_fl != utils::stack_allocator<std::size_t>(small_fl));
+	std::vector<std::size_t, utils::stack_allocator<std::size_t>> vec_fl(20, 2, large_fl);
+	vec_fl.clear();
+	vec_fl.shrink_to_fit();
+	CHECK(fl.pop() == nullptr);
+}
+
 } // namespace tests
 } // namespace terraces
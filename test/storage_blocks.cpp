@@ -0,0 +1,84 @@
+#include <catch.hpp>
+
+#include <set>
+
+#include "../lib/multitree_impl.hpp"
+
+namespace terraces {
+namespace tests {
+
+using multitree_impl::storage_blocks;
+
+TEST_CASE("storage_blocks single objects", "[multitree][storage_blocks]") {
+	storage_blocks<index_t> blocks{4};
+	std::set<index_t*> objects;
+	for (index_t i = 0; i < 10; ++i) {
+		auto object = blocks.get();
+		*object = i;
+		objects.insert(object);
+	}
+	CHECK(objects.size() == 10);
+	auto stats = blocks.statistics();
+	CHECK(stats.blocks == 3);
+	CHECK(stats.used_bytes == 10 * sizeof(index_t));
+	CHECK(stats.allocated_bytes == 12 * sizeof(index_t));
+	CHECK(stats.fragmented_bytes == 0);
+}
+
+TEST_CASE("storage_blocks ranges", "[multitree][storage_blocks]") {
+	storage_blocks<index_t> blocks{16};
+	auto first = blocks.get_range(10);
+	// leaves a free space of 6 in the first block
+	auto second = blocks.get_range(8);
+	CHECK(blocks.statistics().fragmented_bytes == 6 * sizeof(index_t));
+	CHECK(blocks.get_range(8) == second + 8);
+	// fits into the free space of the first block, but not the current one
+	CHECK(blocks.get_range(4) == first + 10);
+	CHECK(blocks.statistics().reused_ranges == 1);
+	CHECK(blocks.statistics().fragmented_bytes == 2 * sizeof(index_t));
+	CHECK(blocks.get() == first + 14);
+	CHECK(blocks.statistics().blocks == 2);
+
+	SECTION("large ranges") {
+		auto large = blocks.get_range(100);
+		large[99] = 1;
+		auto stats = blocks.statistics();
+		CHECK(stats.dedicated_blocks == 1);
+		CHECK(stats.blocks == 3);
+		CHECK(stats.used_bytes == 131 * sizeof(index_t));
+		CHECK(blocks.get() == first + 15);
+		CHECK(blocks.statistics().fragmented_bytes == 0);
+	}
+
+	SECTION("memory limit") {
+		blocks.set_memory_limit(40 * sizeof(index_t));
+		CHECK_THROWS_AS(blocks.get_range(9), std::bad_alloc);
+		CHECK_THROWS_AS(blocks.get_range(8), std::bad_alloc);
+		// the free space is still available
+		CHECK(blocks.get_range(1) == first + 15);
+		CHECK(blocks.statistics().allocated_bytes == 32 * sizeof(index_t));
+		// single objects never fail
+		CHECK_NOTHROW(blocks.get());
+		CHECK(blocks.statistics().allocated_bytes == 48 * sizeof(index_t));
+	}
+}
+
+TEST_CASE("storage_blocks many alternative arrays", "[multitree][storage_blocks]") {
+	storage_blocks<index_t> blocks{1024};
+	index_t requested = 0;
+	for (index_t i = 1; i <= 2000; ++i) {
+		auto size = i % 300 + 1;
+		auto range = blocks.get_range(size);
+		range[size - 1] = i;
+		requested += size;
+	}
+	auto stats = blocks.statistics();
+	CHECK(stats.used_bytes == requested * sizeof(index_t));
+	CHECK(stats.reused_ranges > 0);
+	// less than a block per range
+	CHECK(stats.blocks < 500);
+	CHECK(stats.allocated_bytes - stats.used_bytes < stats.used_bytes / 4);
+}
+
+} // namespace tests
+} // namespace terraces
@@ -0,0 +1,98 @@
+#include <catch.hpp>
+
+#include <terraces/advanced.hpp>
+
+#include "../lib/bitvector.hpp"
+#include "../lib/subproblem_cache.hpp"
+#include "../lib/supertree_enumerator.hpp"
+#include "../lib/supertree_enumerator_parallel.hpp"
+#include "../lib/supertree_variants.hpp"
+#include "test_data.hpp"
+
+namespace terraces {
+namespace tests {
+
+TEST_CASE("subproblem_cache lookup", "[subproblem_cache]") {
+	subproblem_cache<index_t> cache{1 << 20};
+	basic_bitvector<std::allocator<index_t>> a{100, {}};
+	basic_bitvector<std::allocator<index_t>> b{100, {}};
+	a.set(3);
+	a.set(70);
+	b.set(3);
+	CHECK(cache.find(a) == nullptr);
+	cache.insert(a, 5);
+	REQUIRE(cache.find(a) != nullptr);
+	CHECK(*cache.find(a) == 5);
+	CHECK(cache.find(b) == nullptr);
+	cache.insert(b, 7);
+	cache.insert(a, 6);
+	CHECK(*cache.find(a) == 6);
+	CHECK(*cache.find(b) == 7);
+	CHECK(cache.size() == 2);
+	CHECK(cache.statistics().hits == 4);
+	CHECK(cache.statistics().misses == 2);
+	CHECK(cache.statistics().insertions == 2);
+	CHECK(cache.statistics().evictions == 0);
+}
+
+TEST_CASE("subproblem_cache eviction", "[subproblem_cache]") {
+	basic_bitvector<std::allocator<index_t>> a{10, {}};
+	basic_bitvector<std::allocator<index_t>> b{10, {}};
+	basic_bitvector<std::allocator<index_t>> c{10, {}};
+	a.set(1);
+	b.set(2);
+	c.set(3);
+	subproblem_cache<index_t> probe{1 << 20};
+	probe.insert(a, 1);
+	auto entry_bytes = probe.statistics().bytes;
+	// room for two entries
+	subproblem_cache<index_t> cache{2 * entry_bytes};
+	cache.insert(a, 1);
+	cache.insert(b, 2);
+	// a becomes the most recently used entry
+	CHECK(cache.find(a) != nullptr);
+	cache.insert(c, 3);
+	CHECK(cache.size() == 2);
+	CHECK(cache.find(b) == nullptr);
+	CHECK(cache.find(a) != nullptr);
+	CHECK(cache.find(c) != nullptr);
+	CHECK(cache.statistics().evictions == 1);
+	CHECK(cache.statistics().peak_bytes == 2 * entry_bytes);
+	subproblem_cache<index_t> tiny{entry_bytes - 1};
+	tiny.insert(a, 1);
+	CHECK(tiny.size() == 0);
+	CHECK(tiny.find(a) == nullptr);
+}
+
+TEST_CASE("memoized count", "[supertree][subproblem_cache]") {
+	using memo_callback = variants::memoization_decorator<variants::count_callback<uint64_t>>;
+	constraints c = {{0, 1, 3}, {3, 2, 0}, {4, 5, 6}, {6, 3, 4}, {2, 3, 6}, {2, 6, 7}};
+	tree_enumerator<memo_callback> e{{1 << 20}};
+	CHECK(e.run(8, c) == 173);
+	auto data = nested_three_taxon_data(3);
+	tree_enumerator<variants::count_callback<uint64_t>> plain{{}};
+	auto expected = plain.run(data.num_leaves, data.constraints, data.root);
+	tree_enumerator<memo_callback> memo{{1 << 20}};
+	CHECK(memo.run(data.num_leaves, data.constraints, data.root) == expected);
+	CHECK(memo.callback().statistics().hits > 0);
+	// a tiny cache evicts constantly, but stays correct
+	tree_enumerator<memo_callback> small{{200}};
+	CHECK(small.run(data.num_leaves, data.constraints, data.root) == expected);
+	CHECK(small.callback().statistics().evictions > 0);
+	parallel_tree_enumerator<memo_callback> parallel{{1 << 20}, 4, 3};
+	CHECK(parallel.run(data.num_leaves, data.constraints, data.root) == expected);
+}
+
+TEST_CASE("memoized count advanced", "[advanced-api][subproblem_cache]") {
+	auto data = nested_three_taxon_data(3);
+	auto expected = count_terrace(data);
+	execution_limits limits{};
+	limits.cache_limit_bytes = 1 << 20;
+	bool terminated_early = true;
+	CHECK(count_terrace(data, limits, terminated_early) == expected);
+	CHECK(!terminated_early);
+	CHECK(count_terrace_bigint(data, limits, terminated_early) == big_integer{expected});
+}
+
+} // namespace tests
+} // namespace terraces
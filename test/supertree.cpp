@@ -1,7 +1,10 @@
 #include <catch.hpp>
 
+#include <cmath>
 #include <iostream>
 
+#include <terraces/bigint.hpp>
+
 #include "../lib/supertree_enumerator.hpp"
 #include "../lib/supertree_variants.hpp"
 
@@ -66,5 +69,49 @@ TEST_CASE("count_supertree_none", "[supertree]") {
 	CHECK(!check_supertree(3, c));
 }
 
+class unseparated_count_callback : public variants::count_callback<uint64_t> {
+public:
+	bool separate_free_leaves() { return false; }
+};
+
+TEST_CASE("count_supertree_free_leaves", "[supertree]") {
+	constraints c = {{0, 1, 3}, {3, 2, 0}, {4, 5, 6}, {6, 3, 4}, {2, 3, 6}, {2, 6, 7}};
+	tree_enumerator<unseparated_count_callback> reference{{}};
+	for (index_t num_leaves = 8; num_leaves <= 11; ++num_leaves) {
+		CHECK(count_supertree(num_leaves, c) == reference.run(num_leaves, c));
+	}
+	constraints c2 = {{0, 1, 2}, {2, 3, 4}, {5, 6, 7}, {0, 5, 8}};
+	CHECK(count_supertree(10, c2) == reference.run(10, c2));
+}
+
+TEST_CASE("approx_count_supertree", "[supertree]") {
+	constraints c = {{0, 1, 3}, {3, 2, 0}, {4, 5, 6}, {6, 3, 4}, {2, 3, 6}, {2, 6, 7}};
+	tree_enumerator<variants::approx_count_callback> e{{}};
+	for (index_t num_leaves = 8; num_leaves <= 11; ++num_leaves) {
+		auto expected = std::log(double(count_supertree(num_leaves, c)));
+		CHECK(e.run(num_leaves, c) == Approx(expected));
+	}
+	// far beyond the range of double
+	double expected = std::log(173.0);
+	for (index_t i = 8; i < 1000; ++i) {
+		expected += std::log(double(2 * i - 1));
+	}
+	CHECK(e.run(1000, c) == Approx(expected));
+	CHECK(e.run(3, {}) == Approx(std::log(3.0)));
+}
+
+#ifdef USE_GMP
+TEST_CASE("count_supertree_many_free_leaves", "[supertree]") {
+	// more than 64 components, most of them without constraints
+	constraints c = {{0, 1, 3}, {3, 2, 0}, {4, 5, 6}, {6, 3, 4}, {2, 3, 6}, {2, 6, 7}};
+	big_integer expected = 173;
+	for (index_t i = 8; i < 80; ++i) {
+		expected *= (2 * i - 1);
+	}
+	tree_enumerator<variants::count_callback<big_integer>> e{{}};
+	CHECK(e.run(80, c) == expected);
+}
+#endif
+
 } // namespace tests
 } // namespace terraces
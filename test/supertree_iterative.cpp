@@ -0,0 +1,77 @@
+#include <catch.hpp>
+
+#include <sstream>
+
+#include <terraces/bigint.hpp>
+
+#include "../lib/supertree_enumerator.hpp"
+#include "../lib/supertree_enumerator_iterative.hpp"
+#include "../lib/supertree_variants.hpp"
+#include "../lib/supertree_variants_debug.hpp"
+#include "../lib/supertree_variants_multitree.hpp"
+
+namespace terraces {
+namespace tests {
+
+TEST_CASE("iterative_count_supertree", "[supertree][iterative]") {
+	constraints c = {{0, 1, 3}, {3, 2, 0}, {4, 5, 6}, {6, 3, 4}, {2, 3, 6}, {2, 6, 7}};
+	iterative_tree_enumerator<variants::count_callback<uint64_t>> e{{}};
+	CHECK(e.run(8, c) == 173);
+	CHECK(e.run(11, c) == 173 * 15 * 17 * 19);
+	CHECK(e.run(7, {}) == 10395);
+	CHECK(e.run(3, {{0, 1, 2}, {2, 1, 0}}) == 0);
+	iterative_tree_enumerator<variants::check_callback> check{{}};
+	CHECK(check.run(8, c) > 1);
+	CHECK(check.run(5, {{0, 1, 2}, {1, 2, 3}, {2, 3, 4}}) == 1);
+	tree_enumerator<variants::multitree_callback> multitree{{}};
+	iterative_tree_enumerator<variants::multitree_callback> iterative_multitree{{}};
+	CHECK(iterative_multitree.run(9, c, 8)->num_trees == multitree.run(9, c, 8)->num_trees);
+}
+
+TEST_CASE("iterative_callback_order", "[supertree][iterative]") {
+	using logging_callback = debug::variants::logging_decorator<variants::check_callback>;
+	constraints c = {{0, 1, 3}, {3, 2, 0}, {4, 5, 6}, {6, 3, 4}, {2, 3, 6}, {2, 6, 7}};
+	name_map names{"a", "b", "c", "d", "e", "f", "g", "h", "i"};
+	std::stringstream recursive_log;
+	std::stringstream iterative_log;
+	tree_enumerator<logging_callback> recursive{{{}, recursive_log, names}};
+	iterative_tree_enumerator<logging_callback> iterative{{{}, iterative_log, names}};
+	CHECK(recursive.run(9, c, 8) == iterative.run(9, c, 8));
+	CHECK(recursive_log.str() == iterative_log.str());
+}
+
+TEST_CASE("iterative_step", "[supertree][iterative]") {
+	constraints c = {{0, 1, 3}, {3, 2, 0}, {4, 5, 6}, {6, 3, 4}, {2, 3, 6}, {2, 6, 7}};
+	iterative_tree_enumerator<variants::count_callback<uint64_t>> e{{}};
+	e.start(8, c);
+	index_t max_depth = 0;
+	index_t steps = 0;
+	while (!e.finished()) {
+		max_depth = std::max(max_depth, e.depth());
+		REQUIRE(e.depth() > 0);
+		CHECK(e.leaves(0).count() == 8);
+		CHECK(e.leaves(e.depth() - 1).count() > 2);
+		CHECK(e.current_bip(0) <= e.bipartitions_at(0).end_bip());
+		e.step();
+		++steps;
+	}
+	CHECK(!e.step());
+	CHECK(e.depth() == 0);
+	CHECK(e.result() == 173);
+	CHECK(max_depth > 1);
+	CHECK(steps > max_depth);
+}
+
+TEST_CASE("iterative_deep_recursion", "[supertree][iterative]") {
+	// a caterpillar tree has a single tree on its terrace and recurses once per leaf
+	index_t num_leaves = 2000;
+	constraints c;
+	for (index_t i = 0; i + 2 < num_leaves; ++i) {
+		c.push_back({i, i + 1, i + 2});
+	}
+	iterative_tree_enumerator<variants::count_callback<big_integer>> e{{}};
+	CHECK(e.run(num_leaves, c) == big_integer{1});
+}
+
+} // namespace tests
+} // namespace terraces
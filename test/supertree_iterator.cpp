@@ -0,0 +1,109 @@
+#include <catch.hpp>
+
+#include <sstream>
+
+#include <terraces/advanced.hpp>
+#include <terraces/parser.hpp>
+
+#include "../lib/multitree_iterator.hpp"
+#include "../lib/supertree_enumerator.hpp"
+#include "../lib/supertree_iterator.hpp"
+#include "../lib/supertree_variants_multitree.hpp"
+#include "test_data.hpp"
+
+namespace terraces {
+namespace tests {
+
+void check_same_trees(index_t num_leaves, const constraints& constraints, index_t root_leaf,
+                      index_t num_trees) {
+	tree_enumerator<variants::multitree_callback> enumerator{{}};
+	auto result = enumerator.run(num_leaves, constraints, root_leaf);
+	multitree_iterator expected{result};
+	supertree_iterator it{num_leaves, constraints, root_leaf};
+	REQUIRE(it.is_valid());
+	index_t count = 0;
+	bool expected_next;
+	bool next;
+	do {
+		REQUIRE(it.tree() == expected.tree());
+		++count;
+		expected_next = expected.next();
+		next = it.next();
+		REQUIRE(next == expected_next);
+	} while (next);
+	CHECK(!it.is_valid());
+	CHECK(count == num_trees);
+}
+
+TEST_CASE("supertree_iterator simple", "[supertree_iterator]") {
+	auto data_stream = std::istringstream{"7 4\n1 1 1 1 s1\n0 0 1 0 s2\n1 1 0 0 s3\n1 1 1 0 "
+	                                      "s4\n1 1 0 1 s5\n1 0 0 1 s7\n0 0 0 1 s13"};
+	auto data = parse_bitmatrix(data_stream);
+	auto tree = parse_nwk("((((s2,s4),((s13,s1),s7)),s3),s5);", data.indices);
+	auto d = create_supertree_data(tree, data.matrix);
+	check_same_trees(d.num_leaves, d.constraints, d.root, 9);
+}
+
+TEST_CASE("supertree_iterator unconstrained", "[supertree_iterator]") {
+	check_same_trees(8, {{0, 1, 2}}, 0, count_unrooted_trees<index_t>(7));
+	check_same_trees(6, {}, 3, count_unrooted_trees<index_t>(5));
+}
+
+TEST_CASE("supertree_iterator nested", "[supertree_iterator]") {
+	constraints c = {{0, 1, 3}, {3, 2, 0}, {4, 5, 6}, {6, 3, 4}, {2, 3, 6}, {2, 6, 7}};
+	check_same_trees(9, c, 8, 173);
+	auto d = nested_three_taxon_data(2);
+	check_same_trees(d.num_leaves, d.constraints, d.root, count_terrace(d));
+}
+
+TEST_CASE("supertree_iterator incompatible", "[supertree_iterator]") {
+	supertree_iterator it{4, {{0, 1, 2}, {2, 1, 0}}, 3};
+	CHECK(!it.is_valid());
+	CHECK(!it.next());
+}
+
+TEST_CASE("enumerate_terrace streaming", "[supertree_iterator][advanced-api]") {
+	auto d = nested_three_taxon_data(2);
+	index_t count = 0;
+	enumerate_terrace(d, [&](const tree&) { ++count; });
+	CHECK(count == count_terrace(d));
+	name_map names{"root"};
+	for (index_t i = 1; i < d.num_leaves; ++i) {
+		names.push_back(std::to_string(i));
+	}
+	std::stringstream ss;
+	CHECK(print_terrace(d, names, ss) == big_integer{count});
+	CHECK(std::count(std::istreambuf_iterator<char>{ss}, {}, '\n') == index_t(count));
+}
+
+TEST_CASE("enumerate_terrace incremental", "[supertree_iterator][advanced-api]") {
+	auto d = nested_three_taxon_data(2);
+	std::vector<tree> trees;
+	enumerate_terrace(d, [&](const tree& t) { trees.push_back(t); });
+	// apply only the changed ranges to a copy of the previous tree
+	tree current;
+	index_t count = 0;
+	index_t num_changed = 0;
+	bool terminated_early = true;
+	enumerate_terrace_incremental(
+	        d,
+	        [&](const tree& t, const std::vector<node_range>& ranges) {
+		        current.resize(t.size());
+		        for (auto range : ranges) {
+			        for (auto i = range.begin; i < range.end; ++i) {
+				        current[i] = t[i];
+			        }
+			        num_changed += range.end - range.begin;
+		        }
+		        REQUIRE(count < trees.size());
+		        CHECK(current == trees[count]);
+		        ++count;
+	        },
+	        {}, terminated_early);
+	CHECK(!terminated_early);
+	CHECK(count == trees.size());
+	CHECK(num_changed < count * trees[0].size());
+}
+
+} // namespace tests
+} // namespace terraces
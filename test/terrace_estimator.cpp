@@ -0,0 +1,66 @@
+#include <catch.hpp>
+
+#include <cmath>
+#include <sstream>
+
+#include <terraces/advanced.hpp>
+#include <terraces/parser.hpp>
+
+#include "../lib/terrace_estimator.hpp"
+
+namespace terraces {
+namespace tests {
+
+TEST_CASE("log_estimate_statistics", "[estimator]") {
+	auto stats = log_estimate_statistics({std::log(2.0), std::log(4.0), std::log(6.0)});
+	CHECK(stats.log_mean == Approx(std::log(4.0)));
+	// standard error 2 / sqrt(3)
+	CHECK(stats.log_upper == Approx(std::log(4.0 + 1.96 * 2 / std::sqrt(3.0))));
+	CHECK(stats.log_lower == Approx(std::log(4.0 - 1.96 * 2 / std::sqrt(3.0))));
+	// too large for double
+	auto big = log_estimate_statistics({1000.0, 1000.0});
+	CHECK(big.log_mean == Approx(1000.0));
+	CHECK(big.log_lower == Approx(1000.0));
+	CHECK(big.log_upper == Approx(1000.0));
+	// lower bound is clamped to a single tree
+	auto wide = log_estimate_statistics({0.0, 10.0});
+	CHECK(wide.log_lower == 0.0);
+}
+
+TEST_CASE("estimate_terrace exact", "[estimator],[advanced-api]") {
+	std::stringstream matrix{"4 2\n1 0 s1\n1 1 s2\n1 1 s3\n1 1 s4"};
+	auto m = parse_bitmatrix(matrix);
+	auto t = parse_nwk("(s1, (s2, (s3, s4)))", m.indices);
+	auto data = create_supertree_data(t, m.matrix);
+	// a single tree has no random choices
+	auto estimate = estimate_terrace(data, 10);
+	CHECK(estimate.num_probes == 10);
+	CHECK(estimate.log10_size == Approx(0));
+	CHECK(estimate.log10_lower == Approx(0));
+	CHECK(estimate.log10_upper == Approx(0));
+	// neither do unconstrained leaves
+	supertree_data unconstrained{{}, 10, 0};
+	estimate = estimate_terrace(unconstrained, 1);
+	CHECK(estimate.log10_size == Approx(std::log10(count_terrace(unconstrained))));
+}
+
+TEST_CASE("estimate_terrace random", "[estimator],[advanced-api]") {
+	constraints c = {{0, 1, 3}, {3, 2, 0}, {4, 5, 6}, {6, 3, 4}, {2, 3, 6}, {2, 6, 7}};
+	supertree_data data{c, 12, 0};
+	auto exact = std::log10(double(count_terrace(data)));
+	execution_limits limits{};
+	limits.num_threads = 3;
+	bool terminated_early;
+	auto estimate = estimate_terrace(data, 3000, 42, limits, terminated_early);
+	CHECK(!terminated_early);
+	CHECK(estimate.num_probes == 3000);
+	CHECK(estimate.log10_lower <= exact);
+	CHECK(estimate.log10_upper >= exact);
+	CHECK(estimate.log10_size == Approx(exact).epsilon(0.01));
+	// the result is reproducible
+	auto repeated = estimate_terrace(data, 3000, 42, limits, terminated_early);
+	CHECK(repeated.log10_size == estimate.log10_size);
+}
+
+} // namespace tests
+} // namespace terraces
@@ -0,0 +1,87 @@
+#include "test_data.hpp"
+
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#include <terraces/parser.hpp>
+
+namespace terraces {
+namespace tests {
+
+supertree_data nested_three_taxon_data(unsigned magic) {
+	name_map names;
+	return nested_three_taxon_data(magic, names);
+}
+
+supertree_data nested_three_taxon_data(unsigned magic, name_map& names) {
+	names = {"root"};
+	for (unsigned i = 0; i < 3 * magic; ++i) {
+		names.push_back(std::to_string(i));
+	}
+	index_map indx;
+	for (index_t i = 0; i < names.size(); ++i) {
+		indx.emplace(names[i], i);
+	}
+	std::stringstream nwk;
+	nwk << "(root,(";
+	for (unsigned i = 0; i < 3 * magic; i += 3) {
+		nwk << "((" << i << ',' << (i + 1) << ")," << (i + 2) << ')';
+		nwk << (i < 3 * (magic - 2) ? ",(" : (i < 3 * (magic - 1) ? "," : ""));
+	}
+	for (unsigned i = 0; i < magic; ++i) {
+		nwk << ')';
+	}
+	auto tree = parse_nwk(nwk.str(), indx);
+	bitmatrix matrix{3 * magic + 1, magic};
+	for (unsigned i = 0; i < 3 * magic; ++i) {
+		matrix.set(i + 1, i / 3, 1);
+	}
+	for (unsigned i = 0; i < magic; ++i) {
+		matrix.set(0, i, 1);
+	}
+	return create_supertree_data(tree, matrix);
+}
+
+namespace {
+
+void write_balanced_subtree(std::ostream& nwk, unsigned first, unsigned size) {
+	if (size == 1) {
+		nwk << first;
+		return;
+	}
+	nwk << '(';
+	write_balanced_subtree(nwk, first, size / 2);
+	nwk << ',';
+	write_balanced_subtree(nwk, first + size / 2, size - size / 2);
+	nwk << ')';
+}
+
+} // anonymous namespace
+
+supertree_data balanced_caterpillar_data(unsigned num_subtrees, unsigned subtree_size) {
+	const auto num_leaves = num_subtrees * subtree_size + 1;
+	index_map indx;
+	for (unsigned i = 0; i < num_leaves; ++i) {
+		indx.emplace(std::to_string(i), i);
+	}
+	std::stringstream nwk;
+	for (unsigned i = 0; i < num_subtrees; ++i) {
+		nwk << '(';
+	}
+	nwk << 0;
+	for (unsigned i = num_subtrees; i > 0; --i) {
+		nwk << ',';
+		write_balanced_subtree(nwk, (i - 1) * subtree_size + 1, subtree_size);
+		nwk << ')';
+	}
+	auto tree = parse_nwk(nwk.str(), indx);
+	bitmatrix matrix{num_leaves, 1};
+	for (unsigned i = 0; i < num_leaves; ++i) {
+		matrix.set(i, 0, 1);
+	}
+	return create_supertree_data(tree, matrix);
+}
+
+} // namespace tests
+} // namespace terraces
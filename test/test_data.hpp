@@ -0,0 +1,28 @@
+#ifndef TERRACES_TESTS_TEST_DATA_HPP
+#define TERRACES_TESTS_TEST_DATA_HPP
+
+#include <terraces/advanced.hpp>
+
+namespace terraces {
+namespace tests {
+
+/**
+ * Builds a tree of nested three-taxon subtrees, one per partition,
+ * whose terrace contains many bipartitions in every recursion step.
+ */
+supertree_data nested_three_taxon_data(unsigned magic);
+/** Like \ref nested_three_taxon_data, but also returns the names of the leaves. */
+supertree_data nested_three_taxon_data(unsigned magic, name_map& names);
+
+/**
+ * Builds a caterpillar of balanced subtrees with complete data,
+ * whose terrace consists of the tree only.
+ * The subtrees further away from the root get smaller leaf indices, so the larger side
+ * of every caterpillar split is the one that is forked.
+ */
+supertree_data balanced_caterpillar_data(unsigned num_subtrees, unsigned subtree_size);
+
+} // namespace tests
+} // namespace terraces
+
+#endif // TERRACES_TESTS_TEST_DATA_HPP
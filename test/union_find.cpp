@@ -47,5 +47,27 @@ TEST_CASE("union_find::make_bipartition", "[union_find]") {
 	check(b3);
 }
 
+TEST_CASE("rollback_union_find", "[union_find]") {
+	rollback_union_find sets(6);
+	sets.merge(0, 1);
+	auto checkpoint = sets.checkpoint();
+	sets.merge(2, 3);
+	sets.merge(1, 3);
+	sets.merge(4, 5);
+	CHECK(sets.find(0) == sets.find(2));
+	CHECK(sets.find(4) == sets.find(5));
+	CHECK(sets.find(0) != sets.find(4));
+	sets.rollback(checkpoint);
+	CHECK(sets.find(0) == sets.find(1));
+	CHECK(sets.find(2) == 2);
+	CHECK(sets.find(3) == 3);
+	CHECK(sets.find(4) == 4);
+	CHECK(sets.find(5) == 5);
+	sets.rollback(0);
+	CHECK(sets.find(0) == 0);
+	CHECK(sets.find(1) == 1);
+	CHECK(sets.checkpoint() == 0);
+}
+
 } // namespace tests
 } // namespace terraces